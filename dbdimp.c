@@ -32,6 +32,11 @@ typedef short WORD;
 #endif
 #endif
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#  include <emmintrin.h>
+#  define SQL_SCAN_SSE2 1
+#endif
+
 #if MYSQL_ASYNC
 #  include <poll.h>
 #  include <errno.h>
@@ -45,6 +50,10 @@ typedef short WORD;
 #endif
 
 static int parse_number(char *string, STRLEN len, char **end);
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+static void bind_server_param(pTHX_ SV *sth, imp_sth_t *imp_sth, int idx,
+                              IV sql_type);
+#endif
 
 DBISTATE_DECLARE;
 
@@ -74,6 +83,101 @@ typedef struct sql_type_info_s
 } sql_type_info_t;
 
 
+/*
+  Characters the placeholder scanners below have to look at, everything
+  else is copied or skipped in bulk.
+*/
+#define SQL_SCAN_TOKEN 1  /* quotes, comments and placeholders */
+#define SQL_SCAN_PAREN 2  /* ')' ends a nested LIMIT */
+#define SQL_SCAN_LIMIT 4  /* 'l' and 'L' may start a LIMIT */
+
+static int sql_scan_char(unsigned char c, int mask)
+{
+  switch (c) {
+  case '-':
+  case '/':
+  case '`':
+  case '"':
+  case '\'':
+  case '?':
+    return mask & SQL_SCAN_TOKEN;
+  case ')':
+    return mask & SQL_SCAN_PAREN;
+  case 'l':
+  case 'L':
+    return mask & SQL_SCAN_LIMIT;
+  default:
+    return 0;
+  }
+}
+
+/*
+  Returns the first character in [ptr, end) the scanners are interested
+  in according to mask, or end. With SSE2, 16 bytes are tested at once.
+*/
+static char *skip_plain_chars(char *ptr, char *end, int mask)
+{
+#ifdef SQL_SCAN_SSE2
+  const __m128i dash= _mm_set1_epi8('-'), slash= _mm_set1_epi8('/');
+  const __m128i backtick= _mm_set1_epi8('`'), dquote= _mm_set1_epi8('"');
+  const __m128i squote= _mm_set1_epi8('\''), qmark= _mm_set1_epi8('?');
+  const __m128i paren= _mm_set1_epi8(')'), ell= _mm_set1_epi8('l');
+  const __m128i lower= _mm_set1_epi8(0x20);
+
+  while (end - ptr >= 16)
+  {
+    __m128i v= _mm_loadu_si128((const __m128i *) ptr);
+    __m128i hit= _mm_or_si128(
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, dash),
+                                _mm_cmpeq_epi8(v, slash)),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, backtick),
+                                _mm_cmpeq_epi8(v, dquote))),
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, squote),
+                                _mm_cmpeq_epi8(v, qmark)),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, paren),
+                                /* 'l' and 'L' only differ in 0x20 */
+                                _mm_cmpeq_epi8(_mm_or_si128(v, lower), ell))));
+    unsigned int bits= _mm_movemask_epi8(hit);
+
+    while (bits)
+    {
+      int i= __builtin_ctz(bits);
+      if (sql_scan_char((unsigned char) ptr[i], mask))
+        return ptr + i;
+      bits&= bits - 1;
+    }
+    ptr+= 16;
+  }
+#endif
+  while (ptr < end && !sql_scan_char((unsigned char) *ptr, mask))
+    ptr++;
+  return ptr;
+}
+
+/*
+  Returns the first occurrence of c1 or c2 in [ptr, end), or end; used
+  to skip over the contents of quoted strings and comments.
+*/
+static char *skip_to_chars(char *ptr, char *end, char c1, char c2)
+{
+#ifdef SQL_SCAN_SSE2
+  const __m128i v1= _mm_set1_epi8(c1), v2= _mm_set1_epi8(c2);
+
+  while (end - ptr >= 16)
+  {
+    __m128i v= _mm_loadu_si128((const __m128i *) ptr);
+    unsigned int bits= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, v1),
+                                                      _mm_cmpeq_epi8(v, v2)));
+    if (bits)
+      return ptr + __builtin_ctz(bits);
+    ptr+= 16;
+  }
+#endif
+  while (ptr < end && *ptr != c1 && *ptr != c2)
+    ptr++;
+  return ptr;
+}
+
 /*
 
   This function manually counts the number of placeholders in an SQL statement,
@@ -85,6 +189,7 @@ count_params(imp_xxh_t *imp_xxh, pTHX_ char *statement, bool bind_comment_placeh
 {
   bool comment_end= false;
   char* ptr= statement;
+  char* end= statement + strlen(statement);
   int num_params= 0;
   int comment_length= 0;
   char c;
@@ -100,7 +205,8 @@ count_params(imp_xxh_t *imp_xxh, pTHX_ char *statement, bool bind_comment_placeh
       {
           if (bind_comment_placeholders)
           {
-              c = *ptr++;
+              if (*ptr)  /* never step over the terminating NUL */
+                  c = *ptr++;
               break;
           }
           else
@@ -142,7 +248,8 @@ count_params(imp_xxh_t *imp_xxh, pTHX_ char *statement, bool bind_comment_placeh
       {
           if (bind_comment_placeholders)
           {
-              c = *ptr++;
+              if (*ptr)
+                  c = *ptr++;
               break;
           }
           else
@@ -200,10 +307,14 @@ count_params(imp_xxh_t *imp_xxh, pTHX_ char *statement, bool bind_comment_placeh
         while ((c = *ptr)  &&  c != end_token)
         {
           if (c == '\\')
+          {
             if (! *(++ptr))
               continue;
 
-          ++ptr;
+            ++ptr;
+          }
+          else
+            ptr= skip_to_chars(ptr, end, end_token, '\\');
         }
         if (c)
           ++ptr;
@@ -215,6 +326,7 @@ count_params(imp_xxh_t *imp_xxh, pTHX_ char *statement, bool bind_comment_placeh
       break;
 
     default:
+      ptr= skip_plain_chars(ptr, end, SQL_SCAN_TOKEN);
       break;
     }
   }
@@ -294,13 +406,39 @@ static void free_bind(MYSQL_BIND *bind)
     Safefree(bind);
 }
 
+/*
+  The buffer for a string value of a parameter, owned by the driver. It
+  only moves when it has to grow, so that the parameter is not bound
+  again for every value.
+*/
+static char *param_buffer(imp_sth_phb_t *fbind, STRLEN len)
+{
+  if (!fbind->data || len > fbind->capacity)
+  {
+    STRLEN capacity= fbind->capacity ? fbind->capacity * 2 : 64;
+
+    if (capacity < len)
+      capacity= len;
+    Safefree(fbind->data);
+    New(908, fbind->data, capacity, char);
+    fbind->capacity= capacity;
+  }
+  return fbind->data;
+}
+
 /*
    free imp_sth_phb_t fbind structure
 */
-static void free_fbind(imp_sth_phb_t *fbind)
+static void free_fbind(imp_sth_phb_t *fbind, int num_params)
 {
+  int i;
+
   if (fbind)
+  {
+    for (i= 0; i < num_params; i++)
+      Safefree(fbind[i].data);
     Safefree(fbind);
+  }
 }
 
 /*
@@ -529,88 +667,38 @@ char **fill_out_embedded_options(PerlIO *stream,
 #endif
 
 /*
-  constructs an SQL statement previously prepared with
-  actual values replacing placeholders
+  scans an SQL statement for placeholders, the way the statement is
+  going to be rewritten by fill_params: quoted strings and, unless
+  bind_comment_placeholders is set, comments are skipped. Each '?'
+  found is recorded along with whether it follows a LIMIT.
 */
-static char *parse_params(
-                          imp_xxh_t *imp_xxh,
-                          pTHX_ MYSQL *sock,
-                          char *statement,
-                          STRLEN *slen_ptr,
-                          imp_sth_ph_t* params,
-                          int num_params,
-                          bool bind_type_guessing,
-                          bool bind_comment_placeholders)
+static imp_sth_tmpl_t *compile_params(
+                                      imp_xxh_t *imp_xxh,
+                                      pTHX_ char *statement,
+                                      STRLEN slen,
+                                      bool bind_comment_placeholders)
 {
-  bool comment_end= false;
-  char *salloc, *statement_ptr;
-  char *statement_ptr_end, *ptr, *valbuf;
-  char *cp, *end;
-  int alen, i;
-  int slen= *slen_ptr;
+  imp_sth_tmpl_t *tmpl;
+  char *statement_ptr, *statement_ptr_end, *comment_start;
   int limit_flag= 0;
-  int comment_length=0;
-  STRLEN vallen;
-  imp_sth_ph_t *ph;
+  int num_alloc= 8;
 
   if (DBIc_DBISTATE(imp_xxh)->debug >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh), ">parse_params statement %s\n", statement);
-
-  if (num_params == 0)
-    return NULL;
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), ">compile_params statement %s\n", statement);
 
-  while (isspace(*statement))
+  while (slen && isspace(*statement))
   {
     ++statement;
     --slen;
   }
 
-  /* Calculate the number of bytes being allocated for the statement */
-  alen= slen;
-
-  for (i= 0, ph= params; i < num_params; i++, ph++)
-  {
-    int defined= 0;
-    if (ph->value)
-    {
-      if (SvMAGICAL(ph->value))
-        mg_get(ph->value);
-      if (SvOK(ph->value))
-        defined=1;
-    }
-    if (!defined)
-      alen+= 3;  /* Erase '?', insert 'NULL' */
-    else
-    {
-      valbuf= SvPV(ph->value, vallen);
-      alen+= 2+vallen+1;
-      /* this will most likely not happen since line 214 */
-      /* of mysql.xs hardcodes all types to SQL_VARCHAR */
-      if (!ph->type)
-      {
-        if (bind_type_guessing)
-        {
-          valbuf= SvPV(ph->value, vallen);
-          ph->type= SQL_INTEGER;
-
-          if (parse_number(valbuf, vallen, &end) != 0)
-          {
-              ph->type= SQL_VARCHAR;
-          }
-        }
-        else
-          ph->type= SQL_VARCHAR;
-      }
-    }
-  }
-
-  /* Allocate memory, why *2, well, because we have ptr and statement_ptr */
-  New(908, salloc, alen*2, char);
-  ptr= salloc;
+  Newz(908, tmpl, 1, imp_sth_tmpl_t);
+  tmpl->statement= savepvn(statement, slen);
+  tmpl->length= slen;
+  tmpl->bind_comment_placeholders= bind_comment_placeholders;
+  New(908, tmpl->pos, num_alloc, imp_sth_ph_pos_t);
 
-  i= 0;
- /* Now create the statement string; compare count_params above */
-  statement_ptr_end= (statement_ptr= statement)+ slen;
+  statement_ptr_end= (statement_ptr= tmpl->statement) + slen;
 
   while (statement_ptr < statement_ptr_end)
   {
@@ -631,250 +719,419 @@ static char *parse_params(
     {
       /* comment detection. Anything goes in a comment */
       case '-':
-      {
-          if (bind_comment_placeholders)
-          {
-              *ptr++= *statement_ptr++;
-              break;
-          }
-          else
-          {
-              comment_length= 1;
-              comment_end= false;
-              *ptr++ = *statement_ptr++;
-              if  (*statement_ptr == '-')
-              {
-                  /* ignore everything until newline or end of string */
-                  while (*statement_ptr)
-                  {
-                      comment_length++;
-                      *ptr++ = *statement_ptr++;
-                      if (!*statement_ptr || *statement_ptr == '\n')
-                      {
-                          comment_end= true;
-                          break;
-                      }
-                  }
-                  /* if not end of comment, go back to where we started, no end found */
-                  if (! comment_end)
-                  {
-                      statement_ptr -= comment_length;
-                      ptr -= comment_length;
-                  }
-              }
-              break;
-          }
-      }
+        statement_ptr++;
+        /* ignore everything until newline or end of string */
+        if (!bind_comment_placeholders && *statement_ptr == '-')
+        {
+          statement_ptr= skip_to_chars(statement_ptr, statement_ptr_end,
+                                       '\n', '\0');
+        }
+        break;
+
       /* c-type comments */
       case '/':
-      {
-          if (bind_comment_placeholders)
-          {
-              *ptr++= *statement_ptr++;
-              break;
-          }
-          else
-          {
-              comment_length= 1;
-              comment_end= false;
-              *ptr++ = *statement_ptr++;
-              if  (*statement_ptr == '*')
-              {
-                  /* use up characters everything until newline */
-                  while (*statement_ptr)
-                  {
-                      *ptr++ = *statement_ptr++;
-                      comment_length++;
-                      if (!strncmp(statement_ptr, "*/", 2))
-                      {
-                          comment_length += 2;
-                          comment_end= true;
-                          break;
-                      }
-                  }
-                  /* Go back to where started if comment end not found */
-                  if (! comment_end)
-                  {
-                      statement_ptr -= comment_length;
-                      ptr -= comment_length;
-                  }
-              }
-              break;
-          }
-      }
+        comment_start= ++statement_ptr;
+        if (!bind_comment_placeholders && *statement_ptr == '*')
+        {
+          /* use up characters until the end of the comment */
+          do
+            statement_ptr= skip_to_chars(statement_ptr + 1, statement_ptr_end,
+                                         '*', '\0');
+          while (*statement_ptr && strncmp(statement_ptr, "*/", 2));
+
+          /* Go back to where started if comment end not found */
+          if (! *statement_ptr)
+            statement_ptr= comment_start;
+        }
+        break;
+
       case '`':
       case '\'':
       case '"':
       /* Skip string */
       {
         char endToken = *statement_ptr++;
-        *ptr++ = endToken;
         while (statement_ptr != statement_ptr_end &&
                *statement_ptr != endToken)
         {
           if (*statement_ptr == '\\')
           {
-            *ptr++ = *statement_ptr++;
+            statement_ptr++;
             if (statement_ptr == statement_ptr_end)
-	      break;
-	  }
-          *ptr++= *statement_ptr++;
-	}
-	if (statement_ptr != statement_ptr_end)
-          *ptr++= *statement_ptr++;
+              break;
+            statement_ptr++;
+          }
+          else
+            statement_ptr= skip_to_chars(statement_ptr, statement_ptr_end,
+                                         endToken, '\\');
+        }
+        if (statement_ptr != statement_ptr_end)
+          statement_ptr++;
       }
       break;
 
       case '?':
-        /* Insert parameter */
-        statement_ptr++;
-        if (i >= num_params)
-        {
-          break;
-        }
-
-        ph = params+ (i++);
-        if (!ph->value  ||  !SvOK(ph->value))
-        {
-          *ptr++ = 'N';
-          *ptr++ = 'U';
-          *ptr++ = 'L';
-          *ptr++ = 'L';
-        }
-        else
+        if (tmpl->num_pos == num_alloc)
         {
-          int is_num = FALSE;
-
-          valbuf= SvPV(ph->value, vallen);
-          if (valbuf)
-          {
-            switch (ph->type)
-            {
-              case SQL_NUMERIC:
-              case SQL_DECIMAL:
-              case SQL_INTEGER:
-              case SQL_SMALLINT:
-              case SQL_FLOAT:
-              case SQL_REAL:
-              case SQL_DOUBLE:
-              case SQL_BIGINT:
-              case SQL_TINYINT:
-                is_num = TRUE;
-                break;
-            }
-
-            /* (note this sets *end, which we use if is_num) */
-            if ( parse_number(valbuf, vallen, &end) != 0 && is_num)
-            {
-              if (bind_type_guessing) {
-                /* .. not a number, so apparently we guessed wrong */
-                is_num = 0;
-                ph->type = SQL_VARCHAR;
-              }
-            }
-
-
-            /* we're at the end of the query, so any placeholders if */
-            /* after a LIMIT clause will be numbers and should not be quoted */
-            if (limit_flag == 1)
-              is_num = TRUE;
-
-            if (!is_num)
-            {
-              *ptr++ = '\'';
-              ptr += mysql_real_escape_string(sock, ptr, valbuf, vallen);
-              *ptr++ = '\'';
-            }
-            else
-            {
-              for (cp= valbuf; cp < end; cp++)
-                  *ptr++= *cp;
-            }
-          }
+          num_alloc*= 2;
+          Renew(tmpl->pos, num_alloc, imp_sth_ph_pos_t);
         }
+        tmpl->pos[tmpl->num_pos].offset= statement_ptr - tmpl->statement;
+        tmpl->pos[tmpl->num_pos].is_limit= limit_flag == 1;
+        tmpl->num_pos++;
+        statement_ptr++;
         break;
 
-	/* in case this is a nested LIMIT */
+      /* in case this is a nested LIMIT */
       case ')':
         limit_flag = 0;
-	*ptr++ = *statement_ptr++;
+        statement_ptr++;
         break;
 
       default:
-        *ptr++ = *statement_ptr++;
+        statement_ptr= skip_plain_chars(statement_ptr + 1, statement_ptr_end,
+                                        limit_flag ? SQL_SCAN_TOKEN | SQL_SCAN_PAREN :
+                                        SQL_SCAN_TOKEN | SQL_SCAN_PAREN | SQL_SCAN_LIMIT);
         break;
-
     }
   }
 
-  *slen_ptr = ptr - salloc;
-  *ptr++ = '\0';
-
-  return(salloc);
+  return tmpl;
 }
 
-int bind_param(imp_sth_ph_t *ph, SV *value, IV sql_type)
+static void free_params_tmpl(imp_sth_tmpl_t *tmpl)
 {
-  dTHX;
-  if (ph->value)
+  if (tmpl)
   {
-    if (SvMAGICAL(ph->value))
-      mg_get(ph->value);
-    (void) SvREFCNT_dec(ph->value);
+    Safefree(tmpl->statement);
+    Safefree(tmpl->pos);
+    Safefree(tmpl);
   }
+}
 
-  ph->value= newSVsv(value);
+/*
+  the placeholder scan done by prepare, unless it is outdated
+*/
+static imp_sth_tmpl_t *sth_params_tmpl(
+                                       imp_xxh_t *imp_xxh,
+                                       pTHX_ imp_sth_t *imp_sth,
+                                       char *statement,
+                                       STRLEN slen,
+                                       bool bind_comment_placeholders)
+{
+  if (imp_sth->params_tmpl &&
+      imp_sth->params_tmpl->bind_comment_placeholders != bind_comment_placeholders)
+  {
+    free_params_tmpl(imp_sth->params_tmpl);
+    imp_sth->params_tmpl= NULL;
+  }
+  if (!imp_sth->params_tmpl)
+    imp_sth->params_tmpl= compile_params(imp_xxh, aTHX_ statement, slen,
+                                         bind_comment_placeholders);
+  return imp_sth->params_tmpl;
+}
 
-  if (sql_type)
-    ph->type = sql_type;
+/*
+  Makes sure the query buffer can hold size bytes. The buffer is kept
+  by the handle for the next statement, see free_query_buf.
+*/
+static void grow_query_buf(char **buf, STRLEN *buf_size, STRLEN size)
+{
+  if (size <= *buf_size)
+    return;
+  if (size < 2 * *buf_size)
+    size= 2 * *buf_size;
+  if (*buf)
+    Renew(*buf, size, char);
+  else
+    New(908, *buf, size, char);
+  *buf_size= size;
+}
 
-  return TRUE;
+/* Releases the query buffer, or just keeps it if it's small enough */
+static void free_query_buf(char **buf, STRLEN *buf_size, bool keep)
+{
+  if (*buf && (!keep || *buf_size > QUERY_BUFFER_KEEP_MAX))
+  {
+    Safefree(*buf);
+    *buf= NULL;
+    *buf_size= 0;
+  }
 }
 
-static const sql_type_info_t SQL_GET_TYPE_INFO_values[]= {
-  { "varchar",    SQL_VARCHAR,                    255, "'",  "'",  "max length",
-    1, 0, 3, 0, 0, 0, "variable length string",
-    0, 0, 0,
-    SQL_VARCHAR, 0, 0,
-#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
-    FIELD_TYPE_VAR_STRING,  0,
-#else
-    MYSQL_TYPE_STRING,  0,
-#endif
-  },
-  { "decimal",   SQL_DECIMAL,                      15, NULL, NULL, "precision,scale",
-    1, 0, 3, 0, 0, 0, "double",
-    0, 6, 2,
-    SQL_DECIMAL, 0, 0,
-#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
-    FIELD_TYPE_DECIMAL,     1
-#else
-    MYSQL_TYPE_DECIMAL,     1
-#endif
-  },
-  { "tinyint",   SQL_TINYINT,                       3, NULL, NULL, NULL,
-    1, 0, 3, 0, 0, 0, "Tiny integer",
-    0, 0, 10,
-    SQL_TINYINT, 0, 0,
-#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
-    FIELD_TYPE_TINY,        1
-#else
-    MYSQL_TYPE_TINY,     1
-#endif
-  },
-  { "smallint",  SQL_SMALLINT,                      5, NULL, NULL, NULL,
-    1, 0, 3, 0, 0, 0, "Short integer",
-    0, 0, 10,
-    SQL_SMALLINT, 0, 0,
-#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
-    FIELD_TYPE_SHORT,       1
-#else
-    MYSQL_TYPE_SHORT,     1
-#endif
-  },
-  { "integer",   SQL_INTEGER,                      10, NULL, NULL, NULL,
-    1, 0, 3, 0, 0, 0, "integer",
-    0, 0, 10,
+/*
+  constructs an SQL statement previously prepared with
+  actual values replacing placeholders, in the query buffer
+*/
+static char *fill_params(
+                         imp_xxh_t *imp_xxh,
+                         pTHX_ MYSQL *sock,
+                         imp_sth_tmpl_t *tmpl,
+                         char **buf,
+                         STRLEN *buf_size,
+                         STRLEN *slen_ptr,
+                         imp_sth_ph_t* params,
+                         int num_params,
+                         bool bind_type_guessing)
+{
+  char *ptr, *valbuf;
+  char *cp, *end;
+  STRLEN vallen, val_size, used= 0, offset= 0;
+  int i;
+  imp_sth_ph_t *ph;
+  imp_sth_ph_pos_t *pos;
+
+  if (DBIc_DBISTATE(imp_xxh)->debug >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), ">fill_params statement %s\n",
+                  tmpl->statement);
+
+  if (num_params == 0)
+    return NULL;
+
+  /* Copy the text between the placeholders, values replace the '?' */
+  for (i= 0, pos= tmpl->pos; i < tmpl->num_pos; i++, pos++)
+  {
+    int defined= 0;
+
+    /* Superfluous placeholders are dropped */
+    ph= i < num_params ? params + i : NULL;
+    valbuf= NULL;
+    val_size= 0;
+    if (ph && ph->value)
+    {
+      if (SvMAGICAL(ph->value))
+        mg_get(ph->value);
+      if (SvOK(ph->value))
+        defined= 1;
+    }
+    if (ph && !defined)
+      val_size= 4;  /* NULL */
+    else if (ph)
+    {
+      valbuf= SvPV_nomg(ph->value, vallen);
+      /*
+        The documented bound of mysql_real_escape_string: with multibyte
+        character sets even bytes which need no escaping on their own may
+        be escaped, so the result is not predicted from the string
+      */
+      val_size= 2 + 2 * vallen + 1;
+      /* this will most likely not happen since line 214 */
+      /* of mysql.xs hardcodes all types to SQL_VARCHAR */
+      if (!ph->type)
+      {
+        if (bind_type_guessing)
+        {
+          ph->type= SQL_INTEGER;
+
+          if (parse_number(valbuf, vallen, &end) != 0)
+          {
+              ph->type= SQL_VARCHAR;
+          }
+        }
+        else
+          ph->type= SQL_VARCHAR;
+      }
+    }
+
+    /* Room for this value and all of the remaining text */
+    grow_query_buf(buf, buf_size, used + val_size + tmpl->length - offset + 1);
+    ptr= *buf + used;
+
+    memcpy(ptr, tmpl->statement + offset, pos->offset - offset);
+    ptr+= pos->offset - offset;
+    offset= pos->offset + 1;
+
+    if (!ph)
+      ;
+    else if (!defined)
+    {
+      *ptr++ = 'N';
+      *ptr++ = 'U';
+      *ptr++ = 'L';
+      *ptr++ = 'L';
+    }
+    else
+    {
+      int is_num = FALSE;
+
+      switch (ph->type)
+      {
+        case SQL_NUMERIC:
+        case SQL_DECIMAL:
+        case SQL_INTEGER:
+        case SQL_SMALLINT:
+        case SQL_FLOAT:
+        case SQL_REAL:
+        case SQL_DOUBLE:
+        case SQL_BIGINT:
+        case SQL_TINYINT:
+          is_num = TRUE;
+          break;
+      }
+
+      /* (note this sets *end, which we use if is_num) */
+      if ( parse_number(valbuf, vallen, &end) != 0 && is_num)
+      {
+        if (bind_type_guessing) {
+          /* .. not a number, so apparently we guessed wrong */
+          is_num = 0;
+          ph->type = SQL_VARCHAR;
+        }
+      }
+
+      /* we're at the end of the query, so any placeholders if */
+      /* after a LIMIT clause will be numbers and should not be quoted */
+      if (pos->is_limit)
+        is_num = TRUE;
+
+      if (!is_num)
+      {
+        *ptr++ = '\'';
+        ptr += mysql_real_escape_string(sock, ptr, valbuf, vallen);
+        *ptr++ = '\'';
+      }
+      else
+      {
+        for (cp= valbuf; cp < end; cp++)
+            *ptr++= *cp;
+      }
+    }
+    used= ptr - *buf;
+  }
+  grow_query_buf(buf, buf_size, used + tmpl->length - offset + 1);
+  ptr= *buf + used;
+  memcpy(ptr, tmpl->statement + offset, tmpl->length - offset);
+  ptr+= tmpl->length - offset;
+
+  *slen_ptr = ptr - *buf;
+  *ptr++ = '\0';
+
+  return(*buf);
+}
+
+/*
+  constructs an SQL statement with actual values replacing placeholders,
+  for statements which are executed only once
+*/
+static char *parse_params(
+                          imp_xxh_t *imp_xxh,
+                          pTHX_ MYSQL *sock,
+                          char *statement,
+                          char **buf,
+                          STRLEN *buf_size,
+                          STRLEN *slen_ptr,
+                          imp_sth_ph_t* params,
+                          int num_params,
+                          bool bind_type_guessing,
+                          bool bind_comment_placeholders)
+{
+  imp_sth_tmpl_t *tmpl;
+  char *sbuf;
+
+  if (num_params == 0)
+    return NULL;
+
+  tmpl= compile_params(imp_xxh, aTHX_ statement, *slen_ptr,
+                       bind_comment_placeholders);
+  sbuf= fill_params(imp_xxh, aTHX_ sock, tmpl, buf, buf_size, slen_ptr,
+                    params, num_params, bind_type_guessing);
+  free_params_tmpl(tmpl);
+  return sbuf;
+}
+
+/* A filehandle or code reference bound as a parameter, see send_long_data */
+bool long_data_source(SV *value)
+{
+  svtype type;
+
+  if (isGV(value))
+    return TRUE;
+  if (!SvROK(value))
+    return FALSE;
+  type= SvTYPE(SvRV(value));
+  return type == SVt_PVCV || type == SVt_PVGV || type == SVt_PVIO;
+}
+
+/* Is the value of the parameter sent by send_long_data? */
+static bool ph_long_data(imp_sth_ph_t *ph)
+{
+  return ph->value && SvOK(ph->value) &&
+    (ph->long_data || long_data_source(ph->value));
+}
+
+int bind_param(imp_sth_ph_t *ph, SV *value, IV sql_type)
+{
+  dTHX;
+  if (ph->value)
+  {
+    if (SvMAGICAL(ph->value))
+      mg_get(ph->value);
+    (void) SvREFCNT_dec(ph->value);
+  }
+
+  /*
+    Long data and values bound by reference are read when the statement
+    is executed, rather than copied; by reference, a reference to a plain
+    scalar binds the scalar itself
+  */
+  if (ph->by_ref && SvROK(value) && !SvOBJECT(SvRV(value)) &&
+      SvTYPE(SvRV(value)) < SVt_PVAV && SvTYPE(SvRV(value)) != SVt_PVGV)
+    ph->value= SvREFCNT_inc(SvRV(value));
+  else if (ph->by_ref || ph->long_data || long_data_source(value))
+    ph->value= SvREFCNT_inc(value);
+  else
+    ph->value= newSVsv(value);
+
+  if (sql_type)
+    ph->type = sql_type;
+
+  return TRUE;
+}
+
+static const sql_type_info_t SQL_GET_TYPE_INFO_values[]= {
+  { "varchar",    SQL_VARCHAR,                    255, "'",  "'",  "max length",
+    1, 0, 3, 0, 0, 0, "variable length string",
+    0, 0, 0,
+    SQL_VARCHAR, 0, 0,
+#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
+    FIELD_TYPE_VAR_STRING,  0,
+#else
+    MYSQL_TYPE_STRING,  0,
+#endif
+  },
+  { "decimal",   SQL_DECIMAL,                      15, NULL, NULL, "precision,scale",
+    1, 0, 3, 0, 0, 0, "double",
+    0, 6, 2,
+    SQL_DECIMAL, 0, 0,
+#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
+    FIELD_TYPE_DECIMAL,     1
+#else
+    MYSQL_TYPE_DECIMAL,     1
+#endif
+  },
+  { "tinyint",   SQL_TINYINT,                       3, NULL, NULL, NULL,
+    1, 0, 3, 0, 0, 0, "Tiny integer",
+    0, 0, 10,
+    SQL_TINYINT, 0, 0,
+#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
+    FIELD_TYPE_TINY,        1
+#else
+    MYSQL_TYPE_TINY,     1
+#endif
+  },
+  { "smallint",  SQL_SMALLINT,                      5, NULL, NULL, NULL,
+    1, 0, 3, 0, 0, 0, "Short integer",
+    0, 0, 10,
+    SQL_SMALLINT, 0, 0,
+#if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
+    FIELD_TYPE_SHORT,       1
+#else
+    MYSQL_TYPE_SHORT,     1
+#endif
+  },
+  { "integer",   SQL_INTEGER,                      10, NULL, NULL, NULL,
+    1, 0, 3, 0, 0, 0, "integer",
+    0, 0, 10,
     SQL_INTEGER, 0, 0,
 #if MYSQL_VERSION_ID < MYSQL_VERSION_5_0
     FIELD_TYPE_LONG,        1
@@ -1839,6 +2096,14 @@ MYSQL *mysql_dr_connect(
                           "imp_dbh->bind_type_guessing: %d\n",
                           imp_dbh->bind_type_guessing);
         }
+        if ((svp = hv_fetch(hv, "mysql_bind_native_types", 23, FALSE)) && *svp)
+        {
+          imp_dbh->bind_native_types = SvTRUE(*svp);
+          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                          "imp_dbh->bind_native_types: %d\n",
+                          imp_dbh->bind_native_types);
+        }
         if ((svp = hv_fetch(hv, "mysql_bind_comment_placeholders", 31, FALSE)) && *svp)
         {
           imp_dbh->bind_comment_placeholders = SvTRUE(*svp);
@@ -1905,6 +2170,18 @@ MYSQL *mysql_dr_connect(
           PerlIO_printf(DBIc_LOGPIO(imp_xxh),
                         "imp_dbh->disable_fallback_for_server_prepare: %d\n",
                         imp_dbh->disable_fallback_for_server_prepare);
+
+        /* keep the size of an existing cache on reconnect */
+        if (!imp_dbh->stmt_cache &&
+            (svp = hv_fetch(hv, "mysql_server_prepare_cache_size", 31, FALSE)) && *svp)
+        {
+          IV size= SvIV(*svp);
+          imp_dbh->stmt_cache_size= size > 0 ? (unsigned int) size : 0;
+          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                          "imp_dbh->stmt_cache_size: %u\n",
+                          imp_dbh->stmt_cache_size);
+        }
 #endif
 
         /* HELMUT */
@@ -2263,7 +2540,13 @@ int dbd_db_login(SV* dbh, imp_dbh_t* imp_dbh, char* dbname, char* user,
 
   imp_dbh->stats.auto_reconnects_ok= 0;
   imp_dbh->stats.auto_reconnects_failed= 0;
+  imp_dbh->stats.prepare_cache_hits= 0;
+  imp_dbh->stats.prepare_cache_misses= 0;
+  imp_dbh->stats.prepare_cache_evictions= 0;
+  imp_dbh->stats.unsupported_ps_hits= 0;
+  imp_dbh->stats.prefetch_stops= 0;
   imp_dbh->bind_type_guessing= FALSE;
+  imp_dbh->bind_native_types= FALSE;
   imp_dbh->bind_comment_placeholders= FALSE;
   imp_dbh->has_transactions= TRUE;
  /* Safer we flip this to TRUE perl side if we detect a mod_perl env. */
@@ -2370,86 +2653,368 @@ dbd_db_rollback(SV* dbh, imp_dbh_t* imp_dbh) {
   return TRUE;
 }
 
-/*
- ***************************************************************************
- *
- *  Name:    dbd_db_disconnect
- *
- *  Purpose: Disconnect a database handle from its database
- *
- *  Input:   dbh - database handle being disconnected
- *           imp_dbh - drivers private database handle data
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/***************************************************************************
  *
- *  Returns: TRUE for success, FALSE otherwise; do_error has already
- *           been called in the latter case
+ *  Name:    mysql_db_stmt_cache_fetch
+ *           mysql_db_stmt_cache_store
+ *           mysql_db_stmt_cache_flush
+ *
+ *  Purpose: Per connection LRU cache of server side prepared statements.
+ *           The cache only holds statements no handle is using:
+ *           mysql_db_stmt_cache_fetch() moves a statement out of the
+ *           cache, mysql_db_stmt_cache_store() puts it back (or closes
+ *           it, if it cannot be cached) once the handle is done with it.
+ *           The cache is bounded by mysql_server_prepare_cache_size and
+ *           shrinks when the server's max_prepared_stmt_count is hit,
+ *           see mysql_db_stmt_prepare().
+ *           The server resolves tables against the default database and
+ *           parses the text in the connection's character set when the
+ *           statement is prepared, so both are part of the key.
+ *
+ *  Input:   imp_dbh - drivers private database handle data
+ *           statement, length - SQL statement text
+ *           entry - statement key; on a cache hit entry->stmt is set
+ *               to the cached MYSQL_STMT
+ *
+ *  Returns: mysql_db_stmt_cache_fetch() returns TRUE for a cache hit;
+ *           entry->statement is set if the statement handle may be
+ *           handed back to the cache later.
  *
  **************************************************************************/
 
-int dbd_db_disconnect(SV* dbh, imp_dbh_t* imp_dbh)
+static void stmt_cache_free_entry(imp_stmt_cache_entry_t *entry)
 {
-#ifdef dTHR
-  dTHR;
-#endif
-  dTHX;
-  D_imp_xxh(dbh);
+  if (entry->stmt)
+    mysql_stmt_close(entry->stmt);
+  if (entry->statement)
+    Safefree(entry->statement);
+  entry->stmt= NULL;
+  entry->statement= NULL;
+}
 
-  /* We assume that disconnect will always work       */
-  /* since most errors imply already disconnected.    */
-  DBIc_ACTIVE_off(imp_dbh);
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "imp_dbh->pmysql: %p\n",
-		              imp_dbh->pmysql);
-  mysql_close(imp_dbh->pmysql );
+/* Close the least recently used statement */
+static void stmt_cache_evict(imp_dbh_t *imp_dbh)
+{
+  unsigned int i, lru= 0;
 
-  /* We don't free imp_dbh since a reference still exists    */
-  /* The DESTROY method is the only one to 'free' memory.    */
-  return TRUE;
+  for (i= 1; i < imp_dbh->stmt_cache_count; i++)
+    if (imp_dbh->stmt_cache[i].last_used < imp_dbh->stmt_cache[lru].last_used)
+      lru= i;
+
+  stmt_cache_free_entry(imp_dbh->stmt_cache + lru);
+  imp_dbh->stmt_cache[lru]= imp_dbh->stmt_cache[--imp_dbh->stmt_cache_count];
+  ++imp_dbh->stats.prepare_cache_evictions;
 }
 
+static void stmt_cache_resize(imp_dbh_t *imp_dbh, unsigned int size)
+{
+  while (imp_dbh->stmt_cache_count > size)
+    stmt_cache_evict(imp_dbh);
 
-/***************************************************************************
- *
- *  Name:    dbd_discon_all
- *
- *  Purpose: Disconnect all database handles at shutdown time
- *
- *  Input:   dbh - database handle being disconnected
- *           imp_dbh - drivers private database handle data
- *
- *  Returns: TRUE for success, FALSE otherwise; do_error has already
- *           been called in the latter case
- *
- **************************************************************************/
+  imp_dbh->stmt_cache_size= size;
+  if (!size)
+  {
+    if (imp_dbh->stmt_cache)
+      Safefree(imp_dbh->stmt_cache);
+    imp_dbh->stmt_cache= NULL;
+  }
+  else if (imp_dbh->stmt_cache)
+    Renew(imp_dbh->stmt_cache, size, imp_stmt_cache_entry_t);
+  else
+    Newz(908, imp_dbh->stmt_cache, size, imp_stmt_cache_entry_t);
+}
 
-int dbd_discon_all (SV *drh, imp_drh_t *imp_drh) {
-#if defined(dTHR)
-  dTHR;
-#endif
-  dTHX;
-#if defined(DBD_MYSQL_EMBEDDED)
-  D_imp_xxh(drh);
-#else
-  PERL_UNUSED_ARG(drh);
-#endif
+/*
+  The key is the statement text followed by a NUL and the default
+  database, all in entry->statement, and the character set
+*/
+static bool stmt_cache_key_eq(imp_stmt_cache_entry_t *a,
+                              imp_stmt_cache_entry_t *b)
+{
+  return a->hash == b->hash && a->length == b->length &&
+    a->charset == b->charset &&
+    memEQ(a->statement, b->statement, a->length) &&
+    strEQ(a->statement + a->length + 1, b->statement + b->length + 1);
+}
 
-#if defined(DBD_MYSQL_EMBEDDED)
-  if (imp_drh->embedded.state)
-  {
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "Stop embedded server\n");
+bool mysql_db_stmt_cache_fetch(pTHX_ imp_dbh_t *imp_dbh, const char *statement,
+                               STRLEN length, imp_stmt_cache_entry_t *entry)
+{
+  unsigned int i;
+  imp_stmt_cache_entry_t *cached;
+  const char *db= imp_dbh->pmysql->db ? imp_dbh->pmysql->db : "";
+  STRLEN db_length= strlen(db);
 
-    mysql_server_end();
-    if (imp_drh->embedded.groups)
-    {
-      (void) SvREFCNT_dec(imp_drh->embedded.groups);
-      imp_drh->embedded.groups = NULL;
-    }
+  entry->statement= NULL;
+  entry->stmt= NULL;
 
-    if (imp_drh->embedded.args)
-    {
-      (void) SvREFCNT_dec(imp_drh->embedded.args);
-      imp_drh->embedded.args = NULL;
-    }
+  if (!imp_dbh->stmt_cache_size)
+    return FALSE;
+
+  PERL_HASH(entry->hash, statement, length);
+  entry->length= length;
+  entry->charset= mysql_character_set_name(imp_dbh->pmysql);
+  New(908, entry->statement, length + 1 + db_length + 1, char);
+  Copy(statement, entry->statement, length, char);
+  entry->statement[length]= '\0';
+  Copy(db, entry->statement + length + 1, db_length + 1, char);
+
+  for (i= 0; i < imp_dbh->stmt_cache_count; i++)
+  {
+    cached= imp_dbh->stmt_cache + i;
+    if (stmt_cache_key_eq(cached, entry))
+    {
+      /* The entry now belongs to the caller, until it is stored again */
+      Safefree(entry->statement);
+      *entry= *cached;
+      *cached= imp_dbh->stmt_cache[--imp_dbh->stmt_cache_count];
+      ++imp_dbh->stats.prepare_cache_hits;
+      return TRUE;
+    }
+  }
+
+  ++imp_dbh->stats.prepare_cache_misses;
+  entry->thread_id= mysql_thread_id(imp_dbh->pmysql);
+  return FALSE;
+}
+
+void mysql_db_stmt_cache_store(pTHX_ imp_dbh_t *imp_dbh,
+                               imp_stmt_cache_entry_t *entry)
+{
+  unsigned int i;
+
+  /*
+    Statements of a connection which has gone away, or which was
+    re-established meanwhile, must not be used again
+  */
+  if (!entry->stmt || !entry->statement || !imp_dbh->stmt_cache_size ||
+      !DBIc_ACTIVE(imp_dbh) || !entry->stmt->mysql ||
+      entry->thread_id != mysql_thread_id(imp_dbh->pmysql))
+  {
+    stmt_cache_free_entry(entry);
+    return;
+  }
+
+  for (i= 0; i < imp_dbh->stmt_cache_count; i++)
+  {
+    if (stmt_cache_key_eq(imp_dbh->stmt_cache + i, entry))
+    {
+      /* Another handle has already given back the same statement */
+      stmt_cache_free_entry(entry);
+      return;
+    }
+  }
+
+  /* Discard any rows the previous owner did not fetch */
+  mysql_stmt_free_result(entry->stmt);
+
+  if (!imp_dbh->stmt_cache)
+    Newz(908, imp_dbh->stmt_cache, imp_dbh->stmt_cache_size,
+         imp_stmt_cache_entry_t);
+  else if (imp_dbh->stmt_cache_count >= imp_dbh->stmt_cache_size)
+    stmt_cache_evict(imp_dbh);
+
+  entry->last_used= ++imp_dbh->stmt_cache_clock;
+  imp_dbh->stmt_cache[imp_dbh->stmt_cache_count++]= *entry;
+  entry->statement= NULL;
+  entry->stmt= NULL;
+}
+
+void mysql_db_stmt_cache_flush(pTHX_ imp_dbh_t *imp_dbh)
+{
+  while (imp_dbh->stmt_cache_count)
+    stmt_cache_free_entry(imp_dbh->stmt_cache + --imp_dbh->stmt_cache_count);
+}
+
+/*
+  Statements the server cannot prepare (ER_UNSUPPORTED_PS), so that they
+  go straight to the emulated path rather than costing a failed prepare
+  round trip each time. mysql_db_unsupported_ps() looks a statement up,
+  mysql_db_unsupported_ps_add() remembers one, replacing the oldest entry
+  once UNSUPPORTED_PS_CACHE_SIZE are held.
+*/
+static bool unsupported_ps_find(imp_dbh_t *imp_dbh, const char *statement,
+                                STRLEN length, U32 hash)
+{
+  unsigned int i;
+  unsigned long server_version= mysql_get_server_version(imp_dbh->pmysql);
+  imp_unsupported_ps_t *entry;
+
+  for (i= 0; i < imp_dbh->unsupported_ps_count; i++)
+  {
+    entry= imp_dbh->unsupported_ps + i;
+    if (entry->hash == hash && entry->length == length &&
+        entry->server_version == server_version &&
+        memEQ(entry->statement, statement, length))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+bool mysql_db_unsupported_ps(pTHX_ imp_dbh_t *imp_dbh, const char *statement,
+                             STRLEN length)
+{
+  U32 hash;
+
+  if (!imp_dbh->unsupported_ps_count)
+    return FALSE;
+
+  PERL_HASH(hash, statement, length);
+  if (!unsupported_ps_find(imp_dbh, statement, length, hash))
+    return FALSE;
+  ++imp_dbh->stats.unsupported_ps_hits;
+  return TRUE;
+}
+
+void mysql_db_unsupported_ps_add(pTHX_ imp_dbh_t *imp_dbh,
+                                 const char *statement, STRLEN length)
+{
+  U32 hash;
+  imp_unsupported_ps_t *entry;
+
+  /* Handles prepared before the first failure find out one by one */
+  PERL_HASH(hash, statement, length);
+  if (unsupported_ps_find(imp_dbh, statement, length, hash))
+    return;
+
+  if (!imp_dbh->unsupported_ps)
+    Newz(908, imp_dbh->unsupported_ps, UNSUPPORTED_PS_CACHE_SIZE,
+         imp_unsupported_ps_t);
+
+  if (imp_dbh->unsupported_ps_count < UNSUPPORTED_PS_CACHE_SIZE)
+    entry= imp_dbh->unsupported_ps + imp_dbh->unsupported_ps_count++;
+  else
+  {
+    entry= imp_dbh->unsupported_ps + imp_dbh->unsupported_ps_next;
+    imp_dbh->unsupported_ps_next=
+      (imp_dbh->unsupported_ps_next + 1) % UNSUPPORTED_PS_CACHE_SIZE;
+    Safefree(entry->statement);
+  }
+
+  entry->statement= savepvn(statement, length);
+  entry->length= length;
+  entry->hash= hash;
+  entry->server_version= mysql_get_server_version(imp_dbh->pmysql);
+}
+
+static void unsupported_ps_free(imp_dbh_t *imp_dbh)
+{
+  while (imp_dbh->unsupported_ps_count)
+    Safefree(imp_dbh->unsupported_ps[--imp_dbh->unsupported_ps_count].statement);
+  if (imp_dbh->unsupported_ps)
+    Safefree(imp_dbh->unsupported_ps);
+  imp_dbh->unsupported_ps= NULL;
+  imp_dbh->unsupported_ps_next= 0;
+}
+
+/*
+  mysql_stmt_prepare() for statements which may end up in the statement
+  cache: if the server refuses to prepare more statements because of
+  max_prepared_stmt_count, close our idle ones, halve the cache size and
+  try once more.
+*/
+int mysql_db_stmt_prepare(pTHX_ imp_dbh_t *imp_dbh, MYSQL_STMT *stmt,
+                          const char *statement, STRLEN length)
+{
+  int retval= mysql_stmt_prepare(stmt, statement, length);
+
+#ifdef ER_MAX_PREPARED_STMT_COUNT_REACHED
+  if (retval && imp_dbh->stmt_cache_count &&
+      mysql_stmt_errno(stmt) == ER_MAX_PREPARED_STMT_COUNT_REACHED)
+  {
+    stmt_cache_resize(imp_dbh, imp_dbh->stmt_cache_count / 2);
+    mysql_db_stmt_cache_flush(aTHX_ imp_dbh);
+    retval= mysql_stmt_prepare(stmt, statement, length);
+  }
+#endif
+  return retval;
+}
+#endif
+
+/*
+ ***************************************************************************
+ *
+ *  Name:    dbd_db_disconnect
+ *
+ *  Purpose: Disconnect a database handle from its database
+ *
+ *  Input:   dbh - database handle being disconnected
+ *           imp_dbh - drivers private database handle data
+ *
+ *  Returns: TRUE for success, FALSE otherwise; do_error has already
+ *           been called in the latter case
+ *
+ **************************************************************************/
+
+int dbd_db_disconnect(SV* dbh, imp_dbh_t* imp_dbh)
+{
+#ifdef dTHR
+  dTHR;
+#endif
+  dTHX;
+  D_imp_xxh(dbh);
+
+  /* We assume that disconnect will always work       */
+  /* since most errors imply already disconnected.    */
+  DBIc_ACTIVE_off(imp_dbh);
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "imp_dbh->pmysql: %p\n",
+		              imp_dbh->pmysql);
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  mysql_db_stmt_cache_flush(aTHX_ imp_dbh);
+#endif
+  mysql_close(imp_dbh->pmysql );
+
+  /* We don't free imp_dbh since a reference still exists    */
+  /* The DESTROY method is the only one to 'free' memory.    */
+  return TRUE;
+}
+
+
+/***************************************************************************
+ *
+ *  Name:    dbd_discon_all
+ *
+ *  Purpose: Disconnect all database handles at shutdown time
+ *
+ *  Input:   dbh - database handle being disconnected
+ *           imp_dbh - drivers private database handle data
+ *
+ *  Returns: TRUE for success, FALSE otherwise; do_error has already
+ *           been called in the latter case
+ *
+ **************************************************************************/
+
+int dbd_discon_all (SV *drh, imp_drh_t *imp_drh) {
+#if defined(dTHR)
+  dTHR;
+#endif
+  dTHX;
+#if defined(DBD_MYSQL_EMBEDDED)
+  D_imp_xxh(drh);
+#else
+  PERL_UNUSED_ARG(drh);
+#endif
+
+#if defined(DBD_MYSQL_EMBEDDED)
+  if (imp_drh->embedded.state)
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "Stop embedded server\n");
+
+    mysql_server_end();
+    if (imp_drh->embedded.groups)
+    {
+      (void) SvREFCNT_dec(imp_drh->embedded.groups);
+      imp_drh->embedded.groups = NULL;
+    }
+
+    if (imp_drh->embedded.args)
+    {
+      (void) SvREFCNT_dec(imp_drh->embedded.args);
+      imp_drh->embedded.args = NULL;
+    }
 
 
   }
@@ -2471,6 +3036,250 @@ int dbd_discon_all (SV *drh, imp_drh_t *imp_drh) {
 }
 
 
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+/*
+  LOAD DATA LOCAL INFILE handler, which reads from mysql_local_infile_source
+  instead of the file named in the statement. The client library passes
+  &imp_dbh->local_infile to the callbacks.
+*/
+
+/* Appends a row as a line of tab separated, backslash escaped values */
+static void append_infile_row(pTHX_ SV *buffer, AV *row)
+{
+  I32 i, last= av_len(row);
+  STRLEN len, cur;
+  char *value, *end, *out;
+
+  for (i= 0; i <= last; i++)
+  {
+    SV **svp= av_fetch(row, i, FALSE);
+
+    if (i)
+      sv_catpvn(buffer, "\t", 1);
+    if (!svp || !SvOK(*svp))
+    {
+      sv_catpvn(buffer, "\\N", 2);
+      continue;
+    }
+    value= SvPV(*svp, len);
+    end= value + len;
+    cur= SvCUR(buffer);
+    out= SvGROW(buffer, cur + 2 * len + 2) + cur;
+    for (; value < end; value++)
+    {
+      switch (*value) {
+      case '\t':
+        *out++= '\\';
+        *out++= 't';
+        break;
+      case '\n':
+        *out++= '\\';
+        *out++= 'n';
+        break;
+      case '\r':
+        *out++= '\\';
+        *out++= 'r';
+        break;
+      case '\0':
+        *out++= '\\';
+        *out++= '0';
+        break;
+      case '\\':
+        *out++= '\\';
+        *out++= '\\';
+        break;
+      default:
+        *out++= *value;
+      }
+    }
+    SvCUR_set(buffer, out - SvPVX(buffer));
+  }
+  sv_catpvn(buffer, "\n", 1);
+}
+
+/* Calls the code ref for the next row, FALSE if it died */
+static bool fetch_infile_row(pTHX_ imp_local_infile_t *infile)
+{
+  SV *row= NULL;
+  bool ok= TRUE;
+  int count;
+  dSP;
+
+  ENTER;
+  SAVETMPS;
+  PUSHMARK(SP);
+  PUTBACK;
+  count= call_sv(infile->source, G_SCALAR | G_EVAL);
+  SPAGAIN;
+  if (count == 1)
+    row= POPs;
+  PUTBACK;
+
+  if (SvTRUE(ERRSV))
+  {
+    infile->error= newSVsv(ERRSV);
+    ok= FALSE;
+  }
+  else if (!row || !SvOK(row))
+    infile->eof= TRUE;
+  else if (SvROK(row) && SvTYPE(SvRV(row)) == SVt_PVAV)
+    append_infile_row(aTHX_ infile->buffer, (AV *) SvRV(row));
+  else
+    sv_catsv(infile->buffer, row);  /* text which is encoded already */
+
+  FREETMPS;
+  LEAVE;
+  return ok;
+}
+
+static int local_infile_init(void **ptr, const char *filename, void *userdata)
+{
+  dTHX;
+  imp_local_infile_t *infile= (imp_local_infile_t *) userdata;
+
+  PERL_UNUSED_ARG(filename);
+  *ptr= infile;
+  infile->offset= 0;
+  infile->eof= FALSE;
+  if (infile->error)
+  {
+    SvREFCNT_dec(infile->error);
+    infile->error= NULL;
+  }
+  if (!infile->buffer)
+    infile->buffer= newSVpvn("", 0);
+  SvCUR_set(infile->buffer, 0);
+  return 0;
+}
+
+static int local_infile_read(void *ptr, char *buf, unsigned int buf_len)
+{
+  dTHX;
+  imp_local_infile_t *infile= (imp_local_infile_t *) ptr;
+  SV *source= SvRV(infile->source);
+  char *data;
+  STRLEN len;
+
+  switch (SvTYPE(source)) {
+  case SVt_PVCV:
+    /* Move what is left of the last rows to the front, then add rows */
+    len= SvCUR(infile->buffer) - infile->offset;
+    if (infile->offset)
+    {
+      Move(SvPVX(infile->buffer) + infile->offset, SvPVX(infile->buffer),
+           len, char);
+      SvCUR_set(infile->buffer, len);
+      infile->offset= 0;
+    }
+    while (SvCUR(infile->buffer) < buf_len && !infile->eof)
+      if (!fetch_infile_row(aTHX_ infile))
+        return -1;
+    data= SvPVX(infile->buffer);
+    len= SvCUR(infile->buffer);
+    break;
+
+  case SVt_PVGV:
+  case SVt_PVIO:
+    {
+      IO *io= SvTYPE(source) == SVt_PVGV ? GvIO((GV *) source) : (IO *) source;
+      PerlIO *fp= io ? IoIFP(io) : NULL;
+      SSize_t count;
+
+      if (!fp)
+      {
+        infile->error= newSVpvn("file handle is not open", 23);
+        return -1;
+      }
+      count= PerlIO_read(fp, buf, buf_len);
+      if (count < 0)
+        infile->error= newSVpvf("error reading file handle: %s",
+                                Strerror(errno));
+      return (int) count;
+    }
+
+  default:
+    data= SvPV(source, len);
+  }
+
+  if (infile->offset >= len)
+    return 0;
+  len-= infile->offset;
+  if (len > buf_len)
+    len= buf_len;
+  memcpy(buf, data + infile->offset, len);
+  infile->offset+= len;
+  return (int) len;
+}
+
+static void local_infile_end(void *ptr)
+{
+  dTHX;
+  imp_local_infile_t *infile= (imp_local_infile_t *) ptr;
+
+  if (infile->buffer)
+  {
+    SvREFCNT_dec(infile->buffer);
+    infile->buffer= NULL;
+  }
+}
+
+static int local_infile_error(void *ptr, char *error_msg,
+                              unsigned int error_msg_len)
+{
+  dTHX;
+  imp_local_infile_t *infile= (imp_local_infile_t *) ptr;
+  const char *msg= infile->error ? SvPV_nolen(infile->error) :
+    "error reading mysql_local_infile_source";
+
+  strncpy(error_msg, msg, error_msg_len - 1);
+  error_msg[error_msg_len - 1]= '\0';
+  return CR_UNKNOWN_ERROR;
+}
+
+/* Installs our handler if there is a source, the default one otherwise */
+static void set_local_infile_handler(imp_dbh_t *imp_dbh)
+{
+  if (imp_dbh->local_infile.source)
+    mysql_set_local_infile_handler(imp_dbh->pmysql, local_infile_init,
+                                   local_infile_read, local_infile_end,
+                                   local_infile_error, &imp_dbh->local_infile);
+  else
+    mysql_set_local_infile_default(imp_dbh->pmysql);
+}
+
+/* A reference to a scalar, an open file handle or a code ref */
+static bool is_local_infile_source(SV *sv)
+{
+  SV *source;
+
+  if (!SvROK(sv))
+    return FALSE;
+  source= SvRV(sv);
+  switch (SvTYPE(source)) {
+  case SVt_PVCV:
+    return TRUE;
+  case SVt_PVIO:
+    return IoIFP((IO *) source) != NULL;
+  case SVt_PVGV:
+    return GvIO((GV *) source) && IoIFP(GvIO((GV *) source));
+  default:
+    return SvTYPE(source) < SVt_PVAV && !SvROK(source);
+  }
+}
+
+/* Releases the source and what is left of the last LOAD DATA */
+static void free_local_infile(pTHX_ imp_local_infile_t *infile)
+{
+  if (infile->source)
+    SvREFCNT_dec(infile->source);
+  if (infile->buffer)
+    SvREFCNT_dec(infile->buffer);
+  if (infile->error)
+    SvREFCNT_dec(infile->error);
+  infile->source= infile->buffer= infile->error= NULL;
+}
+#endif
+
 /****************************************************************************
  *
  *  Name:    dbd_db_destroy
@@ -2485,6 +3294,7 @@ int dbd_discon_all (SV *drh, imp_drh_t *imp_drh) {
  **************************************************************************/
 
 void dbd_db_destroy(SV* dbh, imp_dbh_t* imp_dbh) {
+  dTHX;
 
     /*
      *  Being on the safe side never hurts ...
@@ -2503,6 +3313,14 @@ void dbd_db_destroy(SV* dbh, imp_dbh_t* imp_dbh) {
     }
     dbd_db_disconnect(dbh, imp_dbh);
   }
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  stmt_cache_resize(imp_dbh, 0);
+  unsupported_ps_free(imp_dbh);
+#endif
+  free_query_buf(&imp_dbh->query_buf, &imp_dbh->query_buf_size, FALSE);
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+  free_local_infile(aTHX_ &imp_dbh->local_infile);
+#endif
   Safefree(imp_dbh->pmysql);
 
   /* Tell DBI, that dbh->destroy must no longer be called */
@@ -2594,12 +3412,32 @@ dbd_db_STORE_attrib(
     imp_dbh->use_server_side_prepare = bool_value;
   else if (kl == 37 && strEQ(key, "mysql_server_prepare_disable_fallback"))
     imp_dbh->disable_fallback_for_server_prepare = bool_value;
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  else if (kl == 31 && strEQ(key, "mysql_server_prepare_cache_size"))
+  {
+    IV size= SvIV(valuesv);
+    stmt_cache_resize(imp_dbh, size > 0 ? (unsigned int) size : 0);
+  }
+#endif
   else if (kl == 23 && strEQ(key,"mysql_no_autocommit_cmd"))
     imp_dbh->no_autocommit_cmd = bool_value;
   else if (kl == 24 && strEQ(key,"mysql_bind_type_guessing"))
     imp_dbh->bind_type_guessing = bool_value;
   else if (kl == 31 && strEQ(key,"mysql_bind_comment_placeholders"))
     imp_dbh->bind_type_guessing = bool_value;
+  else if (kl == 23 && strEQ(key,"mysql_bind_native_types"))
+    imp_dbh->bind_native_types = bool_value;
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+  else if (kl == 25 && strEQ(key, "mysql_local_infile_source"))
+  {
+    if (SvOK(valuesv) && !is_local_infile_source(valuesv))
+      croak("mysql_local_infile_source must be a reference to a scalar, an open file handle or a code reference");
+    if (imp_dbh->local_infile.source)
+      SvREFCNT_dec(imp_dbh->local_infile.source);
+    imp_dbh->local_infile.source= SvOK(valuesv) ? newSVsv(valuesv) : NULL;
+    set_local_infile_handler(imp_dbh);
+  }
+#endif
 #if defined(sv_utf8_decode) && MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
   else if (kl == 17 && strEQ(key, "mysql_enable_utf8"))
     imp_dbh->enable_utf8 = bool_value;
@@ -2719,6 +3557,11 @@ SV* dbd_db_FETCH_attrib(SV *dbh, imp_dbh_t *imp_dbh, SV *keysv)
     {
       result = sv_2mortal(newSViv(imp_dbh->bind_comment_placeholders));
     }
+    else if (kl == strlen("bind_native_types") &&
+        strEQ(key, "bind_native_types"))
+    {
+      result = sv_2mortal(newSViv(imp_dbh->bind_native_types));
+    }
     break;
   case 'c':
     if (kl == 10 && strEQ(key, "clientinfo"))
@@ -2768,14 +3611,58 @@ SV* dbd_db_FETCH_attrib(SV *dbh, imp_dbh_t *imp_dbh, SV *keysv)
                newSViv(imp_dbh->stats.auto_reconnects_failed),
                0
               );
-
-      result= sv_2mortal((newRV_noinc((SV*)hv)));
-    }
-
-  case 'h':
-    if (strEQ(key, "hostinfo"))
-    {
-      const char* hostinfo = mysql_get_host_info(imp_dbh->pmysql);
+      (void)hv_store(
+               hv,
+               "prepare_cache_hits",
+               strlen("prepare_cache_hits"),
+               newSVuv(imp_dbh->stats.prepare_cache_hits),
+               0
+              );
+      (void)hv_store(
+               hv,
+               "prepare_cache_misses",
+               strlen("prepare_cache_misses"),
+               newSVuv(imp_dbh->stats.prepare_cache_misses),
+               0
+              );
+      (void)hv_store(
+               hv,
+               "prepare_cache_evictions",
+               strlen("prepare_cache_evictions"),
+               newSVuv(imp_dbh->stats.prepare_cache_evictions),
+               0
+              );
+      (void)hv_store(
+               hv,
+               "unsupported_ps_hits",
+               strlen("unsupported_ps_hits"),
+               newSVuv(imp_dbh->stats.unsupported_ps_hits),
+               0
+              );
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+      (void)hv_store(
+               hv,
+               "unsupported_ps_count",
+               strlen("unsupported_ps_count"),
+               newSVuv(imp_dbh->unsupported_ps_count),
+               0
+              );
+#endif
+      (void)hv_store(
+               hv,
+               "prefetch_stops",
+               strlen("prefetch_stops"),
+               newSVuv(imp_dbh->stats.prefetch_stops),
+               0
+              );
+
+      result= sv_2mortal((newRV_noinc((SV*)hv)));
+    }
+
+  case 'h':
+    if (strEQ(key, "hostinfo"))
+    {
+      const char* hostinfo = mysql_get_host_info(imp_dbh->pmysql);
       result= hostinfo ?
         sv_2mortal(newSVpvn(hostinfo, strlen(hostinfo))) : &PL_sv_undef;
     }
@@ -2791,6 +3678,14 @@ SV* dbd_db_FETCH_attrib(SV *dbh, imp_dbh_t *imp_dbh, SV *keysv)
       /* We cannot return an IV, because the insertid is a long. */
       result= sv_2mortal(my_ulonglong2str(aTHX_ mysql_insert_id(imp_dbh->pmysql)));
     break;
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+  case 'l':
+    if (kl == strlen("local_infile_source") &&
+        strEQ(key, "local_infile_source"))
+      result= imp_dbh->local_infile.source ?
+        sv_2mortal(newSVsv(imp_dbh->local_infile.source)) : &PL_sv_undef;
+    break;
+#endif
   case 'n':
     if (kl == strlen("no_autocommit_cmd") &&
         strEQ(key, "no_autocommit_cmd"))
@@ -2831,6 +3726,10 @@ SV* dbd_db_FETCH_attrib(SV *dbh, imp_dbh_t *imp_dbh, SV *keysv)
         result= sv_2mortal(newSViv((IV) imp_dbh->use_server_side_prepare));
     else if (kl == 31 && strEQ(key, "server_prepare_disable_fallback"))
         result= sv_2mortal(newSViv((IV) imp_dbh->disable_fallback_for_server_prepare));
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+    else if (kl == 25 && strEQ(key, "server_prepare_cache_size"))
+        result= sv_2mortal(newSViv((IV) imp_dbh->stmt_cache_size));
+#endif
     break;
 
   case 't':
@@ -2857,6 +3756,139 @@ SV* dbd_db_FETCH_attrib(SV *dbh, imp_dbh_t *imp_dbh, SV *keysv)
 }
 
 
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/*
+  Prepares the statement on the server, or takes it from the statement
+  cache. Returns FALSE after do_error; if the server cannot prepare the
+  statement and falling back is allowed, use_server_side_prepare is
+  turned off instead.
+*/
+static int sth_server_prepare(pTHX_ SV *sth, imp_sth_t *imp_sth,
+                              imp_dbh_t *imp_dbh, char *statement)
+{
+  D_imp_xxh(sth);
+  int i, prepare_retval;
+  MYSQL_BIND *bind, *bind_end;
+  imp_sth_phb_t *fbind;
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t\tuse_server_side_prepare set\n");
+  /* do we really need this? If we do, we should return, not just continue */
+  if (imp_sth->stmt)
+    fprintf(stderr,
+            "ERROR: Trying to prepare new stmt while we have \
+            already not closed one \n");
+
+  if (!imp_sth->disable_fallback_for_server_prepare &&
+      mysql_db_unsupported_ps(aTHX_ imp_dbh, statement, strlen(statement)))
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tnot supported by server side prepare, emulated\n");
+    imp_sth->use_server_side_prepare= 0;
+    return TRUE;
+  }
+
+  if (mysql_db_stmt_cache_fetch(aTHX_ imp_dbh, statement, strlen(statement),
+                                &imp_sth->stmt_cache_entry))
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tusing cached server side prepared statement\n");
+    imp_sth->stmt= imp_sth->stmt_cache_entry.stmt;
+    imp_sth->stmt_cache_entry.stmt= NULL;
+    prepare_retval= 0;
+  }
+  else
+  {
+    imp_sth->stmt= mysql_stmt_init(imp_dbh->pmysql);
+
+    if (! imp_sth->stmt)
+    {
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                      "\t\tERROR: Unable to return MYSQL_STMT structure \
+                      from mysql_stmt_init(): ERROR NO: %d ERROR MSG:%s\n",
+                      mysql_errno(imp_dbh->pmysql),
+                      mysql_error(imp_dbh->pmysql));
+    }
+
+    prepare_retval= mysql_db_stmt_prepare(aTHX_ imp_dbh,
+                                          imp_sth->stmt,
+                                          statement,
+                                          strlen(statement));
+  }
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tmysql_stmt_prepare returned %d\n",
+                    prepare_retval);
+
+  if (prepare_retval)
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tmysql_stmt_prepare %d %s\n",
+                    mysql_stmt_errno(imp_sth->stmt),
+                    mysql_stmt_error(imp_sth->stmt));
+
+    /* Never hand a statement that failed to prepare to the cache */
+    mysql_db_stmt_cache_store(aTHX_ imp_dbh, &imp_sth->stmt_cache_entry);
+
+    /* For commands that are not supported by server side prepared statement
+       mechanism lets try to pass them through regular API */
+    if (!imp_sth->disable_fallback_for_server_prepare && mysql_stmt_errno(imp_sth->stmt) == ER_UNSUPPORTED_PS)
+    {
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t\tSETTING imp_sth->use_server_side_prepare to 0\n");
+      imp_sth->use_server_side_prepare= 0;
+      mysql_db_unsupported_ps_add(aTHX_ imp_dbh, statement, strlen(statement));
+    }
+    else
+    {
+      do_error(sth, mysql_stmt_errno(imp_sth->stmt),
+               mysql_stmt_error(imp_sth->stmt),
+              mysql_sqlstate(imp_dbh->pmysql));
+      mysql_stmt_close(imp_sth->stmt);
+      imp_sth->stmt= NULL;
+      return FALSE;
+    }
+  }
+  else
+  {
+    DBIc_NUM_PARAMS(imp_sth)= mysql_stmt_param_count(imp_sth->stmt);
+    /* mysql_stmt_param_count */
+
+    if (DBIc_NUM_PARAMS(imp_sth) > 0)
+    {
+      /* Allocate memory for bind variables */
+      imp_sth->bind=            alloc_bind(DBIc_NUM_PARAMS(imp_sth));
+      imp_sth->fbind=           alloc_fbind(DBIc_NUM_PARAMS(imp_sth));
+      imp_sth->has_been_bound=  0;
+
+      /* Initialize ph variables with  NULL values */
+      for (i= 0,
+           bind=      imp_sth->bind,
+           fbind=     imp_sth->fbind,
+           bind_end=  bind+DBIc_NUM_PARAMS(imp_sth);
+           bind < bind_end ;
+           bind++, fbind++, i++ )
+      {
+        bind->buffer_type=  MYSQL_TYPE_STRING;
+        bind->buffer=       NULL;
+        bind->length=       &(fbind->length);
+        bind->is_null=      (char*) &(fbind->is_null);
+        fbind->is_null=     1;
+        fbind->length=      0;
+      }
+    }
+  }
+  return TRUE;
+}
+#endif
+
+
 /* 
  **************************************************************************
  *
@@ -2891,9 +3923,6 @@ dbd_st_prepare(
   int limit_flag=0;
 #endif
 #endif
-  int prepare_retval;
-  MYSQL_BIND *bind, *bind_end;
-  imp_sth_phb_t *fbind;
 #endif
   D_imp_xxh(sth);
   D_imp_dbh_from_sth;
@@ -2907,6 +3936,11 @@ dbd_st_prepare(
  /* Set default value of 'mysql_server_prepare' attribute for sth from dbh */
   imp_sth->use_server_side_prepare= imp_dbh->use_server_side_prepare;
   imp_sth->disable_fallback_for_server_prepare= imp_dbh->disable_fallback_for_server_prepare;
+  imp_sth->bind_native_types= imp_dbh->bind_native_types;
+  imp_sth->server_cursor= FALSE;
+  imp_sth->cursor_prefetch_rows= 0;
+  imp_sth->adaptive_buffer_limit= 0;
+  imp_sth->defer_blobs= FALSE;
   if (attribs)
   {
     svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_server_prepare", 20);
@@ -2917,6 +3951,24 @@ dbd_st_prepare(
     imp_sth->disable_fallback_for_server_prepare = (svp) ?
       SvTRUE(*svp) : imp_dbh->disable_fallback_for_server_prepare;
 
+    svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_bind_native_types", 23);
+    if (svp)
+      imp_sth->bind_native_types= SvTRUE(*svp);
+
+    svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_server_cursor", 19);
+    imp_sth->server_cursor= svp && SvTRUE(*svp);
+
+    svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_defer_blobs", 17);
+    imp_sth->defer_blobs= svp && SvTRUE(*svp);
+
+    svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_cursor_prefetch_rows", 26);
+    imp_sth->cursor_prefetch_rows= svp && SvIV(*svp) > 0 ?
+      (unsigned long) SvIV(*svp) : 0;
+
+    svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_adaptive_buffer_limit", 27);
+    imp_sth->adaptive_buffer_limit= svp && SvIV(*svp) > 0 ?
+      (unsigned long) SvIV(*svp) : 0;
+
     svp = DBD_ATTRIB_GET_SVP(attribs, "async", 5);
 
     if(svp && SvTRUE(*svp)) {
@@ -2943,12 +3995,28 @@ dbd_st_prepare(
   imp_sth->done_desc= 0;
   imp_sth->result= NULL;
   imp_sth->currow= 0;
+  imp_sth->current_row= NULL;
 
   /* Set default value of 'mysql_use_result' attribute for sth from dbh */
   svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_use_result", 16);
   imp_sth->use_mysql_use_result= svp ?
     SvTRUE(*svp) : imp_dbh->use_mysql_use_result;
 
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_bind_by_reference", 23);
+  imp_sth->bind_by_reference= svp && SvTRUE(*svp);
+
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_borrow_strings", 20);
+  imp_sth->borrow_strings= svp && SvTRUE(*svp);
+
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_compact_result", 20);
+  imp_sth->compact_result= svp && SvTRUE(*svp);
+
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_result_spill_bytes", 24);
+  imp_sth->result_spill_bytes= svp ? SvUV(*svp) : 0;
+
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_prefetch_rows", 19);
+  imp_sth->prefetch_rows= svp ? SvIV(*svp) : 0;
+
   for (i= 0; i < AV_ATTRIB_LAST; i++)
     imp_sth->av_attr[i]= Nullav;
 
@@ -3051,94 +4119,9 @@ dbd_st_prepare(
 #endif
 
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  if (imp_sth->use_server_side_prepare)
-  {
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                    "\t\tuse_server_side_prepare set\n");
-    /* do we really need this? If we do, we should return, not just continue */
-    if (imp_sth->stmt)
-      fprintf(stderr,
-              "ERROR: Trying to prepare new stmt while we have \
-              already not closed one \n");
-
-    imp_sth->stmt= mysql_stmt_init(imp_dbh->pmysql);
-
-    if (! imp_sth->stmt)
-    {
-      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                      "\t\tERROR: Unable to return MYSQL_STMT structure \
-                      from mysql_stmt_init(): ERROR NO: %d ERROR MSG:%s\n",
-                      mysql_errno(imp_dbh->pmysql),
-                      mysql_error(imp_dbh->pmysql));
-    }
-
-    prepare_retval= mysql_stmt_prepare(imp_sth->stmt,
-                                       statement,
-                                       strlen(statement));
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                      "\t\tmysql_stmt_prepare returned %d\n",
-                      prepare_retval);
-
-    if (prepare_retval)
-    {
-      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                      "\t\tmysql_stmt_prepare %d %s\n",
-                      mysql_stmt_errno(imp_sth->stmt),
-                      mysql_stmt_error(imp_sth->stmt));
-
-      /* For commands that are not supported by server side prepared statement
-         mechanism lets try to pass them through regular API */
-      if (!imp_sth->disable_fallback_for_server_prepare && mysql_stmt_errno(imp_sth->stmt) == ER_UNSUPPORTED_PS)
-      {
-        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                    "\t\tSETTING imp_sth->use_server_side_prepare to 0\n");
-        imp_sth->use_server_side_prepare= 0;
-      }
-      else
-      {
-        do_error(sth, mysql_stmt_errno(imp_sth->stmt),
-                 mysql_stmt_error(imp_sth->stmt),
-                mysql_sqlstate(imp_dbh->pmysql));
-        mysql_stmt_close(imp_sth->stmt);
-        imp_sth->stmt= NULL;
-        return FALSE;
-      }
-    }
-    else
-    {
-      DBIc_NUM_PARAMS(imp_sth)= mysql_stmt_param_count(imp_sth->stmt);
-      /* mysql_stmt_param_count */
-
-      if (DBIc_NUM_PARAMS(imp_sth) > 0)
-      {
-        /* Allocate memory for bind variables */
-        imp_sth->bind=            alloc_bind(DBIc_NUM_PARAMS(imp_sth));
-        imp_sth->fbind=           alloc_fbind(DBIc_NUM_PARAMS(imp_sth));
-        imp_sth->has_been_bound=  0;
-
-        /* Initialize ph variables with  NULL values */
-        for (i= 0,
-             bind=      imp_sth->bind,
-             fbind=     imp_sth->fbind,
-             bind_end=  bind+DBIc_NUM_PARAMS(imp_sth);
-             bind < bind_end ;
-             bind++, fbind++, i++ )
-        {
-          bind->buffer_type=  MYSQL_TYPE_STRING;
-          bind->buffer=       NULL;
-          bind->length=       &(fbind->length);
-          bind->is_null=      (char*) &(fbind->is_null);
-          fbind->is_null=     1;
-          fbind->length=      0;
-        }
-      }
-    }
-  }
+  if (imp_sth->use_server_side_prepare &&
+      !sth_server_prepare(aTHX_ sth, imp_sth, imp_dbh, statement))
+    return FALSE;
 #endif
 
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
@@ -3153,6 +4136,16 @@ dbd_st_prepare(
 
   /* Allocate memory for parameters */
   imp_sth->params= alloc_param(DBIc_NUM_PARAMS(imp_sth));
+
+  /* Find the placeholders once, rather than on each execute */
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (imp_sth->use_server_side_prepare == 0 && DBIc_NUM_PARAMS(imp_sth))
+#else
+  if (DBIc_NUM_PARAMS(imp_sth))
+#endif
+    imp_sth->params_tmpl= compile_params((imp_xxh_t *)imp_dbh, aTHX_ statement,
+                                         strlen(statement),
+                                         imp_dbh->bind_comment_placeholders);
   DBIc_IMPSET_on(imp_sth);
 
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
@@ -3160,721 +4153,2696 @@ dbd_st_prepare(
   return 1;
 }
 
-/***************************************************************************
- * Name: dbd_st_free_result_sets
- *
- * Purpose: Clean-up single or multiple result sets (if any)
- *
- * Inputs: sth - Statement handle
- *         imp_sth - driver's private statement handle
- *
- * Returns: 1 ok
- *          0 error
- *************************************************************************/
-int mysql_st_free_result_sets (SV * sth, imp_sth_t * imp_sth)
+#ifdef HAVE_PREFETCH_ROWS
+/*
+  Read ahead of mysql_use_result, see mysql_prefetch_rows. Only the thread
+  writes head and only the statement writes tail; whoever finds the ring
+  full or empty sleeps on cond, and the other side wakes it after moving
+  its position if somebody is waiting. The thread uses the client library
+  and plain malloc only, never Perl.
+*/
+static void prefetch_wake(imp_prefetch_t *p)
 {
-  dTHX;
-  D_imp_dbh_from_sth;
-  D_imp_xxh(sth);
-  int next_result_rc= -1;
+  if (__atomic_load_n(&p->waiting, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
 
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t>- dbd_st_free_result_sets\n");
+static void *prefetch_thread(void *arg)
+{
+  imp_prefetch_t *p= (imp_prefetch_t *) arg;
+  unsigned long head= p->head;
 
-#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
-  do
+  /* as the client library wants of every thread using it */
+  mysql_thread_init();
+
+  while (!__atomic_load_n(&p->cancel, __ATOMIC_SEQ_CST))
   {
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets RC %d\n", next_result_rc);
+    MYSQL_ROW cols;
+    unsigned long *lengths;
+    imp_prefetch_row_t *row;
+    size_t need= 0;
+    unsigned int i;
+    char *data;
+
+    /* Back-pressure: wait for the statement to fetch a row */
+    if (head - __atomic_load_n(&p->tail, __ATOMIC_SEQ_CST) == p->size)
+    {
+      pthread_mutex_lock(&p->lock);
+      __atomic_add_fetch(&p->waiting, 1, __ATOMIC_SEQ_CST);
+      while (head - __atomic_load_n(&p->tail, __ATOMIC_SEQ_CST) == p->size &&
+             !__atomic_load_n(&p->cancel, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&p->cond, &p->lock);
+      __atomic_sub_fetch(&p->waiting, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&p->lock);
+      continue;
+    }
 
-    if (next_result_rc == 0)
+    if (!(cols= mysql_fetch_row(p->result)))
     {
-      if (!(imp_sth->result = mysql_use_result(imp_dbh->pmysql)))
-      {
-        /* Check for possible error */
-        if (mysql_field_count(imp_dbh->pmysql))
-        {
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets ERROR: %s\n",
-                                  mysql_error(imp_dbh->pmysql));
+      p->eof= 1;
+      break;
+    }
+    lengths= mysql_fetch_lengths(p->result);
 
-          do_error(sth, mysql_errno(imp_dbh->pmysql), mysql_error(imp_dbh->pmysql),
-                   mysql_sqlstate(imp_dbh->pmysql));
-          return 0;
-        }
+    row= p->rows + head % p->size;
+    for (i= 0; i < p->num_fields; i++)
+      need+= lengths[i] + 1;
+    if (need > row->data_size)
+    {
+      /* The row is lost, dbd_st_fetch reports the error */
+      if (!(data= realloc(row->data, need)))
+      {
+        p->failed= 1;
+        break;
       }
+      row->data= data;
+      row->data_size= need;
     }
-    if (imp_sth->result)
+    for (i= 0, data= row->data; i < p->num_fields; i++)
     {
-      mysql_free_result(imp_sth->result);
-      imp_sth->result=NULL;
+      row->lengths[i]= lengths[i];
+      if (!cols[i])
+      {
+        row->cols[i]= NULL;
+        continue;
+      }
+      memcpy(data, cols[i], lengths[i]);
+      data[lengths[i]]= '\0';
+      row->cols[i]= data;
+      data+= lengths[i] + 1;
     }
-  } while ((next_result_rc=mysql_next_result(imp_dbh->pmysql))==0);
-
-  if (next_result_rc > 0)
-  {
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets: Error while processing multi-result set: %s\n",
-                    mysql_error(imp_dbh->pmysql));
 
-    do_error(sth, mysql_errno(imp_dbh->pmysql), mysql_error(imp_dbh->pmysql),
-             mysql_sqlstate(imp_dbh->pmysql));
+    __atomic_store_n(&p->head, ++head, __ATOMIC_SEQ_CST);
+    prefetch_wake(p);
   }
 
-#else
+  mysql_thread_end();
+  pthread_mutex_lock(&p->lock);
+  __atomic_store_n(&p->done, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
 
-  if (imp_sth->result)
-  {
-    mysql_free_result(imp_sth->result);
-    imp_sth->result=NULL;
-  }
-#endif
+static void prefetch_join(imp_prefetch_t *p, imp_dbh_t *imp_dbh)
+{
+  pthread_join(p->thread, NULL);
+  p->running= FALSE;
+  if (imp_dbh->prefetch == p)
+    imp_dbh->prefetch= NULL;
+}
 
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets\n");
+/*
+  Stops the thread, leaving the rows it read for dbd_st_fetch, which reads
+  the remaining ones itself. Called before the connection is used for
+  anything else, see mysql_dbh_enter and mysql_sth_enter.
+*/
+void mysql_prefetch_stop(imp_prefetch_t *p, imp_dbh_t *imp_dbh)
+{
+  if (!p->running)
+    return;
+  __atomic_store_n(&p->cancel, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&p->lock);
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  prefetch_join(p, imp_dbh);
+  ++imp_dbh->stats.prefetch_stops;
+}
 
-  return 1;
+/* See D_imp_dbh in dbdimp.h */
+imp_dbh_t *mysql_dbh_enter(imp_dbh_t *imp_dbh)
+{
+  PREFETCH_STOP(imp_dbh);
+  return imp_dbh;
 }
 
+imp_sth_t *mysql_sth_enter(imp_sth_t *imp_sth)
+{
+  imp_dbh_t *imp_dbh= (imp_dbh_t *) DBIc_PARENT_COM(imp_sth);
 
-#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
-/***************************************************************************
- * Name: dbd_st_more_results
- *
- * Purpose: Move onto the next result set (if any)
- *
- * Inputs: sth - Statement handle
- *         imp_sth - driver's private statement handle
- *
- * Returns: 1 if there are more results sets
- *          0 if there are not
- *         -1 for errors.
- *************************************************************************/
-int dbd_st_more_results(SV* sth, imp_sth_t* imp_sth)
+  if (imp_dbh->prefetch && imp_dbh->prefetch != imp_sth->prefetch)
+    mysql_prefetch_stop(imp_dbh->prefetch, imp_dbh);
+  return imp_sth;
+}
+
+/* Starts reading ahead the rows of the statement's mysql_use_result */
+static void prefetch_start(pTHX_ SV *sth, imp_sth_t *imp_sth,
+                           imp_dbh_t *imp_dbh)
 {
-  dTHX;
-  D_imp_dbh_from_sth;
+  imp_prefetch_t *p;
+  unsigned long i;
+  sigset_t all, old;
+  int rc;
   D_imp_xxh(sth);
 
-  int use_mysql_use_result=imp_sth->use_mysql_use_result;
-  int next_result_return_code, i;
-  MYSQL* svsock= imp_dbh->pmysql;
-
-  if (!SvROK(sth) || SvTYPE(SvRV(sth)) != SVt_PVHV)
-    croak("Expected hash array");
-
-  if (!mysql_more_results(svsock))
+  Newz(908, p, 1, imp_prefetch_t);
+  p->result= imp_sth->result;
+  p->num_fields= mysql_num_fields(imp_sth->result);
+  p->size= imp_sth->prefetch_rows;
+  Newz(908, p->rows, p->size, imp_prefetch_row_t);
+  for (i= 0; i < p->size; i++)
   {
-    /* No more pending result set(s)*/
+    New(908, p->rows[i].cols, p->num_fields ? p->num_fields : 1, char *);
+    New(908, p->rows[i].lengths, p->num_fields ? p->num_fields : 1,
+        unsigned long);
+  }
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  imp_sth->prefetch= p;
+
+  /* Signals are for the thread running perl */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  rc= pthread_create(&p->thread, NULL, prefetch_thread, p);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (rc)
+  {
+    /* dbd_st_fetch reads the rows itself then */
     if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
       PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-		    "\n      <- dbs_st_more_results no more results\n");
-    return 0;
+                    "\t\tprefetch thread not started: %s\n", strerror(rc));
+    return;
   }
+  p->running= TRUE;
+  imp_dbh->prefetch= p;
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t\tprefetching up to %lu rows\n", p->size);
+}
 
-  if (imp_sth->use_server_side_prepare)
-  {
-    do_warn(sth, JW_ERR_NOT_IMPLEMENTED,
-            "Processing of multiple result set is not possible with server side prepare");
-    return 0;
-  }
+/* Stops reading ahead and frees the rows read */
+static void prefetch_free(imp_sth_t *imp_sth, imp_dbh_t *imp_dbh)
+{
+  imp_prefetch_t *p= imp_sth->prefetch;
+  unsigned long i;
 
-  /*
-   *  Free cached array attributes
-   */
-  for (i= 0; i < AV_ATTRIB_LAST;  i++)
+  mysql_prefetch_stop(p, imp_dbh);
+  for (i= 0; i < p->size; i++)
   {
-    if (imp_sth->av_attr[i])
-      SvREFCNT_dec(imp_sth->av_attr[i]);
-
-    imp_sth->av_attr[i]= Nullav;
+    Safefree(p->rows[i].cols);
+    Safefree(p->rows[i].lengths);
+    free(p->rows[i].data);
   }
+  Safefree(p->rows);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->cond);
+  Safefree(p);
+  imp_sth->prefetch= NULL;
+}
 
-  /* Release previous MySQL result*/
-  if (imp_sth->result)
-    mysql_free_result(imp_sth->result);
-
-  if (DBIc_ACTIVE(imp_sth))
-    DBIc_ACTIVE_off(imp_sth);
-
-  next_result_return_code= mysql_next_result(svsock);
+/*
+  The error left in the connection is the thread's while it runs and once
+  it read past the last row; if it was stopped, it is the error of
+  whatever used the connection since, which fetching does not care about
+*/
+static bool prefetch_keeps_error(imp_sth_t *imp_sth)
+{
+  return imp_sth->prefetch &&
+    (imp_sth->prefetch->running || imp_sth->prefetch->eof);
+}
 
-  imp_sth->warning_count = mysql_warning_count(imp_dbh->pmysql);
+/* The next row read ahead, see sth_fetch_row */
+static MYSQL_ROW prefetch_fetch_row(imp_sth_t *imp_sth, imp_dbh_t *imp_dbh,
+                                    unsigned long **lengths)
+{
+  imp_prefetch_t *p= imp_sth->prefetch;
+  unsigned long tail= p->tail;
+  MYSQL_ROW cols;
 
-  /*
-    mysql_next_result returns
-      0 if there are more results
-     -1 if there are no more results
-     >0 if there was an error
-   */
-  if (next_result_return_code > 0)
+  /* The row fetched last time is done with */
+  if (p->holding)
   {
-    do_error(sth, mysql_errno(svsock), mysql_error(svsock),
-             mysql_sqlstate(svsock));
-
-    return 0;
+    __atomic_store_n(&p->tail, ++tail, __ATOMIC_SEQ_CST);
+    p->holding= FALSE;
+    prefetch_wake(p);
   }
-  else if(next_result_return_code == -1)                                                                                                                  
-  {                                                                                                                                                       
-    return 0;                                                                                                                                             
-  }  
-  else
-  {
-    /* Store the result from the Query */
-    imp_sth->result = use_mysql_use_result ?
-     mysql_use_result(svsock) : mysql_store_result(svsock);
 
-    if (mysql_errno(svsock))
+  for (;;)
+  {
+    if (__atomic_load_n(&p->head, __ATOMIC_SEQ_CST) != tail)
     {
-      do_error(sth, mysql_errno(svsock), mysql_error(svsock), 
-               mysql_sqlstate(svsock));
-      return 0;
+      imp_prefetch_row_t *row= p->rows + tail % p->size;
+      p->holding= TRUE;
+      *lengths= row->lengths;
+      return row->cols;
     }
-
-    imp_sth->row_num= mysql_affected_rows(imp_dbh->pmysql);
-
-    if (imp_sth->result == NULL)
+    if (!p->running)
+      break;
+    if (__atomic_load_n(&p->done, __ATOMIC_SEQ_CST))
     {
-      /* No "real" rowset*/
-      DBIc_NUM_FIELDS(imp_sth)= 0; /* for DBI <= 1.53 */
-      DBIS->set_attr_k(sth, sv_2mortal(newSVpvn("NUM_OF_FIELDS",13)), 0,
-			               sv_2mortal(newSViv(0)));
-      return 1;
+      prefetch_join(p, imp_dbh);
+      continue;
     }
-    else
-    {
-      /* We have a new rowset */
-      imp_sth->currow=0;
-
-
-      /* delete cached handle attributes */
-      /* XXX should be driven by a list to ease maintenance */
-      (void)hv_delete((HV*)SvRV(sth), "NAME", 4, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "NULLABLE", 8, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "NUM_OF_FIELDS", 13, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "PRECISION", 9, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "SCALE", 5, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "TYPE", 4, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_insertid", 14, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_is_auto_increment", 23, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_is_blob", 13, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_is_key", 12, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_is_num", 12, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_is_pri_key", 16, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_length", 12, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_max_length", 16, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_table", 11, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_type", 10, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_type_name", 15, G_DISCARD);
-      (void)hv_delete((HV*)SvRV(sth), "mysql_warning_count", 20, G_DISCARD);
-
-      /* Adjust NUM_OF_FIELDS - which also adjusts the row buffer size */
-      DBIc_NUM_FIELDS(imp_sth)= 0; /* for DBI <= 1.53 */
-      DBIc_DBISTATE(imp_sth)->set_attr_k(sth, sv_2mortal(newSVpvn("NUM_OF_FIELDS",13)), 0,
-          sv_2mortal(newSViv(mysql_num_fields(imp_sth->result)))
-      );
+    pthread_mutex_lock(&p->lock);
+    __atomic_add_fetch(&p->waiting, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&p->head, __ATOMIC_SEQ_CST) == tail &&
+           !__atomic_load_n(&p->done, __ATOMIC_SEQ_CST))
+      pthread_cond_wait(&p->cond, &p->lock);
+    __atomic_sub_fetch(&p->waiting, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&p->lock);
+  }
 
-      DBIc_ACTIVE_on(imp_sth);
+  /*
+    The thread saw the end, the error if any is left in the handle, or
+    it ran out of memory, see sth_fetch_error
+  */
+  if (p->eof || p->failed)
+    return NULL;
+  /* or it was stopped, the remaining rows are read here */
+  if ((cols= mysql_fetch_row(imp_sth->result)))
+    *lengths= mysql_fetch_lengths(imp_sth->result);
+  return cols;
+}
+#endif
 
-      imp_sth->done_desc = 0;
-    }
-    imp_dbh->pmysql->net.last_errno= 0;
-    return 1;
+/*
+  mysql_compact_result: the rows of mysql_use_result are copied into a
+  block which only holds their bytes, rather than the MYSQL_ROWS list of
+  mysql_store_result with a pointer per value and a malloc per row.
+*/
+static void compact_result_free(imp_compact_result_t *c)
+{
+#ifdef HAVE_RESULT_SPILL
+  if (c->spill_fd >= 0)
+  {
+    munmap(c->data, c->data_capacity);
+    close(c->spill_fd);
   }
-}
+  else
 #endif
-/**************************************************************************
- *
- *  Name:    mysql_st_internal_execute
- *
- *  Purpose: Internal version for executing a statement, called both from
- *           within the "do" and the "execute" method.
- *
- *  Inputs:  h - object handle, for storing error messages
- *           statement - query being executed
- *           attribs - statement attributes, currently ignored
- *           num_params - number of parameters being bound
- *           params - parameter array
- *           result - where to store results, if any
- *           svsock - socket connected to the database
- *
- **************************************************************************/
+  Safefree(c->data);
+  Safefree(c->index);
+  Safefree(c->cols);
+  Safefree(c->lengths);
+  Safefree(c);
+}
 
+/* Bytes of the block in the temporary file, see mysql_result_spilled */
+static size_t compact_result_spilled(imp_compact_result_t *c)
+{
+  return c->spill_fd >= 0 ? c->data_capacity : 0;
+}
 
-my_ulonglong mysql_st_internal_execute(
-                                       SV *h, /* could be sth or dbh */
-                                       SV *statement,
-                                       SV *attribs,
-                                       int num_params,
-                                       imp_sth_ph_t *params,
-                                       MYSQL_RES **result,
-                                       MYSQL *svsock,
-                                       int use_mysql_use_result
-                                      )
+/* Bytes held in memory for the rows, see mysql_result_memory */
+static size_t compact_result_memory(imp_compact_result_t *c)
 {
-  dTHX;
-  bool bind_type_guessing= FALSE;
-  bool bind_comment_placeholders= TRUE;
-  STRLEN slen;
-  char *sbuf = SvPV(statement, slen);
-  char *table;
-  char *salloc;
-  int htype;
-#if MYSQL_ASYNC
-  bool async = FALSE;
-#endif
-  my_ulonglong rows= 0;
-  /* thank you DBI.c for this info! */
-  D_imp_xxh(h);
-  attribs= attribs;
+  return sizeof(*c) + c->data_capacity - compact_result_spilled(c) +
+    c->index_capacity * sizeof(size_t) +
+    c->num_fields * (sizeof(char *) + sizeof(unsigned long));
+}
 
-  htype= DBIc_TYPE(imp_xxh);
-  /*
-    It is important to import imp_dbh properly according to the htype
-    that it is! Also, one might ask why bind_type_guessing is assigned
-    in each block. Well, it's because D_imp_ macros called in these
-    blocks make it so imp_dbh is not "visible" or defined outside of the
-    if/else (when compiled, it fails for imp_dbh not being defined).
-  */
-  /* h is a dbh */
-  if (htype == DBIt_DB)
+#ifdef HAVE_RESULT_SPILL
+/* Allocates len bytes of the file from offset, returns 0 or an errno */
+static int spill_allocate(int fd, off_t offset, off_t len)
+{
+#ifdef __APPLE__
+  /* No posix_fallocate, the blocks are written instead */
+  static const char zeros[8192];
+
+  while (len > 0)
   {
-    D_imp_dbh(h);
-    /* if imp_dbh is not available, it causes segfault (proper) on OpenBSD */
-    if (imp_dbh && imp_dbh->bind_type_guessing)
+    ssize_t written= pwrite(fd, zeros, len < (off_t) sizeof(zeros) ?
+                            (size_t) len : sizeof(zeros), offset);
+    if (written < 0)
     {
-      bind_type_guessing= imp_dbh->bind_type_guessing;
-      bind_comment_placeholders= bind_comment_placeholders;
+      if (errno == EINTR)
+        continue;
+      return errno;
     }
-#if MYSQL_ASYNC
-    async = (bool) (imp_dbh->async_query_in_flight != NULL);
+    offset+= written;
+    len-= written;
+  }
+  return 0;
+#else
+  return posix_fallocate(fd, offset, len);
 #endif
+}
+
+/*
+  Maps capacity bytes of the temporary file as the block, creating the
+  file and moving the rows so far into it on the first call. The file is
+  unlinked at once, it goes away with the last descriptor. The space is
+  allocated before it is mapped: writing to a page of a sparse file on a
+  full file system raises SIGBUS. Returns FALSE with errno set, the block
+  is left as it was.
+*/
+static bool compact_spill(imp_compact_result_t *c, size_t capacity)
+{
+  bool spilled= c->spill_fd >= 0;
+  size_t file_size= spilled ? c->data_capacity : 0;
+  char *data;
+
+  if (!spilled)
+  {
+    const char *dir= getenv("TMPDIR");
+    char *path;
+
+    if (!dir || !*dir)
+      dir= "/tmp";
+    New(908, path, strlen(dir) + sizeof("/dbd_mysql_XXXXXX"), char);
+    sprintf(path, "%s/dbd_mysql_XXXXXX", dir);
+    c->spill_fd= mkstemp(path);
+    if (c->spill_fd >= 0)
+      unlink(path);
+    Safefree(path);
+    if (c->spill_fd < 0)
+      return FALSE;
+    fcntl(c->spill_fd, F_SETFD, FD_CLOEXEC);
   }
-  /* h is a sth */
-  else
+
+  if ((errno= spill_allocate(c->spill_fd, (off_t) file_size,
+                             (off_t) (capacity - file_size))) ||
+      (data= mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  c->spill_fd, 0)) == MAP_FAILED)
   {
-    D_imp_sth(h);
-    D_imp_dbh_from_sth;
-    /* if imp_dbh is not available, it causes segfault (proper) on OpenBSD */
-    if (imp_dbh)
+    if (!spilled)
     {
-      bind_type_guessing= imp_dbh->bind_type_guessing;
-      bind_comment_placeholders= imp_dbh->bind_comment_placeholders;
-    }
-#if MYSQL_ASYNC
-    async = imp_sth->is_async;
-    if(async) {
-        imp_dbh->async_query_in_flight = imp_sth;
-    } else {
-        imp_dbh->async_query_in_flight = NULL;
+      int error= errno;
+
+      close(c->spill_fd);
+      c->spill_fd= -1;
+      errno= error;
     }
-#endif
+    return FALSE;
   }
 
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "mysql_st_internal_execute MYSQL_VERSION_ID %d\n",
-                  MYSQL_VERSION_ID );
-
-  salloc= parse_params(imp_xxh,
-                              aTHX_ svsock,
-                              sbuf,
-                              &slen,
-                              params,
-                              num_params,
-                              bind_type_guessing,
-                              bind_comment_placeholders);
-
-  if (salloc)
+  /* The old mapping shares the pages of the file, the heap block does not */
+  if (spilled)
+    munmap(c->data, c->data_capacity);
+  else
   {
-    sbuf= salloc;
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "Binding parameters: %s\n", sbuf);
+    Copy(c->data, data, c->data_size, char);
+    Safefree(c->data);
   }
+  c->data= data;
+  c->data_capacity= capacity;
+  return TRUE;
+}
+#endif
 
-  if (slen >= 11 && (!strncmp(sbuf, "listfields ", 11) ||
-                     !strncmp(sbuf, "LISTFIELDS ", 11)))
+/*
+  Room for len more bytes at the end of the block, or NULL with errno set
+  when the block cannot be spilled. spill_bytes is the largest block kept
+  in memory, 0 for no limit.
+*/
+static unsigned char *compact_reserve(imp_compact_result_t *c, size_t len,
+                                      size_t spill_bytes)
+{
+  if (c->data_size + len > c->data_capacity)
   {
-    /* remove pre-space */
-    slen-= 10;
+    size_t capacity= c->data_capacity ? c->data_capacity * 2 : 65536;
+
+    while (capacity < c->data_size + len)
+      capacity*= 2;
+#ifdef HAVE_RESULT_SPILL
+    if (c->spill_fd >= 0 || (spill_bytes && capacity > spill_bytes))
+    {
+      if (!compact_spill(c, capacity))
+        return NULL;
+    }
+    else
+#endif
+    {
+      Renew(c->data, capacity, char);
+      c->data_capacity= capacity;
+    }
+  }
+  return (unsigned char *) c->data + c->data_size;
+}
+
+/* Seven bits per byte, the high bit set on all but the last */
+static unsigned char *compact_put_length(unsigned char *p, unsigned long len)
+{
+  while (len >= 0x80)
+  {
+    *p++= (unsigned char) (len | 0x80);
+    len>>= 7;
+  }
+  *p++= (unsigned char) len;
+  return p;
+}
+
+static const unsigned char *compact_get_length(const unsigned char *p,
+                                               unsigned long *len)
+{
+  unsigned int shift= 0;
+
+  *len= 0;
+  while (*p & 0x80)
+  {
+    *len|= (unsigned long) (*p++ & 0x7f) << shift;
+    shift+= 7;
+  }
+  *len|= (unsigned long) *p++ << shift;
+  return p;
+}
+
+/* Reads all rows of the statement's result, returns FALSE after do_error */
+static bool compact_result_fill(pTHX_ SV *sth, imp_sth_t *imp_sth,
+                                imp_dbh_t *imp_dbh)
+{
+  MYSQL_ROW cols;
+  unsigned long *lengths;
+  unsigned int i, num_fields= mysql_num_fields(imp_sth->result);
+  MYSQL_FIELD *fields= mysql_fetch_fields(imp_sth->result);
+  size_t bitmap= (num_fields + 7) / 8;
+  imp_compact_result_t *c;
+
+  Newz(908, c, 1, imp_compact_result_t);
+  c->num_fields= num_fields;
+  c->spill_fd= -1;
+  New(908, c->cols, num_fields ? num_fields : 1, char *);
+  New(908, c->lengths, num_fields ? num_fields : 1, unsigned long);
+  imp_sth->compact= c;
+
+  while ((cols= mysql_fetch_row(imp_sth->result)))
+  {
+    size_t size= bitmap;
+    unsigned char *row, *p;
+
+    lengths= mysql_fetch_lengths(imp_sth->result);
+    for (i= 0; i < num_fields; i++)
+      if (cols[i])
+        size+= sizeof(unsigned long) * 8 / 7 + 1 + lengths[i] + 1;
+
+    if (c->num_rows % COMPACT_ROW_STEP == 0)
+    {
+      size_t n= (size_t) (c->num_rows / COMPACT_ROW_STEP);
+
+      if (n >= c->index_capacity)
+      {
+        c->index_capacity= c->index_capacity ? c->index_capacity * 2 : 64;
+        Renew(c->index, c->index_capacity, size_t);
+      }
+      c->index[n]= c->data_size;
+    }
+
+    if (!(row= compact_reserve(c, size, (size_t) imp_sth->result_spill_bytes)))
+    {
+      SV *msg= sv_2mortal(newSVpvf("cannot spill result to a temporary file: %s",
+                                   Strerror(errno)));
+      do_error(sth, JW_ERR_STORE_RESULT, SvPVX(msg), NULL);
+      return FALSE;
+    }
+    Zero(row, bitmap, unsigned char);
+    p= row + bitmap;
+    for (i= 0; i < num_fields; i++)
+      if (cols[i])
+        p= compact_put_length(p, lengths[i]);
+      else
+        row[i / 8]|= 1 << (i % 8);
+    for (i= 0; i < num_fields; i++)
+      if (cols[i])
+      {
+        /* As mysql_store_result would, see mysql_max_length */
+        if (lengths[i] > fields[i].max_length)
+          fields[i].max_length= lengths[i];
+        Copy(cols[i], p, lengths[i], char);
+        p+= lengths[i];
+        *p++= '\0';
+      }
+    c->data_size+= p - row;
+    c->num_rows++;
+  }
+
+  if (mysql_errno(imp_dbh->pmysql))
+  {
+    do_error(sth, mysql_errno(imp_dbh->pmysql), mysql_error(imp_dbh->pmysql),
+             mysql_sqlstate(imp_dbh->pmysql));
+    return FALSE;
+  }
+
+  /* Nothing is added any more, give back what was reserved */
+  if (c->data_capacity > c->data_size && c->spill_fd < 0)
+  {
+    c->data_capacity= c->data_size ? c->data_size : 1;
+    Renew(c->data, c->data_capacity, char);
+  }
+  if (c->index_capacity * COMPACT_ROW_STEP > c->num_rows + COMPACT_ROW_STEP)
+  {
+    c->index_capacity= (size_t) (c->num_rows / COMPACT_ROW_STEP) + 1;
+    Renew(c->index, c->index_capacity, size_t);
+  }
+  return TRUE;
+}
+
+/* Decodes the row at offset into cols and lengths, returns the next one */
+static size_t compact_decode_row(imp_compact_result_t *c, size_t offset)
+{
+  const unsigned char *row= (unsigned char *) c->data + offset;
+  const unsigned char *p= row + (c->num_fields + 7) / 8;
+  unsigned int i;
+
+  for (i= 0; i < c->num_fields; i++)
+    if (row[i / 8] & (1 << (i % 8)))
+      c->lengths[i]= 0;
+    else
+      p= compact_get_length(p, c->lengths + i);
+  for (i= 0; i < c->num_fields; i++)
+    if (row[i / 8] & (1 << (i % 8)))
+      c->cols[i]= NULL;
+    else
+    {
+      c->cols[i]= (char *) p;
+      p+= c->lengths[i] + 1;
+    }
+  return p - (unsigned char *) c->data;
+}
+
+static MYSQL_ROW compact_fetch_row(imp_compact_result_t *c,
+                                   unsigned long **lengths)
+{
+  if (c->cursor >= c->num_rows)
+    return NULL;
+  c->offset= compact_decode_row(c, c->offset);
+  c->cursor++;
+  *lengths= c->lengths;
+  return c->cols;
+}
+
+/* dataseek: from the nearest indexed row, skip to row pos */
+bool mysql_st_compact_seek(imp_sth_t *imp_sth, my_ulonglong pos)
+{
+  imp_compact_result_t *c= imp_sth->compact;
+
+  if (!c)
+    return FALSE;
+  if (pos >= c->num_rows)
+  {
+    c->cursor= c->num_rows;
+    c->offset= c->data_size;
+    return TRUE;
+  }
+  c->cursor= pos - pos % COMPACT_ROW_STEP;
+  c->offset= c->index[c->cursor / COMPACT_ROW_STEP];
+  for (; c->cursor < pos; c->cursor++)
+    c->offset= compact_decode_row(c, c->offset);
+  return TRUE;
+}
+
+/* The next row of the statement's result, read ahead or not */
+static MYSQL_ROW sth_fetch_row(imp_sth_t *imp_sth, unsigned long **lengths)
+{
+  MYSQL_ROW cols;
+
+  if (imp_sth->compact)
+    cols= compact_fetch_row(imp_sth->compact, lengths);
+#ifdef HAVE_PREFETCH_ROWS
+  else if (imp_sth->prefetch)
+  {
+    D_imp_dbh_from_sth;
+    cols= prefetch_fetch_row(imp_sth, imp_dbh, lengths);
+  }
+#endif
+  else if ((cols= mysql_fetch_row(imp_sth->result)))
+    *lengths= mysql_fetch_lengths(imp_sth->result);
+
+  /* kept for blob_read */
+  imp_sth->current_row= cols;
+  if (cols)
+    imp_sth->current_lengths= *lengths;
+  return cols;
+}
+
+/* Reports why sth_fetch_row returned no row, if not the end of the rows */
+static void sth_fetch_error(SV *sth, imp_sth_t *imp_sth, imp_dbh_t *imp_dbh)
+{
+#ifdef HAVE_PREFETCH_ROWS
+  if (imp_sth->prefetch && imp_sth->prefetch->failed)
+  {
+    do_error(sth, JW_ERR_MEM, "Out of memory reading ahead rows", NULL);
+    return;
+  }
+#endif
+  if (mysql_errno(imp_dbh->pmysql))
+    do_error(sth, mysql_errno(imp_dbh->pmysql),
+             mysql_error(imp_dbh->pmysql),
+             mysql_sqlstate(imp_dbh->pmysql));
+}
+
+/*
+  Borrowed string columns, see mysql_borrow_strings. A stored result is
+  owned by a plain SV whose magic frees it; every value pointing into the
+  rows of the result holds a reference on that SV, so the result lives
+  until the statement and the last such value are done with it.
+*/
+static int result_owner_free(pTHX_ SV *sv, MAGIC *mg)
+{
+  PERL_UNUSED_ARG(sv);
+  mysql_free_result((MYSQL_RES *) mg->mg_ptr);
+  return 0;
+}
+
+static MGVTBL result_owner_vtbl= { NULL, NULL, NULL, NULL, result_owner_free };
+static MGVTBL borrowed_vtbl;
+
+/* The owner of the statement's result, made on first use */
+static SV *result_owner(pTHX_ imp_sth_t *imp_sth)
+{
+  if (!imp_sth->result_owner)
+  {
+    imp_sth->result_owner= newSV(0);
+    sv_magicext(imp_sth->result_owner, NULL, PERL_MAGIC_ext,
+                &result_owner_vtbl, (const char *) imp_sth->result, 0);
+  }
+  return imp_sth->result_owner;
+}
+
+static void release_fbav(pTHX_ imp_sth_t *imp_sth, bool keep);
+
+/* Frees the statement's result, unless values still borrow from it */
+static void free_sth_result(pTHX_ imp_sth_t *imp_sth)
+{
+  if (imp_sth->fbav_borrowed)
+    release_fbav(aTHX_ imp_sth, TRUE);
+#ifdef HAVE_PREFETCH_ROWS
+  if (imp_sth->prefetch)
+  {
+    D_imp_dbh_from_sth;
+    prefetch_free(imp_sth, imp_dbh);
+  }
+#endif
+  if (imp_sth->result_owner)
+  {
+    SvREFCNT_dec(imp_sth->result_owner);
+    imp_sth->result_owner= NULL;
+  }
+  else
+    mysql_free_result(imp_sth->result);
+  if (imp_sth->compact)
+  {
+    compact_result_free(imp_sth->compact);
+    imp_sth->compact= NULL;
+  }
+  imp_sth->result= NULL;
+  imp_sth->current_row= NULL;
+}
+
+/*
+  The fields of the result which dbd_describe and the cached array
+  attributes were made for. Another execute of the statement usually
+  returns the same fields, and then they are kept rather than made again,
+  see dbd_st_execute.
+*/
+static void free_result_fields(imp_sth_t *imp_sth)
+{
+  int i;
+
+  for (i= 0; i < imp_sth->num_result_fields; i++)
+    Safefree(imp_sth->result_fields[i].name);
+  if (imp_sth->result_fields)
+    Safefree(imp_sth->result_fields);
+  imp_sth->result_fields= NULL;
+  imp_sth->num_result_fields= 0;
+}
+
+static void remember_result_fields(pTHX_ imp_sth_t *imp_sth)
+{
+  D_imp_dbh_from_sth;
+  int i, num_fields= mysql_num_fields(imp_sth->result);
+  MYSQL_FIELD *fields= mysql_fetch_fields(imp_sth->result);
+
+  free_result_fields(imp_sth);
+  /* column_conv decodes by it */
+  imp_sth->result_utf8= imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4;
+  if (!num_fields || !fields)
+    return;
+
+  New(908, imp_sth->result_fields, num_fields, imp_sth_field_t);
+  for (i= 0; i < num_fields; i++)
+  {
+    imp_sth_field_t *field= imp_sth->result_fields + i;
+
+    field->name= savepv(fields[i].name);
+    field->type= fields[i].type;
+    field->length= fields[i].length;
+    field->flags= fields[i].flags;
+    field->decimals= fields[i].decimals;
+#if MYSQL_VERSION_ID >= FIELD_CHARSETNR_VERSION
+    field->charsetnr= fields[i].charsetnr;
+#endif
+  }
+  imp_sth->num_result_fields= num_fields;
+}
+
+static bool result_fields_changed(imp_sth_t *imp_sth)
+{
+  D_imp_dbh_from_sth;
+  int i;
+  MYSQL_FIELD *fields;
+
+  if (!imp_sth->result_fields ||
+      imp_sth->result_utf8 !=
+        (imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4) ||
+      (int) mysql_num_fields(imp_sth->result) != imp_sth->num_result_fields)
+    return TRUE;
+
+  fields= mysql_fetch_fields(imp_sth->result);
+  for (i= 0; i < imp_sth->num_result_fields; i++)
+  {
+    imp_sth_field_t *field= imp_sth->result_fields + i;
+
+    if (field->type != (int) fields[i].type ||
+        field->length != fields[i].length ||
+        field->flags != fields[i].flags ||
+        field->decimals != fields[i].decimals ||
+#if MYSQL_VERSION_ID >= FIELD_CHARSETNR_VERSION
+        field->charsetnr != fields[i].charsetnr ||
+#endif
+        strNE(field->name, fields[i].name))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/*
+  Frees the cached array attributes; all of them, or only those of the
+  max_length of the values, which are different for every result
+*/
+static void free_av_attr(pTHX_ imp_sth_t *imp_sth, bool all)
+{
+  int i;
+
+  for (i= 0; i < AV_ATTRIB_LAST; i++)
+  {
+    if (!all && i != AV_ATTRIB_MAX_LENGTH && i != AV_ATTRIB_PRECISION)
+      continue;
+    if (imp_sth->av_attr[i])
+      SvREFCNT_dec(imp_sth->av_attr[i]);
+    imp_sth->av_attr[i]= Nullav;
+  }
+}
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/* Frees the result buffers of a server side prepared statement */
+static void free_result_buffers(imp_sth_t *imp_sth)
+{
+  int i;
+
+  if (!imp_sth->fbh)
+    return;
+  for (i= 0; i < imp_sth->num_result_fields; i++)
+    if (imp_sth->fbh[i].data)
+      Safefree(imp_sth->fbh[i].data);
+  free_fbuffer(imp_sth->fbh);
+  imp_sth->fbh= NULL;
+  free_bind(imp_sth->buffer);
+  imp_sth->buffer= NULL;
+}
+
+/*
+  mysql_adaptive_buffer_limit: each string buffer of the next execute is
+  as large as the longest value of its column so far, up to the limit.
+  Buffers grown beyond the limit during an execute are shrunk here, not
+  after every value.
+*/
+static void adapt_result_buffers(imp_sth_t *imp_sth)
+{
+  int i;
+
+  if (!imp_sth->fbh)
+    return;
+  for (i= 0; i < imp_sth->num_result_fields; i++)
+  {
+    imp_sth_fbh_t *fbh= imp_sth->fbh + i;
+    MYSQL_BIND *buffer= imp_sth->buffer + i;
+    unsigned long width= fbh->width < imp_sth->adaptive_buffer_limit ?
+      fbh->width : imp_sth->adaptive_buffer_limit;
+
+    if (!width || width == buffer->buffer_length || !fbh->data ||
+        buffer->buffer != fbh->data || buffer->buffer_type == MYSQL_TYPE_BIT)
+      continue;
+    Renew(fbh->data, width, char);
+    buffer->buffer_length= width;
+    buffer->buffer= (char *) fbh->data;
+    imp_sth->stmt->bind[i].buffer_length= width;
+    imp_sth->stmt->bind[i].buffer= (char *) fbh->data;
+  }
+}
+#endif
+
+/* The magic of a borrowed value, if sv is one */
+static MAGIC *borrowed_magic(SV *sv)
+{
+  MAGIC *mg;
+
+  if (SvTYPE(sv) < SVt_PVMG)
+    return NULL;
+  for (mg= SvMAGIC(sv); mg; mg= mg->mg_moremagic)
+    if (mg->mg_type == PERL_MAGIC_ext && mg->mg_virtual == &borrowed_vtbl)
+      return mg;
+  return NULL;
+}
+
+/* Points sv at len bytes of the row in the result owned by owner */
+static void borrow_value(pTHX_ SV *sv, SV *owner, const char *col, STRLEN len,
+                         bool utf8)
+{
+  MAGIC *mg= borrowed_magic(sv);
+
+  if (mg)
+  {
+    SvREADONLY_off(sv);
+    if (mg->mg_obj != owner)
+    {
+      SvREFCNT_dec(mg->mg_obj);
+      mg->mg_obj= SvREFCNT_inc(owner);
+    }
+  }
+  else
+  {
+    if (SvTHINKFIRST(sv))
+      sv_force_normal(sv);
+    SvUPGRADE(sv, SVt_PVMG);
+    SvPV_free(sv);
+    sv_magicext(sv, owner, PERL_MAGIC_ext, &borrowed_vtbl, NULL, 0);
+  }
+  SvPV_set(sv, (char *) col);
+  SvCUR_set(sv, len);
+  SvLEN_set(sv, 0);
+  SvPOK_only(sv);
+  if (utf8)
+    sv_utf8_decode(sv);
+  SvREADONLY_on(sv);
+}
+
+/* Makes a value no longer borrowed, so it can be set as usual */
+static void release_value(pTHX_ SV *sv)
+{
+  if (!borrowed_magic(sv))
+    return;
+  SvREADONLY_off(sv);
+  SvPV_set(sv, NULL);
+  SvCUR_set(sv, 0);
+  SvOK_off(sv);
+#ifdef sv_unmagicext
+  sv_unmagicext(sv, PERL_MAGIC_ext, &borrowed_vtbl);
+#else
+  sv_unmagic(sv, PERL_MAGIC_ext);
+#endif
+}
+
+/* Makes a value no longer borrowed, keeping a copy of its string */
+static void own_value(pTHX_ SV *sv)
+{
+  char *copy;
+  STRLEN len;
+  bool utf8;
+
+  if (!borrowed_magic(sv))
+    return;
+  len= SvCUR(sv);
+  utf8= SvUTF8(sv) ? TRUE : FALSE;
+  copy= savepvn(SvPVX(sv), len);
+  release_value(aTHX_ sv);
+  sv_usepvn_flags(sv, copy, len, SV_HAS_TRAILING_NUL);
+  if (utf8)
+    SvUTF8_on(sv);
+}
+
+/*
+  Releases the values of DBI's row array which borrow from a result: at
+  the next fetch they are set anyway, when the statement is finished they
+  keep their strings but no longer hold on to the result.
+*/
+static void release_fbav(pTHX_ imp_sth_t *imp_sth, bool keep)
+{
+  AV *av= DBIc_FIELDS_AV(imp_sth);
+  int i;
+
+  if (av)
+    for (i= 0; i <= av_len(av); i++)
+    {
+      if (keep)
+        own_value(aTHX_ AvARRAY(av)[i]);
+      else
+        release_value(aTHX_ AvARRAY(av)[i]);
+    }
+  imp_sth->fbav_borrowed= FALSE;
+}
+
+/***************************************************************************
+ * Name: dbd_st_free_result_sets
+ *
+ * Purpose: Clean-up single or multiple result sets (if any)
+ *
+ * Inputs: sth - Statement handle
+ *         imp_sth - driver's private statement handle
+ *
+ * Returns: 1 ok
+ *          0 error
+ *************************************************************************/
+int mysql_st_free_result_sets (SV * sth, imp_sth_t * imp_sth)
+{
+  dTHX;
+  D_imp_dbh_from_sth;
+  D_imp_xxh(sth);
+  int next_result_rc= -1;
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t>- dbd_st_free_result_sets\n");
+
+#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
+  do
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets RC %d\n", next_result_rc);
+
+    if (next_result_rc == 0)
+    {
+      if (!(imp_sth->result = mysql_use_result(imp_dbh->pmysql)))
+      {
+        /* Check for possible error */
+        if (mysql_field_count(imp_dbh->pmysql))
+        {
+          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets ERROR: %s\n",
+                                  mysql_error(imp_dbh->pmysql));
+
+          do_error(sth, mysql_errno(imp_dbh->pmysql), mysql_error(imp_dbh->pmysql),
+                   mysql_sqlstate(imp_dbh->pmysql));
+          return 0;
+        }
+      }
+    }
+    if (imp_sth->result)
+      free_sth_result(aTHX_ imp_sth);
+  } while ((next_result_rc=mysql_next_result(imp_dbh->pmysql))==0);
+
+  if (next_result_rc > 0)
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets: Error while processing multi-result set: %s\n",
+                    mysql_error(imp_dbh->pmysql));
+
+    do_error(sth, mysql_errno(imp_dbh->pmysql), mysql_error(imp_dbh->pmysql),
+             mysql_sqlstate(imp_dbh->pmysql));
+  }
+
+#else
+
+  if (imp_sth->result)
+    free_sth_result(aTHX_ imp_sth);
+#endif
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_free_result_sets\n");
+
+  return 1;
+}
+
+
+#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
+/***************************************************************************
+ * Name: dbd_st_more_results
+ *
+ * Purpose: Move onto the next result set (if any)
+ *
+ * Inputs: sth - Statement handle
+ *         imp_sth - driver's private statement handle
+ *
+ * Returns: 1 if there are more results sets
+ *          0 if there are not
+ *         -1 for errors.
+ *************************************************************************/
+int dbd_st_more_results(SV* sth, imp_sth_t* imp_sth)
+{
+  dTHX;
+  D_imp_dbh_from_sth;
+  D_imp_xxh(sth);
+
+  int use_mysql_use_result=imp_sth->use_mysql_use_result;
+  int next_result_return_code, i;
+  MYSQL* svsock= imp_dbh->pmysql;
+
+  PREFETCH_STOP_STH(imp_sth);
+
+  if (!SvROK(sth) || SvTYPE(SvRV(sth)) != SVt_PVHV)
+    croak("Expected hash array");
+
+  if (!mysql_more_results(svsock))
+  {
+    /* No more pending result set(s)*/
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+		    "\n      <- dbs_st_more_results no more results\n");
+    return 0;
+  }
+
+  if (imp_sth->use_server_side_prepare)
+  {
+    do_warn(sth, JW_ERR_NOT_IMPLEMENTED,
+            "Processing of multiple result set is not possible with server side prepare");
+    return 0;
+  }
+
+  /*
+   *  Free cached array attributes
+   */
+  for (i= 0; i < AV_ATTRIB_LAST;  i++)
+  {
+    if (imp_sth->av_attr[i])
+      SvREFCNT_dec(imp_sth->av_attr[i]);
+
+    imp_sth->av_attr[i]= Nullav;
+  }
+
+  /* Release previous MySQL result*/
+  if (imp_sth->result)
+    free_sth_result(aTHX_ imp_sth);
+
+  if (DBIc_ACTIVE(imp_sth))
+    DBIc_ACTIVE_off(imp_sth);
+
+  next_result_return_code= mysql_next_result(svsock);
+
+  imp_sth->warning_count = mysql_warning_count(imp_dbh->pmysql);
+
+  /*
+    mysql_next_result returns
+      0 if there are more results
+     -1 if there are no more results
+     >0 if there was an error
+   */
+  if (next_result_return_code > 0)
+  {
+    do_error(sth, mysql_errno(svsock), mysql_error(svsock),
+             mysql_sqlstate(svsock));
+
+    return 0;
+  }
+  else if(next_result_return_code == -1)                                                                                                                  
+  {                                                                                                                                                       
+    return 0;                                                                                                                                             
+  }  
+  else
+  {
+    /* Store the result from the Query */
+    imp_sth->result = use_mysql_use_result ?
+     mysql_use_result(svsock) : mysql_store_result(svsock);
+
+    if (mysql_errno(svsock))
+    {
+      do_error(sth, mysql_errno(svsock), mysql_error(svsock), 
+               mysql_sqlstate(svsock));
+      return 0;
+    }
+
+    imp_sth->row_num= mysql_affected_rows(imp_dbh->pmysql);
+
+    if (imp_sth->result == NULL)
+    {
+      /* No "real" rowset*/
+      DBIc_NUM_FIELDS(imp_sth)= 0; /* for DBI <= 1.53 */
+      DBIS->set_attr_k(sth, sv_2mortal(newSVpvn("NUM_OF_FIELDS",13)), 0,
+			               sv_2mortal(newSViv(0)));
+      return 1;
+    }
+    else
+    {
+      /* We have a new rowset */
+      imp_sth->currow=0;
+
+
+      /* delete cached handle attributes */
+      /* XXX should be driven by a list to ease maintenance */
+      (void)hv_delete((HV*)SvRV(sth), "NAME", 4, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "NULLABLE", 8, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "NUM_OF_FIELDS", 13, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "PRECISION", 9, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "SCALE", 5, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "TYPE", 4, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_insertid", 14, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_is_auto_increment", 23, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_is_blob", 13, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_is_key", 12, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_is_num", 12, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_is_pri_key", 16, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_length", 12, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_max_length", 16, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_table", 11, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_type", 10, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_type_name", 15, G_DISCARD);
+      (void)hv_delete((HV*)SvRV(sth), "mysql_warning_count", 20, G_DISCARD);
+
+      /* Adjust NUM_OF_FIELDS - which also adjusts the row buffer size */
+      DBIc_NUM_FIELDS(imp_sth)= 0; /* for DBI <= 1.53 */
+      DBIc_DBISTATE(imp_sth)->set_attr_k(sth, sv_2mortal(newSVpvn("NUM_OF_FIELDS",13)), 0,
+          sv_2mortal(newSViv(mysql_num_fields(imp_sth->result)))
+      );
+
+      DBIc_ACTIVE_on(imp_sth);
+
+      imp_sth->done_desc = 0;
+    }
+    imp_dbh->pmysql->net.last_errno= 0;
+    return 1;
+  }
+}
+#endif
+/**************************************************************************
+ *
+ *  Name:    mysql_st_internal_execute
+ *
+ *  Purpose: Internal version for executing a statement, called both from
+ *           within the "do" and the "execute" method.
+ *
+ *  Inputs:  h - object handle, for storing error messages
+ *           statement - query being executed
+ *           attribs - statement attributes, currently ignored
+ *           num_params - number of parameters being bound
+ *           params - parameter array
+ *           result - where to store results, if any
+ *           svsock - socket connected to the database
+ *
+ **************************************************************************/
+
+
+my_ulonglong mysql_st_internal_execute(
+                                       SV *h, /* could be sth or dbh */
+                                       SV *statement,
+                                       SV *attribs,
+                                       int num_params,
+                                       imp_sth_ph_t *params,
+                                       MYSQL_RES **result,
+                                       MYSQL *svsock,
+                                       int use_mysql_use_result
+                                      )
+{
+  dTHX;
+  bool bind_type_guessing= FALSE;
+  bool bind_comment_placeholders= TRUE;
+  STRLEN slen;
+  char *sbuf = SvPV(statement, slen);
+  char *table;
+  char *salloc;
+  char **query_buf;
+  STRLEN *query_buf_size;
+  int htype;
+#if MYSQL_ASYNC
+  bool async = FALSE;
+#endif
+  my_ulonglong rows= 0;
+  /* thank you DBI.c for this info! */
+  D_imp_xxh(h);
+  attribs= attribs;
+
+  htype= DBIc_TYPE(imp_xxh);
+  /*
+    It is important to import imp_dbh properly according to the htype
+    that it is! Also, one might ask why bind_type_guessing is assigned
+    in each block. Well, it's because D_imp_ macros called in these
+    blocks make it so imp_dbh is not "visible" or defined outside of the
+    if/else (when compiled, it fails for imp_dbh not being defined).
+  */
+  /* h is a dbh */
+  if (htype == DBIt_DB)
+  {
+    D_imp_dbh(h);
+    /* if imp_dbh is not available, it causes segfault (proper) on OpenBSD */
+    if (imp_dbh && imp_dbh->bind_type_guessing)
+    {
+      bind_type_guessing= imp_dbh->bind_type_guessing;
+      bind_comment_placeholders= bind_comment_placeholders;
+    }
+    query_buf= &imp_dbh->query_buf;
+    query_buf_size= &imp_dbh->query_buf_size;
+#if MYSQL_ASYNC
+    async = (bool) (imp_dbh->async_query_in_flight != NULL);
+#endif
+  }
+  /* h is a sth */
+  else
+  {
+    D_imp_sth(h);
+    D_imp_dbh_from_sth;
+    /* if imp_dbh is not available, it causes segfault (proper) on OpenBSD */
+    if (imp_dbh)
+    {
+      bind_type_guessing= imp_dbh->bind_type_guessing;
+      bind_comment_placeholders= imp_dbh->bind_comment_placeholders;
+    }
+    query_buf= &imp_sth->query_buf;
+    query_buf_size= &imp_sth->query_buf_size;
+#if MYSQL_ASYNC
+    async = imp_sth->is_async;
+    if(async) {
+        imp_dbh->async_query_in_flight = imp_sth;
+    } else {
+        imp_dbh->async_query_in_flight = NULL;
+    }
+#endif
+  }
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "mysql_st_internal_execute MYSQL_VERSION_ID %d\n",
+                  MYSQL_VERSION_ID );
+
+  if (htype == DBIt_ST && num_params)
+  {
+    D_imp_sth(h);
+    salloc= fill_params(imp_xxh,
+                        aTHX_ svsock,
+                        sth_params_tmpl(imp_xxh, aTHX_ imp_sth, sbuf, slen,
+                                        bind_comment_placeholders),
+                        query_buf,
+                        query_buf_size,
+                        &slen,
+                        params,
+                        num_params,
+                        bind_type_guessing);
+  }
+  else
+    salloc= parse_params(imp_xxh,
+                                aTHX_ svsock,
+                                sbuf,
+                                query_buf,
+                                query_buf_size,
+                                &slen,
+                                params,
+                                num_params,
+                                bind_type_guessing,
+                                bind_comment_placeholders);
+
+  if (salloc)
+  {
+    sbuf= salloc;
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "Binding parameters: %s\n", sbuf);
+  }
+
+  if (slen >= 11 && (!strncmp(sbuf, "listfields ", 11) ||
+                     !strncmp(sbuf, "LISTFIELDS ", 11)))
+  {
+    /* remove pre-space */
+    slen-= 10;
     sbuf+= 10;
     while (slen && isspace(*sbuf)) { --slen;  ++sbuf; }
 
-    if (!slen)
-    {
-      do_error(h, JW_ERR_QUERY, "Missing table name" ,NULL);
+    if (!slen)
+    {
+      do_error(h, JW_ERR_QUERY, "Missing table name" ,NULL);
+      return -2;
+    }
+    if (!(table= malloc(slen+1)))
+    {
+      do_error(h, JW_ERR_MEM, "Out of memory" ,NULL);
+      return -2;
+    }
+
+    strncpy(table, sbuf, slen);
+    sbuf= table;
+
+    while (slen && !isspace(*sbuf))
+    {
+      --slen;
+      ++sbuf;
+    }
+    *sbuf++= '\0';
+
+    *result= mysql_list_fields(svsock, table, NULL);
+
+    free(table);
+
+    if (!(*result))
+    {
+      do_error(h, mysql_errno(svsock), mysql_error(svsock)
+               ,mysql_sqlstate(svsock));
+      return -2;
+    }
+
+    return 0;
+  }
+
+#if MYSQL_ASYNC
+  if(async) {
+    if((mysql_send_query(svsock, sbuf, slen)) &&
+       (!mysql_db_reconnect(h) ||
+        (mysql_send_query(svsock, sbuf, slen))))
+    {
+        rows = -2;
+    } else {
+        rows = 0;
+    }
+  } else {
+#endif
+      if ((mysql_real_query(svsock, sbuf, slen))  &&
+          (!mysql_db_reconnect(h)  ||
+           (mysql_real_query(svsock, sbuf, slen))))
+      {
+        rows = -2;
+      } else {
+          /** Store the result from the Query */
+          *result= use_mysql_use_result ?
+            mysql_use_result(svsock) : mysql_store_result(svsock);
+
+          if (mysql_errno(svsock))
+            rows = -2;
+          else if (*result)
+            rows = mysql_num_rows(*result);
+          else {
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+            /*
+              Cached statements are keyed by svsock->db, which older
+              client libraries do not learn from a USE
+            */
+            if (slen > 4 && toLOWER(sbuf[0]) == 'u' &&
+                toLOWER(sbuf[1]) == 's' && toLOWER(sbuf[2]) == 'e' &&
+                isSPACE(sbuf[3]))
+              mysql_db_stmt_cache_flush(aTHX_ htype == DBIt_DB ?
+                (imp_dbh_t *) imp_xxh : (imp_dbh_t *) DBIc_PARENT_COM(imp_xxh));
+#endif
+            rows = mysql_affected_rows(svsock);
+            /* mysql_affected_rows(): -1 indicates that the query returned an error */
+            if (rows == (my_ulonglong)-1)
+              rows = -2;
+          }
+      }
+#if MYSQL_ASYNC
+  }
+#endif
+
+  free_query_buf(query_buf, query_buf_size, TRUE);
+
+  if(rows == (my_ulonglong)-2) {
+    do_error(h, mysql_errno(svsock), mysql_error(svsock), 
+             mysql_sqlstate(svsock));
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "IGNORING ERROR errno %d\n", mysql_errno(svsock));
+  }
+  return(rows);
+}
+
+ /**************************************************************************
+ *
+ *  Name:    mysql_st_internal_execute41
+ *
+ *  Purpose: Internal version for executing a prepared statement, called both
+ *           from within the "do" and the "execute" method.
+ *           MYSQL 4.1 API
+ *
+ *
+ *  Inputs:  h - object handle, for storing error messages
+ *           statement - query being executed
+ *           attribs - statement attributes, currently ignored
+ *           num_params - number of parameters being bound
+ *           params - parameter array
+ *           result - where to store results, if any
+ *           svsock - socket connected to the database
+ *           use_mysql_use_result - TRUE to fetch the rows as they come,
+ *               from the connection or the statement's cursor, rather
+ *               than with mysql_stmt_store_result
+ *
+ **************************************************************************/
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+
+my_ulonglong mysql_st_internal_execute41(
+                                         SV *sth,
+                                         int num_params,
+                                         MYSQL_RES **result,
+                                         MYSQL_STMT *stmt,
+                                         MYSQL_BIND *bind,
+                                         int *has_been_bound,
+                                         int use_mysql_use_result
+                                        )
+{
+  int i;
+  enum enum_field_types enum_type;
+  dTHX;
+  int execute_retval;
+  my_ulonglong rows=0;
+  D_imp_xxh(sth);
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t-> mysql_st_internal_execute41\n");
+
+  /* free result if exists */
+  if (*result)
+  {
+    mysql_free_result(*result);
+    *result= 0;
+  }
+
+  /*
+    If were performed any changes with ph variables
+    we have to rebind them
+  */
+
+  if (num_params > 0 && !(*has_been_bound))
+  {
+    if (mysql_stmt_bind_param(stmt,bind))
+      goto error;
+
+    *has_been_bound= 1;
+  }
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t\tmysql_st_internal_execute41 calling mysql_execute with %d num_params\n",
+                  num_params);
+
+  execute_retval= mysql_stmt_execute(stmt);
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t\tmysql_stmt_execute returned %d\n",
+                  execute_retval);
+  if (execute_retval)
+    goto error;
+
+  /*
+   This statement does not return a result set (INSERT, UPDATE...)
+  */
+  if (!(*result= mysql_stmt_result_metadata(stmt)))
+  {
+    if (mysql_stmt_errno(stmt))
+      goto error;
+
+    rows= mysql_stmt_affected_rows(stmt);
+
+    /* mysql_stmt_affected_rows(): -1 indicates that the query returned an error */
+    if (rows == (my_ulonglong)-1)
+      goto error;
+  }
+  /*
+    This statement returns a result set (SELECT...)
+  */
+  else if (use_mysql_use_result)
+  {
+    /* The rows are fetched as they come, the number is not known */
+    rows= 0;
+  }
+  else
+  {
+    /*
+      mysql_stmt_store_result to update MYSQL_FIELD->max_length, which
+      costs a pass over the stored rows; with mysql_adaptive_buffer_limit
+      string buffers are sized without it. Set either way, the statement
+      may come from the cache.
+    */
+    my_bool update_max_length= 0;
+
+    if (DBIc_TYPE(imp_xxh) != DBIt_ST ||
+        !((imp_sth_t *) imp_xxh)->adaptive_buffer_limit)
+    {
+      for (i = mysql_stmt_field_count(stmt) - 1; i >=0; --i) {
+          enum_type = mysql_to_perl_type(stmt->fields[i].type);
+          if (enum_type != MYSQL_TYPE_DOUBLE && enum_type != MYSQL_TYPE_LONG && enum_type != MYSQL_TYPE_LONGLONG && enum_type != MYSQL_TYPE_BIT)
+          {
+              update_max_length= 1;
+              break;
+          }
+      }
+    }
+    mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update_max_length);
+    /* Get the total rows affected and return */
+    if (mysql_stmt_store_result(stmt))
+      goto error;
+    else
+      rows= mysql_stmt_num_rows(stmt);
+  }
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t<- mysql_internal_execute_41 returning %llu rows\n",
+                  rows);
+  return(rows);
+
+error:
+  if (*result)
+  {
+    mysql_free_result(*result);
+    *result= 0;
+  }
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "     errno %d err message %s\n",
+                  mysql_stmt_errno(stmt),
+                  mysql_stmt_error(stmt));
+  do_error(sth, mysql_stmt_errno(stmt), mysql_stmt_error(stmt),
+           mysql_stmt_sqlstate(stmt));
+  mysql_stmt_reset(stmt);
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t<- mysql_st_internal_execute41\n");
+  return -2;
+
+}
+#endif
+
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/* Does any parameter need send_long_data? */
+static bool sth_long_data(imp_sth_t *imp_sth)
+{
+  int i;
+
+  if (imp_sth->params)
+    for (i= 0; i < DBIc_NUM_PARAMS(imp_sth); i++)
+      if (ph_long_data(imp_sth->params + i))
+        return TRUE;
+  return FALSE;
+}
+
+/*
+  Long data can only be streamed to a server side prepared statement: a
+  client side prepared statement is prepared on the server when it is
+  first executed with such a parameter, and its parameters are bound
+  again.
+*/
+static int long_data_server_prepare(pTHX_ SV *sth, imp_sth_t *imp_sth,
+                                    imp_dbh_t *imp_dbh, SV *statement)
+{
+  int i, num_params= DBIc_NUM_PARAMS(imp_sth);
+
+#if MYSQL_ASYNC
+  if (imp_sth->is_async)
+  {
+    do_error(sth, ER_UNSUPPORTED_PS,
+             "Long data parameters not supported with async", "HY000");
+    return FALSE;
+  }
+#endif
+  imp_sth->use_server_side_prepare= 1;
+  if (!sth_server_prepare(aTHX_ sth, imp_sth, imp_dbh,
+                          SvPV_nolen(statement)))
+  {
+    imp_sth->use_server_side_prepare= 0;
+    DBIc_NUM_PARAMS(imp_sth)= num_params;
+    return FALSE;
+  }
+  if (!imp_sth->use_server_side_prepare ||
+      DBIc_NUM_PARAMS(imp_sth) != num_params)
+  {
+    if (imp_sth->stmt)
+    {
+      mysql_stmt_close(imp_sth->stmt);
+      imp_sth->stmt= NULL;
+    }
+    /* made by sth_server_prepare, for its count of parameters */
+    free_bind(imp_sth->bind);
+    free_fbind(imp_sth->fbind, DBIc_NUM_PARAMS(imp_sth));
+    imp_sth->bind= NULL;
+    imp_sth->fbind= NULL;
+    imp_sth->use_server_side_prepare= 0;
+    DBIc_NUM_PARAMS(imp_sth)= num_params;
+    do_error(sth, ER_UNSUPPORTED_PS,
+             "Long data parameters need a server side prepared statement",
+             "HY000");
+    return FALSE;
+  }
+  imp_sth->done_desc= 0;
+
+  for (i= 0; i < num_params; i++)
+    if (imp_sth->params[i].value && !imp_sth->params[i].by_ref)
+      bind_server_param(aTHX_ sth, imp_sth, i, imp_sth->params[i].type);
+  return TRUE;
+}
+
+/*
+  Sends the values of parameters bound as mysql_long_data, filehandles or
+  code references to the server before the statement is executed, in
+  chunks of LONG_DATA_CHUNK, so that a value never has to be in memory as
+  a whole. Code references are called until they return undef or an
+  empty string.
+*/
+static int send_long_data(pTHX_ SV *sth, imp_sth_t *imp_sth)
+{
+  D_imp_xxh(sth);
+  MYSQL_STMT *stmt= imp_sth->stmt;
+  char *chunk= NULL;
+  int i;
+
+  /* the parameter types must be known to the library first */
+  if (!imp_sth->has_been_bound)
+  {
+    if (mysql_stmt_bind_param(stmt, imp_sth->bind))
+      goto error;
+    imp_sth->has_been_bound= 1;
+  }
+
+  for (i= 0; i < DBIc_NUM_PARAMS(imp_sth); i++)
+  {
+    SV *value= imp_sth->params[i].value;
+    SV *source;
+
+    if (!ph_long_data(imp_sth->params + i))
+      continue;
+
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tsending long data of parameter %d\n", i + 1);
+
+    source= isGV(value) ? value : SvROK(value) ? SvRV(value) : NULL;
+    switch (source ? SvTYPE(source) : SVt_NULL) {
+    case SVt_PVCV:
+      for (;;)
+      {
+        SV *ret= NULL;
+        char *data;
+        STRLEN len= 0;
+        int count, failed;
+        dSP;
+
+        ENTER;
+        SAVETMPS;
+        PUSHMARK(SP);
+        PUTBACK;
+        count= call_sv(value, G_SCALAR | G_EVAL);
+        SPAGAIN;
+        if (count == 1)
+          ret= POPs;
+        PUTBACK;
+
+        if (SvTRUE(ERRSV))
+        {
+          do_error(sth, JW_ERR_QUERY, SvPV_nolen(ERRSV), NULL);
+          FREETMPS;
+          LEAVE;
+          goto reset;
+        }
+        data= ret && SvOK(ret) ? SvPV(ret, len) : NULL;
+        failed= len && mysql_stmt_send_long_data(stmt, i, data, len);
+        FREETMPS;
+        LEAVE;
+        if (failed)
+          goto error;
+        if (!len)
+          break;
+      }
+      break;
+
+    case SVt_PVGV:
+    case SVt_PVIO:
+      {
+        IO *io= SvTYPE(source) == SVt_PVGV ? GvIO((GV *) source) : (IO *) source;
+        PerlIO *fp= io ? IoIFP(io) : NULL;
+        SSize_t count;
+
+        if (!fp)
+        {
+          do_error(sth, JW_ERR_QUERY, "file handle is not open", NULL);
+          goto reset;
+        }
+        if (!chunk)
+          New(908, chunk, LONG_DATA_CHUNK, char);
+        while ((count= PerlIO_read(fp, chunk, LONG_DATA_CHUNK)) > 0)
+          if (mysql_stmt_send_long_data(stmt, i, chunk, count))
+            goto error;
+        if (count < 0)
+        {
+          SV *msg= sv_2mortal(newSVpvf("error reading file handle: %s",
+                                       Strerror(errno)));
+          do_error(sth, JW_ERR_QUERY, SvPVX(msg), NULL);
+          goto reset;
+        }
+      }
+      break;
+
+    default:
+      {
+        STRLEN len, offset, n;
+        char *data= SvPV(value, len);
+
+        for (offset= 0; offset < len; offset+= n)
+        {
+          n= len - offset < LONG_DATA_CHUNK ? len - offset : LONG_DATA_CHUNK;
+          if (mysql_stmt_send_long_data(stmt, i, data + offset, n))
+            goto error;
+        }
+      }
+    }
+  }
+  Safefree(chunk);
+  return TRUE;
+
+error:
+  do_error(sth, mysql_stmt_errno(stmt), mysql_stmt_error(stmt),
+           mysql_stmt_sqlstate(stmt));
+reset:
+  /* drop what was sent so far */
+  mysql_stmt_reset(stmt);
+  Safefree(chunk);
+  return FALSE;
+}
+#endif
+
+
+/***************************************************************************
+ *
+ *  Name:    dbd_st_execute
+ *
+ *  Purpose: Called for preparing an SQL statement; our part of the
+ *           statement handle constructor
+ *
+ *  Input:   sth - statement handle being initialized
+ *           imp_sth - drivers private statement handle data
+ *
+ *  Returns: TRUE for success, FALSE otherwise; do_error will
+ *           be called in the latter case
+ *
+ **************************************************************************/
+
+int dbd_st_execute(SV* sth, imp_sth_t* imp_sth)
+{
+  dTHX;
+  char actual_row_num[64];
+  int i;
+  SV **statement;
+  D_imp_dbh_from_sth;
+  D_imp_xxh(sth);
+#if defined (dTHR)
+  dTHR;
+#endif
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  int use_server_side_prepare = imp_sth->use_server_side_prepare;
+  int disable_fallback_for_server_prepare = imp_sth->disable_fallback_for_server_prepare;
+#endif
+
+  PREFETCH_STOP_STH(imp_sth);
+
+  ASYNC_CHECK_RETURN(sth, -2);
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+      " -> dbd_st_execute for %p\n", sth);
+
+  if (!SvROK(sth)  ||  SvTYPE(SvRV(sth)) != SVt_PVHV)
+    croak("Expected hash array");
+
+  statement= hv_fetch((HV*) SvRV(sth), "Statement", 9, FALSE);
+
+  /* 
+     Clean-up previous result set(s) for sth to prevent
+     'Commands out of sync' error 
+  */
+  mysql_st_free_result_sets (sth, imp_sth);
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (!use_server_side_prepare && statement && sth_long_data(imp_sth))
+  {
+    if (!long_data_server_prepare(aTHX_ sth, imp_sth, imp_dbh, *statement))
       return -2;
-    }
-    if (!(table= malloc(slen+1)))
+    use_server_side_prepare= 1;
+  }
+
+  if (use_server_side_prepare)
+  {
+    int unbuffered= imp_sth->use_mysql_use_result;
+
+#if MYSQL_VERSION_ID >= SERVER_CURSOR_VERSION
+    /*
+      Always set, the statement may come from the cache of another
+      statement handle
+    */
     {
-      do_error(h, JW_ERR_MEM, "Out of memory" ,NULL);
-      return -2;
+      unsigned long cursor_type= imp_sth->server_cursor ?
+        (unsigned long) CURSOR_TYPE_READ_ONLY :
+        (unsigned long) CURSOR_TYPE_NO_CURSOR;
+
+      mysql_stmt_attr_set(imp_sth->stmt, STMT_ATTR_CURSOR_TYPE, &cursor_type);
+      if (imp_sth->server_cursor)
+      {
+        /* 0 means the library default of one row per round trip */
+        unsigned long prefetch_rows= imp_sth->cursor_prefetch_rows ?
+          imp_sth->cursor_prefetch_rows : 1;
+
+        mysql_stmt_attr_set(imp_sth->stmt, STMT_ATTR_PREFETCH_ROWS,
+                            &prefetch_rows);
+        unbuffered= 1;
+      }
     }
+#endif
+    imp_sth->result_stored= !unbuffered;
 
-    strncpy(table, sbuf, slen);
-    sbuf= table;
+    /* values bound by reference are taken as they are now */
+    for (i= 0; i < DBIc_NUM_PARAMS(imp_sth); i++)
+      if (imp_sth->params[i].by_ref)
+        bind_server_param(aTHX_ sth, imp_sth, i, imp_sth->params[i].type);
 
-    while (slen && !isspace(*sbuf))
+    if (sth_long_data(imp_sth) && !send_long_data(aTHX_ sth, imp_sth))
+      return -2;
+
+    imp_sth->row_num= mysql_st_internal_execute41(
+                                                  sth,
+                                                  DBIc_NUM_PARAMS(imp_sth),
+                                                  &imp_sth->result,
+                                                  imp_sth->stmt,
+                                                  imp_sth->bind,
+                                                  &imp_sth->has_been_bound,
+                                                  unbuffered
+                                                 );
+    if (imp_sth->row_num == (my_ulonglong)-2) /* -2 means error */
     {
-      --slen;
-      ++sbuf;
-    }
-    *sbuf++= '\0';
+      SV *err = DBIc_ERR(imp_xxh);
+      if (!disable_fallback_for_server_prepare && SvIV(err) == ER_UNSUPPORTED_PS &&
+          !sth_long_data(imp_sth))
+      {
+        use_server_side_prepare = 0;
+        /* don't keep a statement in the cache we cannot execute */
+        mysql_db_stmt_cache_store(aTHX_ imp_dbh, &imp_sth->stmt_cache_entry);
+        if (statement)
+        {
+          STRLEN length;
+          char *str= SvPV(*statement, length);
 
-    *result= mysql_list_fields(svsock, table, NULL);
+          mysql_db_unsupported_ps_add(aTHX_ imp_dbh, str, length);
+        }
+      }
+    }
+  }
 
-    free(table);
+  if (!use_server_side_prepare)
+#endif
+  {
+    /*
+      mysql_compact_result reads the rows itself, see compact_result_fill,
+      and so does mysql_result_spill_bytes
+    */
+    bool compact= (imp_sth->compact_result || imp_sth->result_spill_bytes) &&
+      !imp_sth->use_mysql_use_result;
 
-    if (!(*result))
+    imp_sth->row_num= mysql_st_internal_execute(
+                                                sth,
+                                                *statement,
+                                                NULL,
+                                                DBIc_NUM_PARAMS(imp_sth),
+                                                imp_sth->params,
+                                                &imp_sth->result,
+                                                imp_dbh->pmysql,
+                                                imp_sth->use_mysql_use_result ||
+                                                compact
+                                               );
+#if MYSQL_ASYNC
+    if(imp_dbh->async_query_in_flight) {
+        free_av_attr(aTHX_ imp_sth, TRUE);
+        DBIc_ACTIVE_on(imp_sth);
+        return 0;
+    }
+#endif
+    if (compact && imp_sth->result &&
+        imp_sth->row_num != (my_ulonglong) -2)
     {
-      do_error(h, mysql_errno(svsock), mysql_error(svsock)
-               ,mysql_sqlstate(svsock));
-      return -2;
+      if (compact_result_fill(aTHX_ sth, imp_sth, imp_dbh))
+        imp_sth->row_num= imp_sth->compact->num_rows;
+      else
+      {
+        free_sth_result(aTHX_ imp_sth);
+        imp_sth->row_num= (my_ulonglong) -2;
+      }
     }
+  }
 
-    return 0;
+  /*
+    The description of the last result, its buffers and the cached array
+    attributes are kept if the new result has the same fields
+  */
+  if (imp_sth->result && imp_sth->done_desc &&
+      !result_fields_changed(imp_sth))
+  {
+    free_av_attr(aTHX_ imp_sth, FALSE);
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+    if (use_server_side_prepare && imp_sth->adaptive_buffer_limit)
+      adapt_result_buffers(imp_sth);
+#endif
+  }
+  else
+  {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2 && imp_sth->done_desc)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\tresult fields changed, describing again\n");
+    free_av_attr(aTHX_ imp_sth, TRUE);
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+    free_result_buffers(imp_sth);
+#endif
+    imp_sth->done_desc= 0;
   }
 
-#if MYSQL_ASYNC
-  if(async) {
-    if((mysql_send_query(svsock, sbuf, slen)) &&
-       (!mysql_db_reconnect(h) ||
-        (mysql_send_query(svsock, sbuf, slen))))
+  if (imp_sth->row_num+1 != (my_ulonglong)-1)
+  {
+    if (!imp_sth->result)
     {
-        rows = -2;
-    } else {
-        rows = 0;
+      imp_sth->insertid= mysql_insert_id(imp_dbh->pmysql);
+#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
+      if (mysql_more_results(imp_dbh->pmysql))
+        DBIc_ACTIVE_on(imp_sth);
+#endif
     }
-  } else {
+    else
+    {
+      /** Store the result in the current statement handle */
+      DBIc_NUM_FIELDS(imp_sth)= mysql_num_fields(imp_sth->result);
+      DBIc_ACTIVE_on(imp_sth);
+      imp_sth->fetch_done= 0;
+#ifdef HAVE_PREFETCH_ROWS
+      if (!use_server_side_prepare && imp_sth->use_mysql_use_result &&
+          imp_sth->prefetch_rows > 0)
+        prefetch_start(aTHX_ sth, imp_sth, imp_dbh);
 #endif
-      if ((mysql_real_query(svsock, sbuf, slen))  &&
-          (!mysql_db_reconnect(h)  ||
-           (mysql_real_query(svsock, sbuf, slen))))
-      {
-        rows = -2;
-      } else {
-          /** Store the result from the Query */
-          *result= use_mysql_use_result ?
-            mysql_use_result(svsock) : mysql_store_result(svsock);
+    }
+  }
 
-          if (mysql_errno(svsock))
-            rows = -2;
-          else if (*result)
-            rows = mysql_num_rows(*result);
-          else {
-            rows = mysql_affected_rows(svsock);
-            /* mysql_affected_rows(): -1 indicates that the query returned an error */
-            if (rows == (my_ulonglong)-1)
-              rows = -2;
-          }
+  imp_sth->warning_count = mysql_warning_count(imp_dbh->pmysql);
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+  {
+    /* 
+      PerlIO_printf doesn't always handle imp_sth->row_num %llu 
+      consistently!!
+    */
+    sprintf(actual_row_num, "%llu", imp_sth->row_num);
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  " <- dbd_st_execute returning imp_sth->row_num %s\n",
+                  actual_row_num);
+  }
+
+  return (int)imp_sth->row_num;
+}
+
+ /**************************************************************************
+ *
+ *  Name:    mysql_st_execute_for_fetch
+ *
+ *  Purpose: Driver version of DBI's execute_for_fetch for emulated
+ *           prepared INSERT and REPLACE statements: the tuples are
+ *           sent as multi-row "VALUES (...),(...)" statements, each as
+ *           large as max_allowed_packet allows, rather than one by one.
+ *
+ *  Input:   sth - statement handle
+ *           imp_sth - drivers private statement handle data
+ *           fetch_tuple_sub - code ref returning the next tuple
+ *           tuple_status - array ref for the status of each tuple, or
+ *               undef; a tuple's status is -1 if the statement it was
+ *               sent with succeeded and [err, errstr, state] otherwise
+ *           tuple_count, rows, err_count - where to store the number of
+ *               tuples, the number of affected rows and the number of
+ *               tuples which failed
+ *
+ *  Returns: -1 if the statement cannot be executed this way, before
+ *           any tuple was fetched; 0 for errors, 1 otherwise
+ *
+ **************************************************************************/
+
+/* Case insensitive match of a keyword at ptr */
+static bool is_keyword(const char *ptr, const char *end, const char *keyword)
+{
+  if ((STRLEN) (end - ptr) < strlen(keyword))
+    return FALSE;
+  for (; *keyword; ptr++, keyword++)
+    if (toLOWER(*ptr) != *keyword)
+      return FALSE;
+  return ptr == end || !(isALNUM(*ptr) || *ptr == '$');
+}
+
+/* Returns the character after a quoted string, NULL if it never ends */
+static char *skip_quoted(char *ptr, char *end)
+{
+  char end_token= *ptr++;
+
+  while ((ptr= skip_to_chars(ptr, end, end_token, '\\')) < end)
+  {
+    if (*ptr == end_token)
+      return ptr + 1;
+    ptr+= 2;  /* backslash escape */
+  }
+  return NULL;
+}
+
+/*
+  Finds the parentheses around "VALUES (?, ...)"; all of the placeholders
+  have to be inside, so there must be just the one list of values. Any
+  comments before its end make us give up rather than guess.
+*/
+static bool find_values_list(imp_sth_tmpl_t *tmpl, STRLEN *open, STRLEN *close)
+{
+  char *start= tmpl->statement, *ptr= start, *end= start + tmpl->length;
+  char *first_ph, *values= NULL;
+  int depth= 0;
+
+  if (!tmpl->num_pos ||
+      !(is_keyword(start, end, "insert") || is_keyword(start, end, "replace")))
+    return FALSE;
+
+  /* The last VALUES keyword before the first placeholder */
+  first_ph= start + tmpl->pos[0].offset;
+  while (ptr && ptr < first_ph)
+  {
+    switch (*ptr) {
+    case '`':
+    case '"':
+    case '\'':
+      ptr= skip_quoted(ptr, first_ph);
+      break;
+    case '#':
+      return FALSE;
+    case '-':
+    case '/':
+      if (ptr[1] == *ptr || (*ptr == '/' && ptr[1] == '*'))
+        return FALSE;
+      ptr++;
+      break;
+    default:
+      if ((ptr == start || !(isALNUM(ptr[-1]) || ptr[-1] == '$')) &&
+          (is_keyword(ptr, first_ph, "values") ||
+           is_keyword(ptr, first_ph, "value")))
+        values= ptr;
+      ptr++;
+    }
+  }
+  if (!ptr || !values)
+    return FALSE;
+
+  /* VALUES is followed by the opening parenthesis */
+  ptr= values + (toLOWER(values[5]) == 's' ? 6 : 5);
+  while (ptr < first_ph && isSPACE(*ptr))
+    ptr++;
+  if (ptr == first_ph || *ptr != '(')
+    return FALSE;
+  *open= ptr - start;
+
+  /* and the matching closing one */
+  while (ptr && ptr < end)
+  {
+    switch (*ptr) {
+    case '(':
+      depth++;
+      ptr++;
+      break;
+    case ')':
+      if (--depth == 0)
+      {
+        *close= ptr - start;
+        return tmpl->pos[tmpl->num_pos - 1].offset < *close;
       }
-#if MYSQL_ASYNC
+      ptr++;
+      break;
+    case '`':
+    case '"':
+    case '\'':
+      ptr= skip_quoted(ptr, end);
+      break;
+    case '#':
+      return FALSE;
+    case '-':
+    case '/':
+      if (ptr + 1 < end && (ptr[1] == *ptr || (*ptr == '/' && ptr[1] == '*')))
+        return FALSE;
+      ptr++;
+      break;
+    default:
+      ptr++;
+    }
   }
-#endif
+  return FALSE;
+}
 
-  if (salloc)
-    Safefree(salloc);
+/*
+  max_allowed_packet of the server, asked for once per connection; the
+  client library does not know about the server's setting
+*/
+static unsigned long max_allowed_packet(pTHX_ imp_dbh_t *imp_dbh)
+{
+  MYSQL_RES *res;
+  MYSQL_ROW row;
 
-  if(rows == (my_ulonglong)-2) {
-    do_error(h, mysql_errno(svsock), mysql_error(svsock), 
-             mysql_sqlstate(svsock));
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "IGNORING ERROR errno %d\n", mysql_errno(svsock));
+  if (imp_dbh->max_allowed_packet)
+    return imp_dbh->max_allowed_packet;
+
+  /* asked again next time if the connection is busy now */
+  if (!mysql_real_query(imp_dbh->pmysql, "SELECT @@max_allowed_packet", 27) &&
+      (res= mysql_store_result(imp_dbh->pmysql)))
+  {
+    if ((row= mysql_fetch_row(res)) && row[0] && atol(row[0]) > 0)
+      imp_dbh->max_allowed_packet= strtoul(row[0], NULL, 10);
+    mysql_free_result(res);
+  }
+  return imp_dbh->max_allowed_packet ?
+    imp_dbh->max_allowed_packet : 1024 * 1024;  /* the servers' default */
+}
+
+/* Status of the tuples which were sent with the last statement */
+static void set_tuple_status(pTHX_ AV *status, imp_sth_t *imp_sth,
+                             IV first, IV last, bool ok)
+{
+  IV i;
+  AV *err;
+
+  if (!status)
+    return;
+  for (i= first; i < last; i++)
+  {
+    if (ok)
+      av_store(status, i, newSViv(-1));
+    else
+    {
+      err= newAV();
+      av_push(err, newSVsv(DBIc_ERR(imp_sth)));
+      av_push(err, newSVsv(DBIc_ERRSTR(imp_sth)));
+      av_push(err, newSVsv(DBIc_STATE(imp_sth)));
+      av_store(status, i, newRV_noinc((SV *) err));
+    }
+  }
+}
+
+/* The next tuple from fetch_tuple_sub, NULL at the end */
+static AV *fetch_tuple(pTHX_ SV *fetch_tuple_sub)
+{
+  SV *tuple= NULL;
+  dSP;
+
+  PUSHMARK(SP);
+  PUTBACK;
+  if (call_sv(fetch_tuple_sub, G_SCALAR) == 1)
+  {
+    SPAGAIN;
+    tuple= POPs;
+    PUTBACK;
+  }
+  if (tuple && SvROK(tuple) && SvTYPE(SvRV(tuple)) == SVt_PVAV)
+    return (AV *) SvRV(tuple);
+  return NULL;
+}
+
+/* A tuple with the wrong number of values */
+static void tuple_error(pTHX_ SV *sth, AV *status, imp_sth_t *imp_sth,
+                        IV tuple, AV *av, IV num_params)
+{
+  char errmsg[80];
+
+  sprintf(errmsg, "called with %d bind variables when %d are needed",
+          (int) (av_len(av) + 1), (int) num_params);
+  do_error(sth, JW_ERR_ILLEGAL_PARAM_NUM, errmsg, NULL);
+  set_tuple_status(aTHX_ status, imp_sth, tuple, tuple + 1, FALSE);
+}
+
+/* The array for the tuple status, emptied, if there is one */
+static AV *tuple_status_av(pTHX_ SV *tuple_status)
+{
+  AV *status= NULL;
+
+  if (tuple_status && SvROK(tuple_status) &&
+      SvTYPE(SvRV(tuple_status)) == SVt_PVAV)
+  {
+    status= (AV *) SvRV(tuple_status);
+    av_clear(status);
   }
-  return(rows);
+  return status;
 }
 
- /**************************************************************************
- *
- *  Name:    mysql_st_internal_execute41
- *
- *  Purpose: Internal version for executing a prepared statement, called both
- *           from within the "do" and the "execute" method.
- *           MYSQL 4.1 API
- *
- *
- *  Inputs:  h - object handle, for storing error messages
- *           statement - query being executed
- *           attribs - statement attributes, currently ignored
- *           num_params - number of parameters being bound
- *           params - parameter array
- *           result - where to store results, if any
- *           svsock - socket connected to the database
- *
- **************************************************************************/
+#ifdef HAVE_BULK_EXECUTE
+/* Does the server know about COM_STMT_BULK_EXECUTE (MariaDB 10.2.6+)? */
+static bool bulk_execute_supported(MYSQL *sock)
+{
+  unsigned long capabilities= 0;
 
-#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (mariadb_get_infov(sock, MARIADB_CONNECTION_EXTENDED_SERVER_CAPABILITIES,
+                        &capabilities))
+    return FALSE;
+  return (capabilities & (MARIADB_CLIENT_STMT_BULK_OPERATIONS >> 32)) != 0;
+}
 
-my_ulonglong mysql_st_internal_execute41(
-                                         SV *sth,
-                                         int num_params,
-                                         MYSQL_RES **result,
-                                         MYSQL_STMT *stmt,
-                                         MYSQL_BIND *bind,
-                                         int *has_been_bound
-                                        )
+/*
+  execute_for_fetch for server side prepared statements on MariaDB: the
+  tuples are bound as one array of values per parameter, and up to
+  BULK_EXECUTE_MAX_ROWS of them are sent with a single bulk execute. All
+  values are sent as strings and converted by the server. The values are
+  copied into the statement's query buffer, as the tuples may not live
+  until the batch is sent.
+*/
+static int mysql_st_bulk_execute_for_fetch(SV *sth, imp_sth_t *imp_sth,
+                                           SV *fetch_tuple_sub,
+                                           SV *tuple_status, IV *tuple_count,
+                                           IV *rows, IV *err_count)
 {
-  int i;
-  enum enum_field_types enum_type;
   dTHX;
-  int execute_retval;
-  my_ulonglong rows=0;
   D_imp_xxh(sth);
+  D_imp_dbh_from_sth;
+  MYSQL_STMT *stmt= imp_sth->stmt;
+  MYSQL_BIND *bind;
+  AV *status;
+  STRLEN *offsets, *value_lengths, data_len= 0, limit;
+  unsigned long *lengths;
+  char **buffers, *indicators, **values;
+  unsigned int count= 0, array_size;
+  IV i, j, k, chunk_first= 0, num_params= DBIc_NUM_PARAMS(imp_sth);
+  int retval= 1;
 
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "\t-> mysql_st_internal_execute41\n");
-
-  /* free result if exists */
-  if (*result)
+                  " -> mysql_st_bulk_execute_for_fetch\n");
+
+  status= tuple_status_av(aTHX_ tuple_status);
+
+  ENTER;
+  SAVETMPS;
+
+  Newz(908, bind, num_params, MYSQL_BIND);
+  SAVEFREEPV(bind);
+  Newz(908, offsets, num_params * BULK_EXECUTE_MAX_ROWS, STRLEN);
+  SAVEFREEPV(offsets);
+  Newz(908, lengths, num_params * BULK_EXECUTE_MAX_ROWS, unsigned long);
+  SAVEFREEPV(lengths);
+  Newz(908, buffers, num_params * BULK_EXECUTE_MAX_ROWS, char *);
+  SAVEFREEPV(buffers);
+  Newz(908, indicators, num_params * BULK_EXECUTE_MAX_ROWS, char);
+  SAVEFREEPV(indicators);
+  /* The values of the current tuple, read once */
+  Newz(908, values, num_params, char *);
+  SAVEFREEPV(values);
+  Newz(908, value_lengths, num_params, STRLEN);
+  SAVEFREEPV(value_lengths);
+  for (i= 0; i < num_params; i++)
   {
-    mysql_free_result(*result);
-    *result= 0;
+    bind[i].buffer_type= MYSQL_TYPE_STRING;
+    bind[i].buffer= buffers + i * BULK_EXECUTE_MAX_ROWS;
+    bind[i].length= lengths + i * BULK_EXECUTE_MAX_ROWS;
+    bind[i].u.indicator= indicators + i * BULK_EXECUTE_MAX_ROWS;
   }
 
-  /*
-    If were performed any changes with ph variables
-    we have to rebind them
-  */
+  mysql_st_free_result_sets(sth, imp_sth);
+  limit= max_allowed_packet(aTHX_ imp_dbh);
+  if (limit > MULTI_INSERT_MAX_PACKET)
+    limit= MULTI_INSERT_MAX_PACKET;
 
-  if (num_params > 0 && !(*has_been_bound))
+  /* The arrays are bound now, so execute must bind imp_sth->bind again */
+  imp_sth->has_been_bound= 0;
+  if (mysql_stmt_bind_param(stmt, bind))
   {
-    if (mysql_stmt_bind_param(stmt,bind))
-      goto error;
-
-    *has_been_bound= 1;
+    do_error(sth, mysql_stmt_errno(stmt), mysql_stmt_error(stmt),
+             mysql_stmt_sqlstate(stmt));
+    FREETMPS;
+    LEAVE;
+    return 0;
   }
 
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "\t\tmysql_st_internal_execute41 calling mysql_execute with %d num_params\n",
-                  num_params);
-
-  execute_retval= mysql_stmt_execute(stmt);
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "\t\tmysql_stmt_execute returned %d\n",
-                  execute_retval);
-  if (execute_retval)
-    goto error;
-
-  /*
-   This statement does not return a result set (INSERT, UPDATE...)
-  */
-  if (!(*result= mysql_stmt_result_metadata(stmt)))
+  for (;;)
   {
-    if (mysql_stmt_errno(stmt))
-      goto error;
+    AV *av= fetch_tuple(aTHX_ fetch_tuple_sub);
+    STRLEN tuple_len= 0;
+    bool bad_tuple= av && av_len(av) + 1 != num_params;
 
-    rows= mysql_stmt_affected_rows(stmt);
+    /* A length prefix and indicator per value, and the value */
+    if (av && !bad_tuple)
+    {
+      for (i= 0; i < num_params; i++)
+      {
+        SV **svp= av_fetch(av, i, FALSE);
+        tuple_len+= 10;
+        values[i]= NULL;
+        if (svp)
+          SvGETMAGIC(*svp);
+        if (svp && SvOK(*svp))
+        {
+          values[i]= SvPV_nomg(*svp, value_lengths[i]);
+          tuple_len+= value_lengths[i];
+        }
+      }
+    }
 
-    /* mysql_stmt_affected_rows(): -1 indicates that the query returned an error */
-    if (rows == (my_ulonglong)-1)
-      goto error;
-  }
-  /*
-    This statement returns a result set (SELECT...)
-  */
-  else
-  {
-    for (i = mysql_stmt_field_count(stmt) - 1; i >=0; --i) {
-        enum_type = mysql_to_perl_type(stmt->fields[i].type);
-        if (enum_type != MYSQL_TYPE_DOUBLE && enum_type != MYSQL_TYPE_LONG && enum_type != MYSQL_TYPE_LONGLONG && enum_type != MYSQL_TYPE_BIT)
+    /* Send what we have, if the batch is full */
+    if (count && (!av || (!bad_tuple && (count == BULK_EXECUTE_MAX_ROWS ||
+                                         data_len + tuple_len >= limit))))
+    {
+      for (i= 0; i < num_params; i++)
+        for (j= 0; j < count; j++)
         {
-            /* mysql_stmt_store_result to update MYSQL_FIELD->max_length */
-            my_bool on = 1;
-            mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &on);
-            break;
+          k= i * BULK_EXECUTE_MAX_ROWS + j;
+          buffers[k]= imp_sth->query_buf + offsets[k];
         }
+      array_size= count;
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                      "\t\tsending tuples %"IVdf" to %"IVdf", %lu bytes\n",
+                      chunk_first, *tuple_count - 1, (unsigned long) data_len);
+
+      if (mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &array_size) ||
+          mysql_stmt_execute(stmt))
+      {
+        do_error(sth, mysql_stmt_errno(stmt), mysql_stmt_error(stmt),
+                 mysql_stmt_sqlstate(stmt));
+        set_tuple_status(aTHX_ status, imp_sth, chunk_first, *tuple_count,
+                         FALSE);
+        *err_count+= *tuple_count - chunk_first;
+        mysql_stmt_reset(stmt);
+      }
+      else
+      {
+        *rows+= mysql_stmt_affected_rows(stmt);
+        imp_sth->insertid= mysql_stmt_insert_id(stmt);
+        imp_sth->warning_count= mysql_warning_count(imp_dbh->pmysql);
+        set_tuple_status(aTHX_ status, imp_sth, chunk_first, *tuple_count,
+                         TRUE);
+      }
+      count= 0;
+      data_len= 0;
+    }
+    if (!av)
+      break;
+
+    if (bad_tuple)
+    {
+      tuple_error(aTHX_ sth, status, imp_sth, *tuple_count, av, num_params);
+      ++*err_count;
     }
-    /* Get the total rows affected and return */
-    if (mysql_stmt_store_result(stmt))
-      goto error;
     else
-      rows= mysql_stmt_num_rows(stmt);
-  }
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "\t<- mysql_internal_execute_41 returning %llu rows\n",
-                  rows);
-  return(rows);
+    {
+      if (!count)
+        chunk_first= *tuple_count;
+      grow_query_buf(&imp_sth->query_buf, &imp_sth->query_buf_size,
+                     data_len + tuple_len);
+      for (i= 0; i < num_params; i++)
+      {
+        k= i * BULK_EXECUTE_MAX_ROWS + count;
+        offsets[k]= data_len;
+        if (values[i])
+        {
+          memcpy(imp_sth->query_buf + data_len, values[i], value_lengths[i]);
+          data_len+= value_lengths[i];
+          lengths[k]= value_lengths[i];
+          indicators[k]= STMT_INDICATOR_NONE;
+        }
+        else
+        {
+          lengths[k]= 0;
+          indicators[k]= STMT_INDICATOR_NULL;
+        }
+      }
+      count++;
+    }
 
-error:
-  if (*result)
-  {
-    mysql_free_result(*result);
-    *result= 0;
+    ++*tuple_count;
+    FREETMPS;
   }
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "     errno %d err message %s\n",
-                  mysql_stmt_errno(stmt),
-                  mysql_stmt_error(stmt));
-  do_error(sth, mysql_stmt_errno(stmt), mysql_stmt_error(stmt),
-           mysql_stmt_sqlstate(stmt));
-  mysql_stmt_reset(stmt);
+
+  /* Back to executing the statement once */
+  array_size= 0;
+  mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &array_size);
+
+  FREETMPS;
+  LEAVE;
+  free_query_buf(&imp_sth->query_buf, &imp_sth->query_buf_size, TRUE);
+
+  imp_sth->row_num= *rows;
+  if (*err_count)
+    retval= 0;
 
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  "\t<- mysql_st_internal_execute41\n");
-  return -2;
-
+                  " <- mysql_st_bulk_execute_for_fetch %"IVdf" tuples, %"IVdf" errors\n",
+                  *tuple_count, *err_count);
+  return retval;
 }
 #endif
 
-
-/***************************************************************************
- *
- *  Name:    dbd_st_execute
- *
- *  Purpose: Called for preparing an SQL statement; our part of the
- *           statement handle constructor
- *
- *  Input:   sth - statement handle being initialized
- *           imp_sth - drivers private statement handle data
- *
- *  Returns: TRUE for success, FALSE otherwise; do_error will
- *           be called in the latter case
- *
- **************************************************************************/
-
-int dbd_st_execute(SV* sth, imp_sth_t* imp_sth)
+int mysql_st_execute_for_fetch(SV *sth, imp_sth_t *imp_sth,
+                               SV *fetch_tuple_sub, SV *tuple_status,
+                               IV *tuple_count, IV *rows, IV *err_count)
 {
   dTHX;
-  char actual_row_num[64];
-  int i;
-  SV **statement;
-  D_imp_dbh_from_sth;
   D_imp_xxh(sth);
-#if defined (dTHR)
-  dTHR;
+  D_imp_dbh_from_sth;
+  imp_sth_tmpl_t *tmpl, values;
+  imp_sth_ph_t *params;
+  AV *status;
+  SV **statement;
+  char *sbuf, *group;
+  STRLEN slen, open, close, suffix, group_len, chunk_len= 0;
+  STRLEN limit;
+  IV i, chunk_first= 0, num_params= DBIc_NUM_PARAMS(imp_sth);
+  int retval= 1;
+
+  *tuple_count= *rows= *err_count= 0;
+  PREFETCH_STOP_STH(imp_sth);
+
+#if MYSQL_ASYNC
+  if (imp_sth->is_async)
+    return -1;
 #endif
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  int use_server_side_prepare = imp_sth->use_server_side_prepare;
-  int disable_fallback_for_server_prepare = imp_sth->disable_fallback_for_server_prepare;
+  /* long data is sent one statement at a time */
+  if (sth_long_data(imp_sth))
+    return -1;
+  if (imp_sth->use_server_side_prepare)
+  {
+#ifdef HAVE_BULK_EXECUTE
+    /* Only statements without a result set can be executed in bulk */
+    if (imp_sth->stmt && num_params && !imp_sth->use_mysql_use_result &&
+        !mysql_stmt_field_count(imp_sth->stmt) &&
+        bulk_execute_supported(imp_dbh->pmysql))
+      return mysql_st_bulk_execute_for_fetch(sth, imp_sth, fetch_tuple_sub,
+                                             tuple_status, tuple_count, rows,
+                                             err_count);
+#endif
+    return -1;
+  }
 #endif
-
-  ASYNC_CHECK_RETURN(sth, -2);
+  statement= hv_fetch((HV*) SvRV(sth), "Statement", 9, FALSE);
+  if (!num_params || !statement || !SvOK(*statement))
+    return -1;
+  sbuf= SvPV(*statement, slen);
+  tmpl= sth_params_tmpl(imp_xxh, aTHX_ imp_sth, sbuf, slen,
+                        imp_dbh->bind_comment_placeholders);
+  if (tmpl->num_pos != num_params || !find_values_list(tmpl, &open, &close))
+    return -1;
 
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-      " -> dbd_st_execute for %p\n", sth);
+                  " -> mysql_st_execute_for_fetch, values list at %lu-%lu\n",
+                  (unsigned long) open, (unsigned long) close);
+
+  status= tuple_status_av(aTHX_ tuple_status);
+
+  ENTER;
+  SAVETMPS;
+
+  /* "(?, ...)" as a statement of its own, for filling in the values */
+  values.statement= tmpl->statement + open;
+  values.length= close - open + 1;
+  values.num_pos= tmpl->num_pos;
+  values.bind_comment_placeholders= tmpl->bind_comment_placeholders;
+  Newz(908, values.pos, values.num_pos, imp_sth_ph_pos_t);
+  SAVEFREEPV(values.pos);
+  for (i= 0; i < values.num_pos; i++)
+    values.pos[i].offset= tmpl->pos[i].offset - open;
+  Newz(908, params, num_params, imp_sth_ph_t);
+  SAVEFREEPV(params);
 
-  if (!SvROK(sth)  ||  SvTYPE(SvRV(sth)) != SVt_PVHV)
-    croak("Expected hash array");
+  mysql_st_free_result_sets(sth, imp_sth);
+  limit= max_allowed_packet(aTHX_ imp_dbh);
+  if (limit > MULTI_INSERT_MAX_PACKET)
+    limit= MULTI_INSERT_MAX_PACKET;
+  suffix= tmpl->length - close - 1;
 
-  /* Free cached array attributes */
-  for (i= 0;  i < AV_ATTRIB_LAST;  i++)
+  for (;;)
   {
-    if (imp_sth->av_attr[i])
-      SvREFCNT_dec(imp_sth->av_attr[i]);
-
-    imp_sth->av_attr[i]= Nullav;
-  }
+    AV *av= fetch_tuple(aTHX_ fetch_tuple_sub);
+    bool bad_tuple= FALSE;
+
+    group= NULL;
+    group_len= 0;
+    if (av && av_len(av) + 1 != num_params)
+      bad_tuple= TRUE;
+    else if (av)
+    {
+      for (i= 0; i < num_params; i++)
+      {
+        SV **svp= av_fetch(av, i, FALSE);
+        params[i].value= svp ? *svp : NULL;
+        params[i].type= imp_sth->params[i].type;
+      }
+      group= fill_params(imp_xxh, aTHX_ imp_dbh->pmysql, &values,
+                         &imp_sth->query_buf, &imp_sth->query_buf_size,
+                         &group_len, params, num_params,
+                         imp_dbh->bind_type_guessing);
+    }
 
-  statement= hv_fetch((HV*) SvRV(sth), "Statement", 9, FALSE);
+    /* Send what we have, if this tuple does not fit in anymore */
+    if (chunk_len && (!group || chunk_len + 1 + group_len + suffix >= limit))
+    {
+      memcpy(imp_dbh->query_buf + chunk_len, tmpl->statement + close + 1,
+             suffix);
+      chunk_len+= suffix;
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                      "\t\tsending tuples %"IVdf" to %"IVdf", %lu bytes\n",
+                      chunk_first, *tuple_count - 1, (unsigned long) chunk_len);
 
-  /* 
-     Clean-up previous result set(s) for sth to prevent
-     'Commands out of sync' error 
-  */
-  mysql_st_free_result_sets (sth, imp_sth);
+      if ((mysql_real_query(imp_dbh->pmysql, imp_dbh->query_buf, chunk_len)) &&
+          (!mysql_db_reconnect(sth) ||
+           (mysql_real_query(imp_dbh->pmysql, imp_dbh->query_buf, chunk_len))))
+      {
+        do_error(sth, mysql_errno(imp_dbh->pmysql),
+                 mysql_error(imp_dbh->pmysql),
+                 mysql_sqlstate(imp_dbh->pmysql));
+        set_tuple_status(aTHX_ status, imp_sth, chunk_first, *tuple_count,
+                         FALSE);
+        *err_count+= *tuple_count - chunk_first;
+      }
+      else
+      {
+        MYSQL_RES *res= mysql_store_result(imp_dbh->pmysql);
+        if (res)
+          mysql_free_result(res);
+        *rows+= mysql_affected_rows(imp_dbh->pmysql);
+        imp_sth->insertid= mysql_insert_id(imp_dbh->pmysql);
+        imp_sth->warning_count= mysql_warning_count(imp_dbh->pmysql);
+        set_tuple_status(aTHX_ status, imp_sth, chunk_first, *tuple_count,
+                         TRUE);
+      }
+      chunk_len= 0;
+    }
+    if (!av)
+      break;
 
-#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  if (use_server_side_prepare)
-  {
-    if (imp_sth->use_mysql_use_result)
+    if (bad_tuple)
+    {
+      tuple_error(aTHX_ sth, status, imp_sth, *tuple_count, av, num_params);
+      ++*err_count;
+    }
+    else
     {
-      if (disable_fallback_for_server_prepare)
+      /* "INSERT ... VALUES " before the first tuple, a comma otherwise */
+      if (!chunk_len)
       {
-        do_error(sth, ER_UNSUPPORTED_PS,
-                 "\"mysql_use_result\" not supported with server side prepare",
-                 "HY000");
-        return 0;
+        chunk_first= *tuple_count;
+        grow_query_buf(&imp_dbh->query_buf, &imp_dbh->query_buf_size,
+                       open + group_len + suffix + 1);
+        memcpy(imp_dbh->query_buf, tmpl->statement, open);
+        chunk_len= open;
+      }
+      else
+      {
+        grow_query_buf(&imp_dbh->query_buf, &imp_dbh->query_buf_size,
+                       chunk_len + 1 + group_len + suffix + 1);
+        imp_dbh->query_buf[chunk_len++]= ',';
       }
-      use_server_side_prepare = 0;
+      memcpy(imp_dbh->query_buf + chunk_len, group, group_len);
+      chunk_len+= group_len;
     }
 
-    if (use_server_side_prepare)
-    {
-      imp_sth->row_num= mysql_st_internal_execute41(
-                                                    sth,
-                                                    DBIc_NUM_PARAMS(imp_sth),
-                                                    &imp_sth->result,
-                                                    imp_sth->stmt,
-                                                    imp_sth->bind,
-                                                    &imp_sth->has_been_bound
-                                                   );
-      if (imp_sth->row_num == (my_ulonglong)-2) /* -2 means error */
-      {
-        SV *err = DBIc_ERR(imp_xxh);
-        if (!disable_fallback_for_server_prepare && SvIV(err) == ER_UNSUPPORTED_PS)
-        {
-          use_server_side_prepare = 0;
-        }
-      }
-    }
-  }
+    ++*tuple_count;
+    FREETMPS;
+  }
+
+  FREETMPS;
+  LEAVE;
+  free_query_buf(&imp_sth->query_buf, &imp_sth->query_buf_size, TRUE);
+  free_query_buf(&imp_dbh->query_buf, &imp_dbh->query_buf_size, TRUE);
+
+  imp_sth->row_num= *rows;
+  if (*err_count)
+    retval= 0;
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  " <- mysql_st_execute_for_fetch %"IVdf" tuples, %"IVdf" errors\n",
+                  *tuple_count, *err_count);
+  return retval;
+}
+
+ /* The conversion dbd_st_fetch applies to the values of a column */
+static enum column_conv column_conv(imp_dbh_t *imp_dbh, MYSQL_FIELD *field)
+{
+  switch (mysql_to_perl_type(field->type)) {
+  case MYSQL_TYPE_DOUBLE:
+    return field->flags & ZEROFILL_FLAG ? COLUMN_CONV_STRING :
+      COLUMN_CONV_DOUBLE;
+
+  case MYSQL_TYPE_LONG:
+  case MYSQL_TYPE_LONGLONG:
+    if (field->flags & ZEROFILL_FLAG)
+      return COLUMN_CONV_STRING;
+    return field->flags & UNSIGNED_FLAG ? COLUMN_CONV_UV : COLUMN_CONV_IV;
+
+#if MYSQL_VERSION_ID > NEW_DATATYPE_VERSION
+  case MYSQL_TYPE_BIT:
+    return COLUMN_CONV_STRING;
+#endif
+
+  default:
+#if defined(sv_utf8_decode) && MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
+    if ((imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4) &&
+        field->charsetnr != 63)
+      return COLUMN_CONV_UTF8;
+#endif
+    return COLUMN_CONV_STRING;
+  }
+}
+
+/*
+  Converters from the text of a value to a Perl scalar, one of which is
+  chosen per result column by dbd_describe. Numbers are parsed from the
+  text directly rather than set as a string first; whatever is out of
+  the simple cases is left to SvIV and friends, as it was before.
+*/
+static void conv_string(pTHX_ SV *sv, const char *col, STRLEN len)
+{
+  sv_setpvn(sv, col, len);
+}
+
+static void conv_utf8(pTHX_ SV *sv, const char *col, STRLEN len)
+{
+  sv_setpvn(sv, col, len);
+  sv_utf8_decode(sv);
+}
+
+static void conv_double(pTHX_ SV *sv, const char *col, STRLEN len)
+{
+  char buf[64];
 
-  if (!use_server_side_prepare)
-#endif
+  if (len < sizeof(buf))
   {
-    imp_sth->row_num= mysql_st_internal_execute(
-                                                sth,
-                                                *statement,
-                                                NULL,
-                                                DBIc_NUM_PARAMS(imp_sth),
-                                                imp_sth->params,
-                                                &imp_sth->result,
-                                                imp_dbh->pmysql,
-                                                imp_sth->use_mysql_use_result
-                                               );
-#if MYSQL_ASYNC
-    if(imp_dbh->async_query_in_flight) {
-        DBIc_ACTIVE_on(imp_sth);
-        return 0;
-    }
-#endif
+    Copy(col, buf, len, char);
+    buf[len]= '\0';
+    sv_setnv(sv, Atof(buf));
+    return;
   }
+  sv_setpvn(sv, col, len);
+  sv_setnv(sv, SvNV(sv));
+}
 
-  if (imp_sth->row_num+1 != (my_ulonglong)-1)
+static void conv_iv(pTHX_ SV *sv, const char *col, STRLEN len)
+{
+  UV value;
+  int flags= grok_number(col, len, &value);
+
+  if ((flags & ~IS_NUMBER_NEG) == IS_NUMBER_IN_UV && value <= (UV) IV_MAX)
   {
-    if (!imp_sth->result)
-    {
-      imp_sth->insertid= mysql_insert_id(imp_dbh->pmysql);
-#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
-      if (mysql_more_results(imp_dbh->pmysql))
-        DBIc_ACTIVE_on(imp_sth);
-#endif
-    }
-    else
-    {
-      /** Store the result in the current statement handle */
-      DBIc_NUM_FIELDS(imp_sth)= mysql_num_fields(imp_sth->result);
-      DBIc_ACTIVE_on(imp_sth);
-      if (!use_server_side_prepare)
-        imp_sth->done_desc= 0;
-      imp_sth->fetch_done= 0;
-    }
+    sv_setiv(sv, flags & IS_NUMBER_NEG ? -(IV) value : (IV) value);
+    return;
   }
+  sv_setpvn(sv, col, len);
+  sv_setiv(sv, SvIV(sv));
+}
 
-  imp_sth->warning_count = mysql_warning_count(imp_dbh->pmysql);
+static void conv_uv(pTHX_ SV *sv, const char *col, STRLEN len)
+{
+  UV value;
 
-  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+  if (grok_number(col, len, &value) == IS_NUMBER_IN_UV)
   {
-    /* 
-      PerlIO_printf doesn't always handle imp_sth->row_num %llu 
-      consistently!!
-    */
-    sprintf(actual_row_num, "%llu", imp_sth->row_num);
-    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                  " <- dbd_st_execute returning imp_sth->row_num %s\n",
-                  actual_row_num);
+    sv_setuv(sv, value);
+    return;
   }
-
-  return (int)imp_sth->row_num;
+  sv_setpvn(sv, col, len);
+  sv_setuv(sv, SvUV(sv));
 }
 
- /**************************************************************************
+/* By enum column_conv */
+static void (*const column_converters[])(pTHX_ SV *, const char *, STRLEN)= {
+  conv_string,
+  conv_utf8,
+  conv_double,
+  conv_iv,
+  conv_uv
+};
+
+/**************************************************************************
  *
  *  Name:    dbd_describe
  *
@@ -3893,6 +6861,7 @@ int dbd_describe(SV* sth, imp_sth_t* imp_sth)
 {
   dTHX;
   D_imp_xxh(sth);
+  D_imp_dbh_from_sth;
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t--> dbd_describe\n");
 
@@ -3924,6 +6893,9 @@ int dbd_describe(SV* sth, imp_sth_t* imp_sth)
       return 0;
     }
 
+    free_result_buffers(imp_sth);
+    remember_result_fields(aTHX_ imp_sth);
+
     /* allocate fields buffers  */
     if (  !(imp_sth->fbh= alloc_fbuffer(num_fields))
           || !(imp_sth->buffer= alloc_bind(num_fields)) )
@@ -3990,7 +6962,32 @@ int dbd_describe(SV* sth, imp_sth_t* imp_sth)
         break;
 
       default:
-        buffer->buffer_length= fields[i].max_length ? fields[i].max_length : 1;
+        if (imp_sth->defer_blobs &&
+            (col_type == MYSQL_TYPE_TINY_BLOB ||
+             col_type == MYSQL_TYPE_BLOB ||
+             col_type == MYSQL_TYPE_MEDIUM_BLOB ||
+             col_type == MYSQL_TYPE_LONG_BLOB))
+        {
+          /* nothing is copied by mysql_stmt_fetch, see dbd_st_blob_read */
+          fbh->deferred= TRUE;
+          buffer->buffer_length= 0;
+          buffer->buffer= NULL;
+          break;
+        }
+        if (fields[i].max_length)
+          buffer->buffer_length= fields[i].max_length;
+        else if ((!imp_sth->result_stored || imp_sth->adaptive_buffer_limit) &&
+                 fields[i].length)
+        {
+          /* the longest value is not known before the rows are fetched */
+          unsigned long limit= imp_sth->adaptive_buffer_limit ?
+            imp_sth->adaptive_buffer_limit : STREAMED_COLUMN_BUFFER;
+
+          buffer->buffer_length= fields[i].length < limit ?
+            fields[i].length : limit;
+        }
+        else
+          buffer->buffer_length= 1;
         Newz(908, fbh->data, buffer->buffer_length, char);
         buffer->buffer= (char *) fbh->data;
       }
@@ -4004,7 +7001,32 @@ int dbd_describe(SV* sth, imp_sth_t* imp_sth)
       return 0;
     }
   }
+  else
 #endif
+  if (!imp_sth->done_desc && imp_sth->result)
+  {
+    /* The conversion of each column, rather than working it out per value */
+    int i, num_fields= mysql_num_fields(imp_sth->result);
+    MYSQL_FIELD *fields= mysql_fetch_fields(imp_sth->result);
+
+    remember_result_fields(aTHX_ imp_sth);
+    if (num_fields > imp_sth->num_conv)
+    {
+      if (imp_sth->conv)
+        Renew(imp_sth->conv, num_fields, imp_sth_conv_t);
+      else
+        New(908, imp_sth->conv, num_fields, imp_sth_conv_t);
+      imp_sth->num_conv= num_fields;
+    }
+    for (i= 0; i < num_fields; i++)
+    {
+      imp_sth->conv[i].kind= column_conv(imp_dbh, fields + i);
+      imp_sth->conv[i].convert= column_converters[imp_sth->conv[i].kind];
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tcolumn %d conversion %d\n",
+                      i, (int) imp_sth->conv[i].kind);
+    }
+  }
 
   imp_sth->done_desc= 1;
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
@@ -4012,39 +7034,296 @@ int dbd_describe(SV* sth, imp_sth_t* imp_sth)
   return TRUE;
 }
 
-/**************************************************************************
- *
- *  Name:    dbd_st_fetch
- *
- *  Purpose: Called for fetching a result row
- *
- *  Input:   sth - statement handle being initialized
- *           imp_sth - drivers private statement handle data
- *
- *  Returns: array of columns; the array is allocated by DBI via
- *           DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth), even the values
- *           of the array are prepared, we just need to modify them
- *           appropriately
- *
- **************************************************************************/
+/* A fresh array of columns for a row of fetchall_arrayref */
+static AV *new_row_av(pTHX_ imp_sth_t *imp_sth, AV *row, int num_fields)
+{
+  int i;
 
-AV*
-dbd_st_fetch(SV *sth, imp_sth_t* imp_sth)
+  av_extend(row, num_fields - 1);
+  for (i= 0; i < num_fields; i++)
+    av_store(row, i, newSV(0));
+  /* as done by get_fbav */
+  ++DBIc_ROW_COUNT(imp_sth);
+  return row;
+}
+
+/*
+  Fetch kernels, the loops setting the columns of one row. They are
+  compiled once for each combination of ChopBlanks, mysql_enable_utf8
+  and tracing, which are then not tested again for every column; the
+  kernel for the handle is looked up once per row.
+*/
+#define FETCH_KERNEL_INDEX(chop_blanks, utf8, trace) \
+  (((chop_blanks) ? 1 : 0) | ((utf8) ? 2 : 0) | ((trace) ? 4 : 0))
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+static inline void fetch_bind_kernel(pTHX_ SV *sth, imp_sth_t *imp_sth,
+                                      AV *av, int num_fields,
+                                      const int chop_blanks,
+                                      const int utf8, const int trace)
+{
+  int i;
+  MYSQL_BIND *buffer;
+  imp_sth_fbh_t *fbh;
+
+  for (
+       buffer= imp_sth->buffer,
+       fbh= imp_sth->fbh,
+       i= 0;
+       i < num_fields;
+       i++,
+       fbh++,
+       buffer++
+      )
+  {
+    SV *sv= AvARRAY(av)[i]; /* Note: we (re)use the SV in the AV	*/
+    STRLEN len;
+
+    /* This is wrong, null is not being set correctly
+     * This is not the way to determine length (this would break blobs!)
+     */
+    if (fbh->is_null)
+    {
+      (void) SvOK_off(sv);  /*  Field is NULL, return undef  */
+      continue;
+    }
+
+    /* Left to blob_read, see mysql_defer_blobs */
+    if (fbh->deferred)
+    {
+      (void) SvOK_off(sv);
+      continue;
+    }
+
+    if (fbh->length > fbh->width)
+      fbh->width= fbh->length;
+
+    /* In case of BLOB/TEXT fields we allocate only 8192 bytes
+       in dbd_describe() for data. Here we know real size of field
+       so we should increase buffer size and refetch column value
+    */
+    if (fbh->length > buffer->buffer_length || fbh->error)
+    {
+      /* the part which did fit into the buffer is kept */
+      unsigned long fetched= fbh->length > buffer->buffer_length ?
+        buffer->buffer_length : 0;
+      MYSQL_BIND rest;
+
+      if (trace)
+        PerlIO_printf(DBIc_LOGPIO(imp_sth),
+          "\t\tRefetch BLOB/TEXT column: %d, length: %lu, error: %d\n",
+          i, fbh->length, fbh->error);
+
+      Renew(fbh->data, fbh->length, char);
+      buffer->buffer_length= fbh->length;
+      buffer->buffer= (char *) fbh->data;
+      imp_sth->stmt->bind[i].buffer_length = fbh->length;
+      imp_sth->stmt->bind[i].buffer = (char *)fbh->data;
+
+      if (trace) {
+        int j;
+        int m = MIN(*buffer->length, buffer->buffer_length);
+        char *ptr = (char*)buffer->buffer;
+        PerlIO_printf(DBIc_LOGPIO(imp_sth),"\t\tbefore buffer->buffer: ");
+        for (j = 0; j < m; j++) {
+          PerlIO_printf(DBIc_LOGPIO(imp_sth), "%c", *ptr++);
+        }
+        PerlIO_printf(DBIc_LOGPIO(imp_sth),"\n");
+      }
+
+      rest= *buffer;
+      rest.buffer= fbh->data + fetched;
+      rest.buffer_length= fbh->length - fetched;
+      if (mysql_stmt_fetch_column(imp_sth->stmt, &rest, i, fetched))
+        do_error(sth, mysql_stmt_errno(imp_sth->stmt),
+                 mysql_stmt_error(imp_sth->stmt),
+                 mysql_stmt_sqlstate(imp_sth->stmt));
+
+      if (trace) {
+        int j;
+        int m = MIN(*buffer->length, buffer->buffer_length);
+        char *ptr = (char*)buffer->buffer;
+        PerlIO_printf(DBIc_LOGPIO(imp_sth),"\t\tafter buffer->buffer: ");
+        for (j = 0; j < m; j++) {
+          PerlIO_printf(DBIc_LOGPIO(imp_sth), "%c", *ptr++);
+        }
+        PerlIO_printf(DBIc_LOGPIO(imp_sth),"\n");
+      }
+    }
+
+    /* This does look a lot like Georg's PHP driver doesn't it?  --Brian */
+    /* Credit due to Georg - mysqli_api.c  ;) --PMG */
+    switch (buffer->buffer_type) {
+    case MYSQL_TYPE_DOUBLE:
+      if (trace)
+        PerlIO_printf(DBIc_LOGPIO(imp_sth), "\t\tst_fetch double data %f\n", fbh->ddata);
+      sv_setnv(sv, fbh->ddata);
+      break;
+
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+      if (trace)
+        PerlIO_printf(DBIc_LOGPIO(imp_sth), "\t\tst_fetch int data %"IVdf", unsigned? %d\n",
+                      fbh->ldata, buffer->is_unsigned);
+      if (buffer->is_unsigned)
+        sv_setuv(sv, fbh->ldata);
+      else
+        sv_setiv(sv, fbh->ldata);
+
+      break;
+
+    case MYSQL_TYPE_BIT:
+      sv_setpvn(sv, fbh->data, fbh->length);
+
+      break;
+
+    default:
+      if (trace)
+        PerlIO_printf(DBIc_LOGPIO(imp_sth), "\t\tERROR IN st_fetch_string");
+      len= fbh->length;
+      /* ChopBlanks server-side prepared statement */
+      if (chop_blanks)
+      {
+        /*
+          see bottom of:
+          http://www.mysql.org/doc/refman/5.0/en/c-api-datatypes.html
+        */
+        if (fbh->charsetnr != 63)
+          while (len && fbh->data[len-1] == ' ') { --len; }
+      }
+      /* END OF ChopBlanks */
+
+      sv_setpvn(sv, fbh->data, len);
+
+      /* UTF8 */
+      /*HELMUT*/
+#if defined(sv_utf8_decode)
+
+#if MYSQL_VERSION_ID >= FIELD_CHARSETNR_VERSION
+      /* SHOW COLLATION WHERE Id = 63; -- 63 == charset binary, collation binary */
+      if (utf8 && fbh->charsetnr != 63)
+#else
+      if (utf8 && !(fbh->flags & BINARY_FLAG))
+#endif
+        sv_utf8_decode(sv);
+#endif
+      /* END OF UTF8 */
+      break;
+    }
+
+  }
+}
+
+#define FETCH_BIND_KERNEL(name, chop_blanks, utf8, trace) \
+static void name(pTHX_ SV *sth, imp_sth_t *imp_sth, AV *av, int num_fields) \
+{ \
+  fetch_bind_kernel(aTHX_ sth, imp_sth, av, num_fields, chop_blanks, utf8, \
+                    trace); \
+}
+
+FETCH_BIND_KERNEL(fetch_bind_plain, 0, 0, 0)
+FETCH_BIND_KERNEL(fetch_bind_chop, 1, 0, 0)
+FETCH_BIND_KERNEL(fetch_bind_utf8, 0, 1, 0)
+FETCH_BIND_KERNEL(fetch_bind_chop_utf8, 1, 1, 0)
+FETCH_BIND_KERNEL(fetch_bind_plain_trace, 0, 0, 1)
+FETCH_BIND_KERNEL(fetch_bind_chop_trace, 1, 0, 1)
+FETCH_BIND_KERNEL(fetch_bind_utf8_trace, 0, 1, 1)
+FETCH_BIND_KERNEL(fetch_bind_chop_utf8_trace, 1, 1, 1)
+#undef FETCH_BIND_KERNEL
+
+/* By trace, utf8 and ChopBlanks, see FETCH_KERNEL_INDEX */
+static void (*const fetch_bind_kernels[])(pTHX_ SV *, imp_sth_t *, AV *, int)= {
+  fetch_bind_plain,
+  fetch_bind_chop,
+  fetch_bind_utf8,
+  fetch_bind_chop_utf8,
+  fetch_bind_plain_trace,
+  fetch_bind_chop_trace,
+  fetch_bind_utf8_trace,
+  fetch_bind_chop_utf8_trace
+};
+#endif
+
+static inline void fetch_row_kernel(pTHX_ imp_sth_t *imp_sth, AV *av,
+                                     MYSQL_ROW cols, unsigned long *lengths,
+                                     int num_fields, const int chop_blanks,
+                                     const int borrow)
+{
+  int i;
+  const imp_sth_conv_t *conv= imp_sth->conv;
+  SV *owner= borrow ? result_owner(aTHX_ imp_sth) : NULL;
+
+  for (i= 0;  i < num_fields; ++i)
+  {
+    char *col= cols[i];
+    SV *sv= AvARRAY(av)[i]; /* Note: we (re)use the SV in the AV	*/
+
+    if (borrow)
+    {
+      /* not into the caller's own scalars, bound by bind_col */
+      if (col && conv[i].kind <= COLUMN_CONV_UTF8 && SvREFCNT(sv) == 1)
+      {
+        borrow_value(aTHX_ sv, owner, col, lengths[i],
+                     conv[i].kind == COLUMN_CONV_UTF8);
+        continue;
+      }
+      release_value(aTHX_ sv);
+    }
+
+    if (col)
+    {
+      STRLEN len= lengths[i];
+      if (chop_blanks)
+      {
+        while (len && col[len-1] == ' ')
+        {	--len; }
+      }
+
+      /* Set the value as planned by dbd_describe */
+      conv[i].convert(aTHX_ sv, col, len);
+    }
+    else
+      (void) SvOK_off(sv);  /*  Field is NULL, return undef  */
+  }
+}
+
+#define FETCH_ROW_KERNEL(name, chop_blanks, borrow) \
+static void name(pTHX_ imp_sth_t *imp_sth, AV *av, MYSQL_ROW cols, \
+                 unsigned long *lengths, int num_fields) \
+{ \
+  fetch_row_kernel(aTHX_ imp_sth, av, cols, lengths, num_fields, \
+                   chop_blanks, borrow); \
+}
+
+FETCH_ROW_KERNEL(fetch_row_plain, 0, 0)
+FETCH_ROW_KERNEL(fetch_row_chop, 1, 0)
+FETCH_ROW_KERNEL(fetch_row_borrow, 0, 1)
+#undef FETCH_ROW_KERNEL
+
+/* By ChopBlanks and mysql_borrow_strings, which do not go together */
+static void (*const fetch_row_kernels[])(pTHX_ imp_sth_t *, AV *, MYSQL_ROW,
+                                         unsigned long *, int)= {
+  fetch_row_plain,
+  fetch_row_chop,
+  fetch_row_borrow
+};
+
+/*
+  Fetches the next row into the given array, or into DBI's fbav if row
+  is NULL, see dbd_st_fetch
+*/
+static AV *st_fetch_into(SV *sth, imp_sth_t* imp_sth, AV *row)
 {
   dTHX;
-  int num_fields, ChopBlanks, i, rc;
+  int num_fields, ChopBlanks, rc;
+  bool borrow;
   unsigned long *lengths;
   AV *av;
   int av_length, av_readonly;
   MYSQL_ROW cols;
   D_imp_dbh_from_sth;
   MYSQL* svsock= imp_dbh->pmysql;
-  imp_sth_fbh_t *fbh;
   D_imp_xxh(sth);
-#if MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
-  MYSQL_BIND *buffer;
-#endif
-  MYSQL_FIELD *fields;
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t-> dbd_st_fetch\n");
 
@@ -4097,6 +7376,9 @@ dbd_st_fetch(SV *sth, imp_sth_t* imp_sth)
   }
 
   /* fix from 2.9008 */
+#ifdef HAVE_PREFETCH_ROWS
+  if (!prefetch_keeps_error(imp_sth))
+#endif
   imp_dbh->pmysql->net.last_errno = 0;
 
 #if MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
@@ -4113,166 +7395,45 @@ dbd_st_fetch(SV *sth, imp_sth_t* imp_sth)
                 mysql_stmt_sqlstate(imp_sth->stmt));
 
 #if MYSQL_VERSION_ID >= MYSQL_VERSION_5_0 
-      if (rc == MYSQL_DATA_TRUNCATED) {
-        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tdbd_st_fetch data truncated\n");
-        goto process;
-      }
-#endif
-
-      if (rc == MYSQL_NO_DATA)
-      {
-        /* Update row_num to affected_rows value */
-        imp_sth->row_num= mysql_stmt_affected_rows(imp_sth->stmt);
-        imp_sth->fetch_done=1;
-        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tdbd_st_fetch no data\n");
-      }
-
-      dbd_st_finish(sth, imp_sth);
-
-      return Nullav;
-    }
-
-process:
-    imp_sth->currow++;
-
-    av= DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth);
-    num_fields=mysql_stmt_field_count(imp_sth->stmt);
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                    "\t\tdbd_st_fetch called mysql_fetch, rc %d num_fields %d\n",
-                    rc, num_fields);
-
-    for (
-         buffer= imp_sth->buffer,
-         fbh= imp_sth->fbh,
-         i= 0;
-         i < num_fields;
-         i++,
-         fbh++,
-         buffer++
-        )
-    {
-      SV *sv= AvARRAY(av)[i]; /* Note: we (re)use the SV in the AV	*/
-      STRLEN len;
-
-      /* This is wrong, null is not being set correctly
-       * This is not the way to determine length (this would break blobs!)
-       */
-      if (fbh->is_null)
-        (void) SvOK_off(sv);  /*  Field is NULL, return undef  */
-      else
-      {
-        /* In case of BLOB/TEXT fields we allocate only 8192 bytes
-           in dbd_describe() for data. Here we know real size of field
-           so we should increase buffer size and refetch column value
-        */
-        if (fbh->length > buffer->buffer_length || fbh->error)
-        {
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-              "\t\tRefetch BLOB/TEXT column: %d, length: %lu, error: %d\n",
-              i, fbh->length, fbh->error);
-
-          Renew(fbh->data, fbh->length, char);
-          buffer->buffer_length= fbh->length;
-          buffer->buffer= (char *) fbh->data;
-          imp_sth->stmt->bind[i].buffer_length = fbh->length;
-          imp_sth->stmt->bind[i].buffer = (char *)fbh->data;
-
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2) {
-            int j;
-            int m = MIN(*buffer->length, buffer->buffer_length);
-            char *ptr = (char*)buffer->buffer;
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),"\t\tbefore buffer->buffer: ");
-            for (j = 0; j < m; j++) {
-              PerlIO_printf(DBIc_LOGPIO(imp_xxh), "%c", *ptr++);
-            }
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),"\n");
-          }
-
-          /*TODO: Use offset instead of 0 to fetch only remain part of data*/
-          if (mysql_stmt_fetch_column(imp_sth->stmt, buffer , i, 0))
-            do_error(sth, mysql_stmt_errno(imp_sth->stmt),
-                     mysql_stmt_error(imp_sth->stmt),
-                     mysql_stmt_sqlstate(imp_sth->stmt));
-
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2) {
-            int j;
-            int m = MIN(*buffer->length, buffer->buffer_length);
-            char *ptr = (char*)buffer->buffer;
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),"\t\tafter buffer->buffer: ");
-            for (j = 0; j < m; j++) {
-              PerlIO_printf(DBIc_LOGPIO(imp_xxh), "%c", *ptr++);
-            }
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),"\n");
-          }
-        }
-
-        /* This does look a lot like Georg's PHP driver doesn't it?  --Brian */
-        /* Credit due to Georg - mysqli_api.c  ;) --PMG */
-        switch (buffer->buffer_type) {
-        case MYSQL_TYPE_DOUBLE:
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tst_fetch double data %f\n", fbh->ddata);
-          sv_setnv(sv, fbh->ddata);
-          break;
-
-        case MYSQL_TYPE_LONG:
-        case MYSQL_TYPE_LONGLONG:
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tst_fetch int data %"IVdf", unsigned? %d\n",
-                          fbh->ldata, buffer->is_unsigned);
-          if (buffer->is_unsigned)
-            sv_setuv(sv, fbh->ldata);
-          else
-            sv_setiv(sv, fbh->ldata);
-
-          break;
-
-        case MYSQL_TYPE_BIT:
-          sv_setpvn(sv, fbh->data, fbh->length);
-
-          break;
+      if (rc == MYSQL_DATA_TRUNCATED) {
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tdbd_st_fetch data truncated\n");
+        goto process;
+      }
+#endif
 
-        default:
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tERROR IN st_fetch_string");
-          len= fbh->length;
-	  /* ChopBlanks server-side prepared statement */
-          if (ChopBlanks)
-          {
-            /* 
-              see bottom of:
-              http://www.mysql.org/doc/refman/5.0/en/c-api-datatypes.html
-            */
-            if (fbh->charsetnr != 63)
-              while (len && fbh->data[len-1] == ' ') { --len; }
-          }
-	  /* END OF ChopBlanks */
+      if (rc == MYSQL_NO_DATA)
+      {
+        /* Update row_num to affected_rows value */
+        imp_sth->row_num= mysql_stmt_affected_rows(imp_sth->stmt);
+        imp_sth->fetch_done=1;
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tdbd_st_fetch no data\n");
+      }
 
-          sv_setpvn(sv, fbh->data, len);
+      dbd_st_finish(sth, imp_sth);
 
-	/* UTF8 */
-        /*HELMUT*/
-#if defined(sv_utf8_decode) && MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
+      return Nullav;
+    }
 
-#if MYSQL_VERSION_ID >= FIELD_CHARSETNR_VERSION 
-  /* SHOW COLLATION WHERE Id = 63; -- 63 == charset binary, collation binary */
-        if ((imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4) && fbh->charsetnr != 63)
-#else
-	if ((imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4) && !(fbh->flags & BINARY_FLAG))
-#endif
-	  sv_utf8_decode(sv);
-#endif
-	/* END OF UTF8 */
-          break;
+process:
+    imp_sth->currow++;
 
-        }
+    num_fields=mysql_stmt_field_count(imp_sth->stmt);
+    av= row ? new_row_av(aTHX_ imp_sth, row, num_fields) :
+      DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth);
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "\t\tdbd_st_fetch called mysql_fetch, rc %d num_fields %d\n",
+                    rc, num_fields);
 
-      }
-    }
+    if (imp_sth->fbav_borrowed)
+      release_fbav(aTHX_ imp_sth, FALSE);
+    fetch_bind_kernels[FETCH_KERNEL_INDEX(ChopBlanks,
+                                          imp_dbh->enable_utf8 ||
+                                          imp_dbh->enable_utf8mb4,
+                                          DBIc_TRACE_LEVEL(imp_xxh) >= 2)]
+      (aTHX_ sth, imp_sth, av, num_fields);
 
     if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_fetch, %d cols\n", num_fields);
@@ -4291,24 +7452,30 @@ process:
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\timp_sth->result=%p\n", imp_sth->result);
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\tmysql_num_fields=%u\n",
                     mysql_num_fields(imp_sth->result));
+#ifdef HAVE_PREFETCH_ROWS
+      /* not while the prefetch thread uses them */
+      if (!imp_dbh->prefetch)
+#endif
+      {
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\tmysql_num_rows=%llu\n",
                     mysql_num_rows(imp_sth->result));
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\tmysql_affected_rows=%llu\n",
                     mysql_affected_rows(imp_dbh->pmysql));
+      }
       PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\tdbd_st_fetch for %p, currow= %d\n",
                     sth,imp_sth->currow);
     }
 
-    if (!(cols= mysql_fetch_row(imp_sth->result)))
+    if (!imp_sth->done_desc && !dbd_describe(sth, imp_sth))
+      return Nullav;
+
+    if (!(cols= sth_fetch_row(imp_sth, &lengths)))
     {
       if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
       {
         PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\tdbd_st_fetch, no more rows to fetch");
       }
-      if (mysql_errno(imp_dbh->pmysql))
-        do_error(sth, mysql_errno(imp_dbh->pmysql),
-                 mysql_error(imp_dbh->pmysql),
-                 mysql_sqlstate(imp_dbh->pmysql));
+      sth_fetch_error(sth, imp_sth, imp_dbh);
 
 
 #if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
@@ -4319,10 +7486,8 @@ process:
     }
 
     num_fields= mysql_num_fields(imp_sth->result);
-    fields= mysql_fetch_fields(imp_sth->result);
-    lengths= mysql_fetch_lengths(imp_sth->result);
 
-    if ((av= DBIc_FIELDS_AV(imp_sth)) != Nullav)
+    if (!row && (av= DBIc_FIELDS_AV(imp_sth)) != Nullav)
     {
       av_length= av_len(av)+1;
 
@@ -4356,81 +7521,368 @@ process:
       }
     }
 
-    av= DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth);
+    av= row ? new_row_av(aTHX_ imp_sth, row, num_fields) :
+      DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth);
+
+    /*
+      Rows of mysql_use_result are gone with the next one, and chopped
+      values would not end in a NUL
+    */
+    borrow= imp_sth->borrow_strings && !imp_sth->use_mysql_use_result &&
+      !imp_sth->compact && !ChopBlanks;
+    if (imp_sth->fbav_borrowed && !borrow)
+      release_fbav(aTHX_ imp_sth, FALSE);
+    if (borrow && !row)
+      imp_sth->fbav_borrowed= TRUE;
+    fetch_row_kernels[borrow ? 2 : ChopBlanks ? 1 : 0]
+      (aTHX_ imp_sth, av, cols, lengths, num_fields);
+
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_fetch, %d cols\n", num_fields);
+    return av;
+
+#if MYSQL_VERSION_ID  >= SERVER_PREPARE_VERSION
+  }
+#endif
+
+}
+
+/**************************************************************************
+ *
+ *  Name:    dbd_st_fetch
+ *
+ *  Purpose: Called for fetching a result row
+ *
+ *  Input:   sth - statement handle being initialized
+ *           imp_sth - drivers private statement handle data
+ *
+ *  Returns: array of columns; the array is allocated by DBI via
+ *           DBIc_DBISTATE(imp_sth)->get_fbav(imp_sth), even the values
+ *           of the array are prepared, we just need to modify them
+ *           appropriately
+ *
+ **************************************************************************/
+
+AV*
+dbd_st_fetch(SV *sth, imp_sth_t* imp_sth)
+{
+  return st_fetch_into(sth, imp_sth, NULL);
+}
+
+/**************************************************************************
+ *
+ *  Name:    mysql_st_fetchall_arrayref
+ *
+ *  Purpose: fetchall_arrayref without a method call and a copy of the
+ *           fetched array per row: each row is fetched into an array of
+ *           its own
+ *
+ *  Input:   sth - statement handle
+ *           imp_sth - drivers private statement handle data
+ *           columns - indexes of the columns to return, negative ones
+ *               counting from the end, or NULL for all of them
+ *           names - hash keys for these columns if the rows are to be
+ *               returned as hashes, NULL for arrays
+ *           max_rows - maximum number of rows to fetch, negative for
+ *               all of them
+ *
+ *  Returns: reference to the array of rows; undef if rows were
+ *           asked for by max_rows and the statement is not active,
+ *           as in DBI
+ *
+ **************************************************************************/
+
+SV *mysql_st_fetchall_arrayref(SV *sth, imp_sth_t *imp_sth, AV *columns,
+                               AV *names, IV max_rows)
+{
+  dTHX;
+  D_imp_xxh(sth);
+  AV *rows, *row;
+  I32 i, num_columns= columns ? av_len(columns) + 1 : 0;
+  IV *index= NULL;
+  SV **keys= NULL;
+
+  /* otherwise the fetch below reports fetching without execute() */
+  if (max_rows > 0 && !DBIc_ACTIVE(imp_sth))
+    return &PL_sv_undef;
+
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t-> mysql_st_fetchall_arrayref, %d columns\n",
+                  (int) num_columns);
+
+  rows= newAV();
+  if (max_rows > 0)
+    av_extend(rows, max_rows - 1);
+  if (columns)
+  {
+    Newz(908, index, num_columns ? num_columns : 1, IV);
+    for (i= 0; i < num_columns; i++)
+    {
+      SV **svp= av_fetch(columns, i, FALSE);
+      index[i]= svp && SvOK(*svp) ? SvIV(*svp) : -1 - DBIc_NUM_FIELDS(imp_sth);
+    }
+  }
+  if (names)
+  {
+    Newz(908, keys, num_columns ? num_columns : 1, SV *);
+    for (i= 0; i < num_columns; i++)
+    {
+      SV **svp= av_fetch(names, i, FALSE);
+      keys[i]= svp ? *svp : &PL_sv_undef;
+    }
+  }
+
+  while (max_rows < 0 || max_rows-- > 0)
+  {
+    row= newAV();
+    if (!st_fetch_into(sth, imp_sth, row))
+    {
+      SvREFCNT_dec(row);
+      break;
+    }
 
-    for (i= 0;  i < num_fields; ++i)
+    if (columns)
     {
-      char *col= cols[i];
-      SV *sv= AvARRAY(av)[i]; /* Note: we (re)use the SV in the AV	*/
+      /* Keep the wanted columns only, in the wanted order */
+      I32 num_fields= av_len(row) + 1;
+      SV **cols= AvARRAY(row);
+      SV *out;
 
-      if (col)
+      if (names)
+      {
+        HV *hv= newHV();
+        for (i= 0; i < num_columns; i++)
+        {
+          IV idx= index[i] < 0 ? index[i] + num_fields : index[i];
+          (void) hv_store_ent(hv, keys[i], idx >= 0 && idx < num_fields ?
+                              SvREFCNT_inc(cols[idx]) : newSV(0), 0);
+        }
+        out= (SV *) hv;
+      }
+      else
       {
-        STRLEN len= lengths[i];
-        if (ChopBlanks)
+        AV *av= newAV();
+        av_extend(av, num_columns - 1);
+        for (i= 0; i < num_columns; i++)
         {
-          while (len && col[len-1] == ' ')
-          {	--len; }
+          IV idx= index[i] < 0 ? index[i] + num_fields : index[i];
+          av_store(av, i, idx >= 0 && idx < num_fields ?
+                   SvREFCNT_inc(cols[idx]) : newSV(0));
         }
+        out= (SV *) av;
+      }
+      SvREFCNT_dec(row);
+      av_push(rows, newRV_noinc(out));
+    }
+    else
+      av_push(rows, newRV_noinc((SV *) row));
+  }
 
-        /* Set string value returned from mysql server */
-        sv_setpvn(sv, col, len);
+  Safefree(index);
+  Safefree(keys);
 
-        switch (mysql_to_perl_type(fields[i].type)) {
-        case MYSQL_TYPE_DOUBLE:
-          if (!(fields[i].flags & ZEROFILL_FLAG))
-          {
-            /* Coerce to dobule and set scalar as NV */
-            sv_setnv(sv, SvNV(sv));
-          }
-          break;
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t<- mysql_st_fetchall_arrayref, %d rows\n",
+                  (int) (av_len(rows) + 1));
+  return sv_2mortal(newRV_noinc((SV *) rows));
+}
 
-        case MYSQL_TYPE_LONG:
-        case MYSQL_TYPE_LONGLONG:
-          if (!(fields[i].flags & ZEROFILL_FLAG))
-          {
-            /* Coerce to integer and set scalar as UV resp. IV */
-            if (fields[i].flags & UNSIGNED_FLAG)
-            {
-              sv_setuv(sv, SvUV(sv));
-            }
-            else
-            {
-              sv_setiv(sv, SvIV(sv));
-            }
-          }
-          break;
+/*
+  Appends column i of a block of rows to its array, converted as planned
+  by dbd_describe
+*/
+static void append_column(pTHX_ AV *column, const imp_sth_conv_t *conv,
+                          int i, MYSQL_ROW *rows, unsigned long *lengths,
+                          int num_fields, int num_rows, int ChopBlanks)
+{
+  int r;
 
-#if MYSQL_VERSION_ID > NEW_DATATYPE_VERSION
-        case MYSQL_TYPE_BIT:
-          /* Let it as binary string */
-          break;
+  av_extend(column, av_len(column) + num_rows);
+  for (r= 0; r < num_rows; r++)
+  {
+    char *col= rows[r][i];
+    SV *sv= newSV(0);
+
+    if (col)
+    {
+      STRLEN len= lengths[r * num_fields + i];
+      if (ChopBlanks)
+        while (len && col[len-1] == ' ')
+          --len;
+      conv->convert(aTHX_ sv, col, len);
+    }
+    av_push(column, sv);
+  }
+}
+
+/**************************************************************************
+ *
+ *  Name:    mysql_st_fetch_columns
+ *
+ *  Purpose: Fetches the remaining rows as one array per column. Rows of
+ *           a stored result are converted FETCH_COLUMNS_BLOCK at a time,
+ *           column by column, straight from MYSQL_ROW. Server side
+ *           prepared statements are fetched row by row as usual and the
+ *           values moved to the columns.
+ *
+ *  Input:   sth - statement handle
+ *           imp_sth - drivers private statement handle data
+ *           as_hash - return a hash of the columns by FetchHashKeyName
+ *               rather than an array
+ *           max_rows - maximum number of rows to fetch, negative for
+ *               all of them
+ *
+ *  Returns: reference to the array or hash of columns, undef if the
+ *           statement is not active
+ *
+ **************************************************************************/
+
+SV *mysql_st_fetch_columns(SV *sth, imp_sth_t *imp_sth, bool as_hash,
+                           IV max_rows)
+{
+  dTHX;
+  D_imp_xxh(sth);
+  D_imp_dbh_from_sth;
+  AV **columns;
+  MYSQL_FIELD *fields;
+  SV *result;
+  int i, num_fields;
+
+  if (!DBIc_ACTIVE(imp_sth))
+    return &PL_sv_undef;
+
+#if MYSQL_ASYNC
+  if (imp_dbh->async_query_in_flight &&
+      mysql_db_async_result(sth, &imp_sth->result) <= 0)
+    return &PL_sv_undef;
 #endif
+  if (!imp_sth->result)
+  {
+    do_error(sth, JW_ERR_SEQUENCE, "fetch() without execute()" ,NULL);
+    return &PL_sv_undef;
+  }
 
-        default:
-	/* UTF8 */
-        /*HELMUT*/
-#if defined(sv_utf8_decode) && MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
+  num_fields= mysql_num_fields(imp_sth->result);
+  fields= mysql_fetch_fields(imp_sth->result);
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "\t-> mysql_st_fetch_columns, %d columns\n", num_fields);
+
+  Newz(908, columns, num_fields ? num_fields : 1, AV *);
+  for (i= 0; i < num_fields; i++)
+    columns[i]= newAV();
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (imp_sth->use_server_side_prepare)
+  {
+    AV *av;
+    while ((max_rows < 0 || max_rows-- > 0) &&
+           (av= st_fetch_into(sth, imp_sth, NULL)))
+      for (i= 0; i < num_fields; i++)
+        av_push(columns[i], newSVsv(AvARRAY(av)[i]));
+  }
+  else
+#endif
+  {
+    MYSQL_ROW cols, *rows;
+    unsigned long *lengths;
+    int num_rows, block=
+      imp_sth->use_mysql_use_result || imp_sth->compact ? 1 :
+      FETCH_COLUMNS_BLOCK;
+    int ChopBlanks= DBIc_is(imp_sth, DBIcf_ChopBlanks);
+    bool end= FALSE;
+
+    /* Rows of mysql_use_result are only valid until the next one */
+    New(908, rows, block, MYSQL_ROW);
+    New(908, lengths, block * (num_fields ? num_fields : 1), unsigned long);
+    if (!imp_sth->done_desc && !dbd_describe(sth, imp_sth))
+    {
+      Safefree(rows);
+      Safefree(lengths);
+      for (i= 0; i < num_fields; i++)
+        SvREFCNT_dec(columns[i]);
+      Safefree(columns);
+      return &PL_sv_undef;
+    }
 
-  /* see bottom of: http://www.mysql.org/doc/refman/5.0/en/c-api-datatypes.html */
-        if ((imp_dbh->enable_utf8 || imp_dbh->enable_utf8mb4) && fields[i].charsetnr != 63)
-	  sv_utf8_decode(sv);
+#ifdef HAVE_PREFETCH_ROWS
+    if (!prefetch_keeps_error(imp_sth))
 #endif
-	/* END OF UTF8 */
+    imp_dbh->pmysql->net.last_errno = 0;
+    while (!end && max_rows)
+    {
+      for (num_rows= 0; num_rows < block && max_rows; num_rows++)
+      {
+        unsigned long *row_lengths;
+
+        if (!(cols= sth_fetch_row(imp_sth, &row_lengths)))
+        {
+          end= TRUE;
           break;
         }
+        rows[num_rows]= cols;
+        Copy(row_lengths, lengths + num_rows * num_fields, num_fields,
+             unsigned long);
+        imp_sth->currow++;
+        ++DBIc_ROW_COUNT(imp_sth);
+        if (max_rows > 0)
+          max_rows--;
       }
-      else
-        (void) SvOK_off(sv);  /*  Field is NULL, return undef  */
+      for (i= 0; i < num_fields; i++)
+        append_column(aTHX_ columns[i], imp_sth->conv + i, i, rows, lengths,
+                      num_fields, num_rows, ChopBlanks);
     }
+    Safefree(rows);
+    Safefree(lengths);
 
-    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-      PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- dbd_st_fetch, %d cols\n", num_fields);
-    return av;
+    /* as in dbd_st_fetch, after the last row */
+    if (end)
+    {
+      sth_fetch_error(sth, imp_sth, imp_dbh);
+#if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
+      if (!mysql_more_results(imp_dbh->pmysql))
+#endif
+        dbd_st_finish(sth, imp_sth);
+    }
+  }
 
-#if MYSQL_VERSION_ID  >= SERVER_PREPARE_VERSION
+  if (as_hash)
+  {
+    HV *hv= newHV();
+    SV **svp= hv_fetch((HV*) SvRV(sth), "FetchHashKeyName", 16, FALSE);
+    const char *key_name= svp && SvOK(*svp) ? SvPV_nolen(*svp) : "NAME";
+
+    for (i= 0; i < num_fields; i++)
+    {
+      SV *name= newSVpvn(fields[i].name, strlen(fields[i].name));
+      char *p= SvPVX(name), *end= p + SvCUR(name);
+
+      if (strEQ(key_name, "NAME_lc"))
+        for (; p < end; p++)
+          *p= toLOWER(*p);
+      else if (strEQ(key_name, "NAME_uc"))
+        for (; p < end; p++)
+          *p= toUPPER(*p);
+      (void) hv_store_ent(hv, name, newRV_noinc((SV *) columns[i]), 0);
+      SvREFCNT_dec(name);
+    }
+    result= (SV *) hv;
   }
-#endif
+  else
+  {
+    AV *av= newAV();
+    av_extend(av, num_fields - 1);
+    for (i= 0; i < num_fields; i++)
+      av_push(av, newRV_noinc((SV *) columns[i]));
+    result= (SV *) av;
+  }
+  Safefree(columns);
 
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t<- mysql_st_fetch_columns\n");
+  return sv_2mortal(newRV_noinc(result));
 }
 
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
@@ -4472,6 +7924,8 @@ int dbd_st_finish(SV* sth, imp_sth_t* imp_sth) {
   dTHR;
 #endif
 
+  PREFETCH_STOP_STH(imp_sth);
+
 #if MYSQL_ASYNC
   D_imp_dbh_from_sth;
   if(imp_dbh->async_query_in_flight) {
@@ -4512,6 +7966,8 @@ int dbd_st_finish(SV* sth, imp_sth_t* imp_sth) {
     */
     mysql_st_free_result_sets(sth, imp_sth);
   }
+  if (imp_sth->fbav_borrowed)
+    release_fbav(aTHX_ imp_sth, TRUE);
   DBIc_ACTIVE_off(imp_sth);
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
   {
@@ -4542,11 +7998,13 @@ void dbd_st_destroy(SV *sth, imp_sth_t *imp_sth) {
   dTHR;
 #endif
 
-  int i;
-
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  imp_sth_fbh_t *fbh;
   int n;
+#endif
+
+  PREFETCH_STOP_STH(imp_sth);
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
 
   n= DBIc_NUM_PARAMS(imp_sth);
   if (n)
@@ -4556,29 +8014,17 @@ void dbd_st_destroy(SV *sth, imp_sth_t *imp_sth) {
           n, imp_sth->bind, imp_sth->fbind);
 
     free_bind(imp_sth->bind);
-    free_fbind(imp_sth->fbind);
+    free_fbind(imp_sth->fbind, n);
   }
 
-  fbh= imp_sth->fbh;
-  if (fbh)
-  {
-    n = DBIc_NUM_FIELDS(imp_sth);
-    i = 0;
-    while (i < n)
-    {
-      if (fbh[i].data) Safefree(fbh[i].data);
-      ++i;
-    }
-
-    free_fbuffer(fbh);
-    if (imp_sth->buffer)
-      free_bind(imp_sth->buffer);
-  }
+  free_result_buffers(imp_sth);
 
-  if (imp_sth->stmt)
+  /* Hand the statement back to the cache, or close it */
+  imp_sth->stmt_cache_entry.stmt= imp_sth->stmt;
+  imp_sth->stmt= NULL;
   {
-    mysql_stmt_close(imp_sth->stmt);
-    imp_sth->stmt= NULL;
+    D_imp_dbh_from_sth;
+    mysql_db_stmt_cache_store(aTHX_ imp_dbh, &imp_sth->stmt_cache_entry);
   }
 #endif
 
@@ -4591,14 +8037,37 @@ void dbd_st_destroy(SV *sth, imp_sth_t *imp_sth) {
     free_param(aTHX_ imp_sth->params, DBIc_NUM_PARAMS(imp_sth));
     imp_sth->params= NULL;
   }
+  free_params_tmpl(imp_sth->params_tmpl);
+  imp_sth->params_tmpl= NULL;
+  free_query_buf(&imp_sth->query_buf, &imp_sth->query_buf_size, FALSE);
 
-  /* Free cached array attributes */
-  for (i= 0; i < AV_ATTRIB_LAST; i++)
+#ifdef HAVE_PREFETCH_ROWS
+  /* The thread must not outlive the statement */
+  if (imp_sth->prefetch)
   {
-    if (imp_sth->av_attr[i])
-      SvREFCNT_dec(imp_sth->av_attr[i]);
-    imp_sth->av_attr[i]= Nullav;
+    D_imp_dbh_from_sth;
+    prefetch_free(imp_sth, imp_dbh);
+  }
+#endif
+
+  /* Free the conversion of the columns made by dbd_describe */
+  if (imp_sth->conv)
+  {
+    Safefree(imp_sth->conv);
+    imp_sth->conv= NULL;
+    imp_sth->num_conv= 0;
+  }
+
+  free_result_fields(imp_sth);
+
+  if (imp_sth->compact)
+  {
+    compact_result_free(imp_sth->compact);
+    imp_sth->compact= NULL;
   }
+
+  /* Free cached array attributes */
+  free_av_attr(aTHX_ imp_sth, TRUE);
   /* let DBI know we've done it   */
   DBIc_IMPSET_off(imp_sth);
 }
@@ -4642,8 +8111,52 @@ dbd_st_STORE_attrib(
 
   if (strEQ(key, "mysql_use_result"))
   {
-    imp_sth->use_mysql_use_result= SvTRUE(valuesv);
+    imp_sth->use_mysql_use_result= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_borrow_strings"))
+  {
+    imp_sth->borrow_strings= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_compact_result"))
+  {
+    imp_sth->compact_result= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_result_spill_bytes"))
+  {
+    imp_sth->result_spill_bytes= SvUV(valuesv);
+  }
+  else if (strEQ(key, "mysql_bind_by_reference"))
+  {
+    imp_sth->bind_by_reference= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_prefetch_rows"))
+  {
+    imp_sth->prefetch_rows= SvIV(valuesv);
+  }
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  else if (strEQ(key, "mysql_bind_native_types"))
+  {
+    imp_sth->bind_native_types= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_server_cursor"))
+  {
+    imp_sth->server_cursor= SvTRUE(valuesv);
+  }
+  else if (strEQ(key, "mysql_defer_blobs"))
+  {
+    imp_sth->defer_blobs= SvTRUE(valuesv);
   }
+  else if (strEQ(key, "mysql_cursor_prefetch_rows"))
+  {
+    imp_sth->cursor_prefetch_rows= SvIV(valuesv) > 0 ?
+      (unsigned long) SvIV(valuesv) : 0;
+  }
+  else if (strEQ(key, "mysql_adaptive_buffer_limit"))
+  {
+    imp_sth->adaptive_buffer_limit= SvIV(valuesv) > 0 ?
+      (unsigned long) SvIV(valuesv) : 0;
+  }
+#endif
 
   if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
     PerlIO_printf(DBIc_LOGPIO(imp_xxh),
@@ -4931,9 +8444,29 @@ dbd_st_FETCH_internal(
       else if (strEQ(key, "mysql_use_result"))
         retsv= boolSV(imp_sth->use_mysql_use_result);
       break;
+    case 17:
+      if (strEQ(key, "mysql_defer_blobs"))
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+        retsv= boolSV(imp_sth->defer_blobs);
+#else
+        retsv= boolSV(0);
+#endif
+      break;
     case 19:
       if (strEQ(key, "mysql_warning_count"))
         retsv= sv_2mortal(newSViv((IV) imp_sth->warning_count));
+      else if (strEQ(key, "mysql_prefetch_rows"))
+        retsv= sv_2mortal(newSViv(imp_sth->prefetch_rows));
+      else if (strEQ(key, "mysql_result_memory"))
+        retsv= imp_sth->compact ?
+          sv_2mortal(newSVuv((UV) compact_result_memory(imp_sth->compact))) :
+          &PL_sv_undef;
+      else if (strEQ(key, "mysql_server_cursor"))
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+        retsv= boolSV(imp_sth->server_cursor);
+#else
+        retsv= boolSV(0);
+#endif
       break;
     case 20:
       if (strEQ(key, "mysql_server_prepare"))
@@ -4942,10 +8475,46 @@ dbd_st_FETCH_internal(
 #else
         retsv= boolSV(0);
 #endif
+      else if (strEQ(key, "mysql_borrow_strings"))
+        retsv= boolSV(imp_sth->borrow_strings);
+      else if (strEQ(key, "mysql_compact_result"))
+        retsv= boolSV(imp_sth->compact_result);
+      else if (strEQ(key, "mysql_result_spilled"))
+        retsv= imp_sth->compact ?
+          sv_2mortal(newSVuv((UV) compact_result_spilled(imp_sth->compact))) :
+          &PL_sv_undef;
       break;
     case 23:
       if (strEQ(key, "mysql_is_auto_increment"))
         retsv = ST_FETCH_AV(AV_ATTRIB_IS_AUTO_INCREMENT);
+      else if (strEQ(key, "mysql_bind_native_types"))
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+        retsv= boolSV(imp_sth->bind_native_types);
+#else
+        retsv= boolSV(0);
+#endif
+      else if (strEQ(key, "mysql_bind_by_reference"))
+        retsv= boolSV(imp_sth->bind_by_reference);
+      break;
+    case 24:
+      if (strEQ(key, "mysql_result_spill_bytes"))
+        retsv= sv_2mortal(newSVuv(imp_sth->result_spill_bytes));
+      break;
+    case 26:
+      if (strEQ(key, "mysql_cursor_prefetch_rows"))
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+        retsv= sv_2mortal(newSVuv(imp_sth->cursor_prefetch_rows));
+#else
+        retsv= sv_2mortal(newSViv(0));
+#endif
+      break;
+    case 27:
+      if (strEQ(key, "mysql_adaptive_buffer_limit"))
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+        retsv= sv_2mortal(newSVuv(imp_sth->adaptive_buffer_limit));
+#else
+        retsv= sv_2mortal(newSViv(0));
+#endif
       break;
     case 37:
       if (strEQ(key, "mysql_server_prepare_disable_fallback"))
@@ -4966,20 +8535,25 @@ dbd_st_FETCH_internal(
  *
  *  Name:    dbd_st_blob_read
  *
- *  Purpose: Used for blob reads if the statement handles "LongTruncOk"
- *           attribute (currently not supported by DBD::mysql)
+ *  Purpose: Reads a part of a column of the current row, so that long
+ *           BLOB/TEXT values can be read in chunks. With server side
+ *           prepared statements the chunk is copied from the row by
+ *           mysql_stmt_fetch_column, this is how columns deferred by
+ *           mysql_defer_blobs are read.
  *
  *  Input:   SV* - statement handle from which a blob will be fetched
  *           imp_sth - drivers private statement handle data
- *           field - field number of the blob (note, that a row may
- *               contain more than one blob)
+ *           field - field number of the blob, counting starts with 0
+ *               (note, that a row may contain more than one blob)
  *           offset - the offset of the field, where to start reading
  *           len - maximum number of bytes to read
  *           destrv - RV* that tells us where to store
  *           destoffset - destination offset
  *
  *  Returns: TRUE for success, FALSE otherwise; do_error will
- *           be called in the latter case
+ *           be called in the latter case, but not if the value is NULL
+ *           or offset is at its end, which is how blob_copy_to_file
+ *           of DBI knows it is done
  *
  **************************************************************************/
 
@@ -4992,16 +8566,296 @@ int dbd_st_blob_read (
   SV *destrv,
   long destoffset)
 {
-    /* quell warnings */
-    sth= sth;
-    imp_sth=imp_sth;
-    field= field;
-    offset= offset;
-    len= len;
-    destrv= destrv;
-    destoffset= destoffset;
+  dTHX;
+  SV *dest;
+  STRLEN cur;
+  unsigned long total, copied;
+  char *buf;
+
+  if (field < 0 || field >= DBIc_NUM_FIELDS(imp_sth) ||
+      offset < 0 || len < 0 || destoffset < 0)
+  {
+    do_error(sth, JW_ERR_ILLEGAL_PARAM_NUM,
+             "blob_read: field, offset or length out of range", NULL);
+    return FALSE;
+  }
+  if (!DBIc_ACTIVE(imp_sth) || !imp_sth->currow)
+  {
+    do_error(sth, JW_ERR_SEQUENCE, "blob_read() without fetch()", NULL);
+    return FALSE;
+  }
+
+  if (DBIc_TRACE_LEVEL(imp_sth) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_sth),
+                  "\t-> dbd_st_blob_read field %d offset %ld len %ld\n",
+                  field, offset, len);
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (imp_sth->use_server_side_prepare)
+  {
+    imp_sth_fbh_t *fbh= imp_sth->fbh + field;
+
+    if (fbh->is_null)
+      return FALSE;
+    switch (imp_sth->buffer[field].buffer_type) {
+    case MYSQL_TYPE_DOUBLE:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+      do_error(sth, JW_ERR_NOT_IMPLEMENTED,
+               "blob_read: not a string column", NULL);
+      return FALSE;
+    default:
+      break;
+    }
+    total= fbh->length;
+  }
+  else
+#endif
+  {
+    if (!imp_sth->current_row || !imp_sth->current_row[field])
+      return FALSE;
+    total= imp_sth->current_lengths[field];
+  }
+
+  if ((unsigned long) offset >= total)
     return FALSE;
+  copied= total - offset;
+  if (copied > (unsigned long) len)
+    copied= len;
+
+  /* the chunk goes straight into the destination string */
+  dest= SvRV(destrv);
+  if (!SvOK(dest))
+    sv_setpvn(dest, "", 0);
+  (void) SvPVbyte_force(dest, cur);
+  buf= SvGROW(dest, (STRLEN) destoffset + copied + 1);
+  if (cur < (STRLEN) destoffset)
+    Zero(buf + cur, destoffset - cur, char);
+  buf+= destoffset;
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  if (imp_sth->use_server_side_prepare)
+  {
+    if (copied)
+    {
+      MYSQL_BIND chunk;
+      unsigned long length;
+      bool is_null, error;
+
+      Zero(&chunk, 1, MYSQL_BIND);
+      chunk.buffer_type= MYSQL_TYPE_BLOB;
+      chunk.buffer= buf;
+      chunk.buffer_length= copied;
+      chunk.length= &length;
+      chunk.is_null= (my_bool*) &is_null;
+      chunk.error= (my_bool*) &error;
+      if (mysql_stmt_fetch_column(imp_sth->stmt, &chunk, field, offset))
+      {
+        do_error(sth, mysql_stmt_errno(imp_sth->stmt),
+                 mysql_stmt_error(imp_sth->stmt),
+                 mysql_stmt_sqlstate(imp_sth->stmt));
+        return FALSE;
+      }
+    }
+  }
+  else
+#endif
+    Copy(imp_sth->current_row[field] + offset, buf, copied, char);
+
+  SvCUR_set(dest, destoffset + copied);
+  *SvEND(dest)= '\0';
+  SvPOK_only(dest);
+  SvSETMAGIC(dest);
+  return TRUE;
+}
+
+
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/*
+  Sets up the MYSQL_BIND of a parameter of a server side prepared
+  statement for the value held in imp_sth->params
+*/
+static void bind_server_param(pTHX_ SV *sth, imp_sth_t *imp_sth, int idx,
+                              IV sql_type)
+{
+  D_imp_xxh(sth);
+  STRLEN slen;
+  char *buffer= NULL;
+  int buffer_is_null= 0;
+  int buffer_is_unsigned= 0;
+  int buffer_length= 0;
+  unsigned int buffer_type= 0;
+
+  switch(sql_type) {
+  case SQL_NUMERIC:
+  case SQL_INTEGER:
+  case SQL_SMALLINT:
+  case SQL_TINYINT:
+#if IVSIZE >= 8
+  case SQL_BIGINT:
+      buffer_type= MYSQL_TYPE_LONGLONG;
+#else
+      buffer_type= MYSQL_TYPE_LONG;
+#endif
+      break;
+  case SQL_DOUBLE:
+  case SQL_DECIMAL: 
+  case SQL_FLOAT: 
+  case SQL_REAL:
+      buffer_type= MYSQL_TYPE_DOUBLE;
+      break;
+  case SQL_CHAR: 
+  case SQL_VARCHAR: 
+  case SQL_DATE: 
+  case SQL_TIME: 
+  case SQL_TIMESTAMP: 
+  case SQL_LONGVARCHAR: 
+  case SQL_BINARY: 
+  case SQL_VARBINARY: 
+  case SQL_LONGVARBINARY:
+      buffer_type= MYSQL_TYPE_BLOB;
+      break;
+  default:
+      buffer_type= MYSQL_TYPE_STRING;
+      /*
+        Without an SQL type, numbers which have never been used as
+        strings are passed to the server as numbers, if asked to
+      */
+      if (!sql_type && imp_sth->bind_native_types &&
+          imp_sth->params[idx].value &&
+          !SvPOK(imp_sth->params[idx].value))
+      {
+        if (SvIOK(imp_sth->params[idx].value))
+#if IVSIZE >= 8
+          buffer_type= MYSQL_TYPE_LONGLONG;
+#else
+          buffer_type= MYSQL_TYPE_LONG;
+#endif
+        else if (SvNOK(imp_sth->params[idx].value))
+          buffer_type= MYSQL_TYPE_DOUBLE;
+      }
+  }
+  buffer_is_null = !(SvOK(imp_sth->params[idx].value) && imp_sth->params[idx].value);
+  if (ph_long_data(&imp_sth->params[idx]))
+  {
+    /* The value is sent by send_long_data() when executed */
+    buffer_type= MYSQL_TYPE_BLOB;
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "   SCALAR type %"IVdf" IS LONG DATA\n", sql_type);
+  }
+  else if (! buffer_is_null) {
+    switch(buffer_type) {
+      case MYSQL_TYPE_LONG:
+      case MYSQL_TYPE_LONGLONG:
+        /* INT */
+        if (!SvIOK(imp_sth->params[idx].value) && DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tTRY TO BIND AN INT NUMBER\n");
+        buffer_length = sizeof imp_sth->fbind[idx].numeric_val.lval;
+        imp_sth->fbind[idx].numeric_val.lval= SvIV(imp_sth->params[idx].value);
+        buffer=(void*)&(imp_sth->fbind[idx].numeric_val.lval);
+        if (!SvIOK(imp_sth->params[idx].value))
+        {
+          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                          "   Conversion to INT NUMBER was not successful -> '%s' --> (unsigned) '%"UVuf"' / (signed) '%"IVdf"' <- fallback to STRING\n",
+                          SvPV_nolen(imp_sth->params[idx].value), imp_sth->fbind[idx].numeric_val.lval, imp_sth->fbind[idx].numeric_val.lval);
+          buffer_type = MYSQL_TYPE_STRING;
+          break;
+        }
+        if (SvIsUV(imp_sth->params[idx].value))
+          buffer_is_unsigned= 1;
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                        "   SCALAR type %"IVdf" ->%"IVdf"<- IS A INT NUMBER\n",
+                        sql_type, *(IV *)buffer);
+        break;
+
+      case MYSQL_TYPE_DOUBLE:
+        if (!SvNOK(imp_sth->params[idx].value) && DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tTRY TO BIND A FLOAT NUMBER\n");
+        buffer_length = sizeof imp_sth->fbind[idx].numeric_val.dval;
+        imp_sth->fbind[idx].numeric_val.dval= SvNV(imp_sth->params[idx].value);
+        buffer=(char*)&(imp_sth->fbind[idx].numeric_val.dval);
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                        "   SCALAR type %"IVdf" ->%f<- IS A FLOAT NUMBER\n",
+                        sql_type, (double)(*buffer));
+        break;
+
+      case MYSQL_TYPE_BLOB:
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                        "   SCALAR type BLOB\n");
+        break;
+
+      case MYSQL_TYPE_STRING:
+        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                        "   SCALAR type STRING %"IVdf", buffertype=%d\n", sql_type, buffer_type);
+        break;
+
+      default:
+        croak("Bug in DBD::Mysql file dbdimp.c#dbd_bind_ph: do not know how to handle unknown buffer type.");
+    }
+
+    if (buffer_type == MYSQL_TYPE_STRING || buffer_type == MYSQL_TYPE_BLOB)
+    {
+      buffer= SvPV(imp_sth->params[idx].value, slen);
+      /* the variable bound by reference is read as it is */
+      if (!imp_sth->params[idx].by_ref)
+      {
+        char *value= buffer;
+
+        buffer= param_buffer(imp_sth->fbind + idx, slen);
+        Copy(value, buffer, slen, char);
+      }
+      buffer_length= slen;
+      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                      " SCALAR type %"IVdf" ->length %d<- IS A STRING or BLOB\n",
+                      sql_type, buffer_length);
+    }
+  }
+  else
+  {
+    /*
+      case: buffer_is_null != 0
+      Only is_null is looked at, so the buffer of the last value is kept
+      rather than binding the parameter again
+    */
+    buffer_type= imp_sth->bind[idx].buffer_type;
+    buffer= imp_sth->bind[idx].buffer;
+    buffer_length= imp_sth->bind[idx].buffer_length;
+    buffer_is_unsigned= imp_sth->bind[idx].is_unsigned;
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+      PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                    "   SCALAR NULL VALUE: buffer type is: %d\n", buffer_type);
+  }
+
+  /*
+    Type of column or buffer was changed. Force to rebind; otherwise the
+    library reads the new value through the pointers it has already
+  */
+  if (imp_sth->bind[idx].buffer_type != buffer_type ||
+      imp_sth->bind[idx].is_unsigned != buffer_is_unsigned ||
+      imp_sth->bind[idx].buffer != buffer) {
+    if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                      "   FORCE REBIND: buffer type changed from %d to %d, sql-type=%"IVdf"\n",
+                      (int) imp_sth->bind[idx].buffer_type, buffer_type, sql_type);
+    imp_sth->has_been_bound = 0;
+  }
+
+  imp_sth->bind[idx].buffer_type= buffer_type;
+  imp_sth->bind[idx].buffer= buffer;
+  imp_sth->bind[idx].buffer_length= buffer_length;
+  imp_sth->bind[idx].is_unsigned= buffer_is_unsigned;
+
+  imp_sth->fbind[idx].length= buffer_length;
+  imp_sth->fbind[idx].is_null= buffer_is_null;
 }
+#endif
 
 
 /***************************************************************************
@@ -5032,17 +8886,8 @@ int dbd_bind_ph(SV *sth, imp_sth_t *imp_sth, SV *param, SV *value,
   int param_num= SvIV(param);
   int idx= param_num - 1;
   char *err_msg;
+  SV **svp;
   D_imp_xxh(sth);
-
-#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  STRLEN slen;
-  char *buffer= NULL;
-  int buffer_is_null= 0;
-  int buffer_is_unsigned= 0;
-  int buffer_length= 0;
-  unsigned int buffer_type= 0;
-#endif
-
   D_imp_dbh_from_sth;
   ASYNC_CHECK_RETURN(sth, FALSE);
 
@@ -5050,7 +8895,6 @@ int dbd_bind_ph(SV *sth, imp_sth_t *imp_sth, SV *param, SV *value,
     PerlIO_printf(DBIc_LOGPIO(imp_xxh),
                   "   Called: dbd_bind_ph\n");
 
-  attribs= attribs;
   maxlen= maxlen;
 
   if (param_num <= 0  ||  param_num > DBIc_NUM_PARAMS(imp_sth))
@@ -5059,6 +8903,12 @@ int dbd_bind_ph(SV *sth, imp_sth_t *imp_sth, SV *param, SV *value,
     return FALSE;
   }
 
+  /* Like the SQL type, this sticks until bound again with the attribute */
+  svp= DBD_ATTRIB_GET_SVP(attribs, "mysql_long_data", 15);
+  if (svp)
+    imp_sth->params[idx].long_data= SvTRUE(*svp);
+  imp_sth->params[idx].by_ref= imp_sth->bind_by_reference;
+
   /*
      This fixes the bug whereby no warning was issued upon binding a
      defined non-numeric as numeric
@@ -5090,141 +8940,80 @@ int dbd_bind_ph(SV *sth, imp_sth_t *imp_sth, SV *param, SV *value,
   rc = bind_param(&imp_sth->params[idx], value, sql_type);
 
 #if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
-  if (imp_sth->use_server_side_prepare)
-  {
-      switch(sql_type) {
-      case SQL_NUMERIC:
-      case SQL_INTEGER:
-      case SQL_SMALLINT:
-      case SQL_TINYINT:
-#if IVSIZE >= 8
-      case SQL_BIGINT:
-          buffer_type= MYSQL_TYPE_LONGLONG;
-#else
-          buffer_type= MYSQL_TYPE_LONG;
+  /* Values bound by reference are bound when the statement is executed */
+  if (imp_sth->use_server_side_prepare && !imp_sth->params[idx].by_ref)
+    bind_server_param(aTHX_ sth, imp_sth, idx, sql_type);
 #endif
-          break;
-      case SQL_DOUBLE:
-      case SQL_DECIMAL: 
-      case SQL_FLOAT: 
-      case SQL_REAL:
-          buffer_type= MYSQL_TYPE_DOUBLE;
-          break;
-      case SQL_CHAR: 
-      case SQL_VARCHAR: 
-      case SQL_DATE: 
-      case SQL_TIME: 
-      case SQL_TIMESTAMP: 
-      case SQL_LONGVARCHAR: 
-      case SQL_BINARY: 
-      case SQL_VARBINARY: 
-      case SQL_LONGVARBINARY:
-          buffer_type= MYSQL_TYPE_BLOB;
-          break;
-      default:
-          buffer_type= MYSQL_TYPE_STRING;
-    }
-    buffer_is_null = !(SvOK(imp_sth->params[idx].value) && imp_sth->params[idx].value);
-    if (! buffer_is_null) {
-      switch(buffer_type) {
-        case MYSQL_TYPE_LONG:
-        case MYSQL_TYPE_LONGLONG:
-          /* INT */
-          if (!SvIOK(imp_sth->params[idx].value) && DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tTRY TO BIND AN INT NUMBER\n");
-          buffer_length = sizeof imp_sth->fbind[idx].numeric_val.lval;
-          imp_sth->fbind[idx].numeric_val.lval= SvIV(imp_sth->params[idx].value);
-          buffer=(void*)&(imp_sth->fbind[idx].numeric_val.lval);
-          if (!SvIOK(imp_sth->params[idx].value))
-          {
-            if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-              PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                            "   Conversion to INT NUMBER was not successful -> '%s' --> (unsigned) '%"UVuf"' / (signed) '%"IVdf"' <- fallback to STRING\n",
-                            SvPV_nolen(imp_sth->params[idx].value), imp_sth->fbind[idx].numeric_val.lval, imp_sth->fbind[idx].numeric_val.lval);
-            buffer_type = MYSQL_TYPE_STRING;
-            break;
-          }
-          if (SvIsUV(imp_sth->params[idx].value))
-            buffer_is_unsigned= 1;
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                          "   SCALAR type %"IVdf" ->%"IVdf"<- IS A INT NUMBER\n",
-                          sql_type, *(IV *)buffer);
-          break;
+  return rc;
+}
 
-        case MYSQL_TYPE_DOUBLE:
-          if (!SvNOK(imp_sth->params[idx].value) && DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh), "\t\tTRY TO BIND A FLOAT NUMBER\n");
-          buffer_length = sizeof imp_sth->fbind[idx].numeric_val.dval;
-          imp_sth->fbind[idx].numeric_val.dval= SvNV(imp_sth->params[idx].value);
-          buffer=(char*)&(imp_sth->fbind[idx].numeric_val.dval);
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                          "   SCALAR type %"IVdf" ->%f<- IS A FLOAT NUMBER\n",
-                          sql_type, (double)(*buffer));
-          break;
 
-        case MYSQL_TYPE_BLOB:
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                          "   SCALAR type BLOB\n");
-          break;
+/***************************************************************************
+ *
+ *  Name:    mysql_st_bind_values
+ *
+ *  Purpose: Binds the values passed to execute, all at once: the driver
+ *           version of the dbd_bind_ph call DBI makes for each of them.
+ *           There are no SQL types or attributes to look at, and the
+ *           copy of the last value is reused where possible.
+ *
+ *  Input:   sth - statement handle
+ *           imp_sth - drivers private statement handle data
+ *           values - the values, for parameters 1 to num_values
+ *           num_values - number of values
+ *
+ *  Returns: TRUE for success, FALSE otherwise
+ *
+ **************************************************************************/
 
-        case MYSQL_TYPE_STRING:
-          if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-            PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                          "   SCALAR type STRING %"IVdf", buffertype=%d\n", sql_type, buffer_type);
-          break;
+int mysql_st_bind_values(SV *sth, imp_sth_t *imp_sth, SV **values,
+                         int num_values)
+{
+  dTHX;
+  int i;
+  D_imp_xxh(sth);
+  D_imp_dbh_from_sth;
+  ASYNC_CHECK_RETURN(sth, FALSE);
 
-        default:
-          croak("Bug in DBD::Mysql file dbdimp.c#dbd_bind_ph: do not know how to handle unknown buffer type.");
-      }
+  if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
+    PerlIO_printf(DBIc_LOGPIO(imp_xxh),
+                  "   Called: mysql_st_bind_values with %d values\n",
+                  num_values);
 
-      if (buffer_type == MYSQL_TYPE_STRING || buffer_type == MYSQL_TYPE_BLOB)
-      {
-        buffer= SvPV(imp_sth->params[idx].value, slen);
-        buffer_length= slen;
-        if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                        " SCALAR type %"IVdf" ->length %d<- IS A STRING or BLOB\n",
-                        sql_type, buffer_length);
-      }
-    }
-    else
-    {
-      /*case: buffer_is_null != 0*/
-      buffer= NULL;
-      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-        PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                      "   SCALAR NULL VALUE: buffer type is: %d\n", buffer_type);
-    }
+  if (num_values != DBIc_NUM_PARAMS(imp_sth))
+  {
+    do_error(sth, JW_ERR_ILLEGAL_PARAM_NUM,
+             SvPVX(sv_2mortal(newSVpvf(
+                 "called with %d bind variables when %d are needed",
+                 num_values, (int) DBIc_NUM_PARAMS(imp_sth)))), NULL);
+    return FALSE;
+  }
 
-    /* Type of column was changed. Force to rebind */
-    if (imp_sth->bind[idx].buffer_type != buffer_type || imp_sth->bind[idx].is_unsigned != buffer_is_unsigned) {
-      if (DBIc_TRACE_LEVEL(imp_xxh) >= 2)
-          PerlIO_printf(DBIc_LOGPIO(imp_xxh),
-                        "   FORCE REBIND: buffer type changed from %d to %d, sql-type=%"IVdf"\n",
-                        (int) imp_sth->bind[idx].buffer_type, buffer_type, sql_type);
-      imp_sth->has_been_bound = 0;
-    }
+  for (i= 0; i < num_values; i++)
+  {
+    imp_sth_ph_t *ph= imp_sth->params + i;
+    SV *value= values[i];
 
-    /* prepare has been called */
-    if (imp_sth->has_been_bound)
-    {
-      imp_sth->stmt->params[idx].buffer= buffer;
-      imp_sth->stmt->params[idx].buffer_length= buffer_length;
-    }
+    SvGETMAGIC(value);
+    ph->by_ref= imp_sth->bind_by_reference;
 
-    imp_sth->bind[idx].buffer_type= buffer_type;
-    imp_sth->bind[idx].buffer= buffer;
-    imp_sth->bind[idx].buffer_length= buffer_length;
-    imp_sth->bind[idx].is_unsigned= buffer_is_unsigned;
+    /*
+      The copy made for the last execute is only ours if nothing else
+      holds it; long data and values bound by reference are not copied
+    */
+    if (ph->value && SvREFCNT(ph->value) == 1 && !ph->by_ref &&
+        !ph->long_data && !SvMAGICAL(ph->value) && !SvREADONLY(ph->value) &&
+        !SvROK(ph->value) && !isGV(ph->value) && !long_data_source(value))
+      sv_setsv_nomg(ph->value, value);
+    else
+      bind_param(ph, value, 0);
 
-    imp_sth->fbind[idx].length= buffer_length;
-    imp_sth->fbind[idx].is_null= buffer_is_null;
-  }
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+    if (imp_sth->use_server_side_prepare && !ph->by_ref)
+      bind_server_param(aTHX_ sth, imp_sth, i, 0);
 #endif
-  return rc;
+  }
+  return TRUE;
 }
 
 
@@ -5274,6 +9063,12 @@ int mysql_db_reconnect(SV* h)
    * fail.  Think server is down & reconnect fails but the application eval{}s
    * the execute, so next time $dbh->quote() gets called, instant SIGSEGV!
    */
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+  /* Cached statements are gone with the old connection */
+  mysql_db_stmt_cache_flush(aTHX_ imp_dbh);
+#endif
+  imp_dbh->max_allowed_packet= 0;
+
   save_socket= *(imp_dbh->pmysql);
   memcpy (&save_socket, imp_dbh->pmysql,sizeof(save_socket));
   memset (imp_dbh->pmysql,0,sizeof(*(imp_dbh->pmysql)));
@@ -5295,6 +9090,10 @@ int mysql_db_reconnect(SV* h)
    *  Tell DBI, that dbh->disconnect should be called for this handle
    */
   DBIc_ACTIVE_on(imp_dbh);
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+  /* The handler was registered with the old connection */
+  set_local_infile_handler(imp_dbh);
+#endif
 
   ++imp_dbh->stats.auto_reconnects_ok;
   return TRUE;
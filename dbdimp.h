@@ -42,12 +42,14 @@
 #define WARNING_COUNT_VERSION 40101
 #define FIELD_CHARSETNR_VERSION 40101 /* should equivalent to 4.1.0  */
 #define MULTIPLE_RESULT_SET_VERSION 40102
+#define LOCAL_INFILE_HANDLER_VERSION 40102
 #define SERVER_PREPARE_VERSION 40103
 #define CALL_PLACEHOLDER_VERSION 50503
 #define LIMIT_PLACEHOLDER_VERSION 50007
 #define GEO_DATATYPE_VERSION 50007
 #define NEW_DATATYPE_VERSION 50003
 #define MYSQL_VERSION_5_0 50001
+#define SERVER_CURSOR_VERSION 50002
 /* This is to avoid the ugly #ifdef mess in dbdimp.c */
 #if MYSQL_VERSION_ID < SQL_STATE_VERSION
 #define mysql_sqlstate(svsock) (NULL)
@@ -182,6 +184,23 @@ enum av_attribs {
     AV_ATTRIB_LAST         /*  Dummy attribute, never used, for allocation  */
 };                         /*  purposes only                                */
 
+/*
+ *  How the values of a result column are turned into Perl scalars,
+ *  worked out once per column by dbd_describe
+ */
+enum column_conv {
+    COLUMN_CONV_STRING = 0,  /*  as they are, BIT and ZEROFILL columns too  */
+    COLUMN_CONV_UTF8,        /*  decoded, with mysql_enable_utf8            */
+    COLUMN_CONV_DOUBLE,
+    COLUMN_CONV_IV,
+    COLUMN_CONV_UV
+};
+
+/*
+ *  Rows of a stored result which mysql_fetch_columns converts at a time
+ */
+#define FETCH_COLUMNS_BLOCK 256
+
 
 /*
  *  This is our part of the driver handle. We receive the handle as
@@ -207,6 +226,153 @@ struct imp_drh_st {
 };
 
 
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+/*
+ *  An entry in the per connection cache of server side prepared
+ *  statements. A statement handle holds one of these as well, so that
+ *  its MYSQL_STMT can be handed back to the cache when it is destroyed.
+ */
+typedef struct imp_stmt_cache_entry_st {
+    char          *statement;  /* statement text, owned by the entry,
+                                  then a NUL and the default database */
+    STRLEN        length;
+    U32           hash;
+    const char    *charset;    /* of the connection when prepared     */
+    MYSQL_STMT    *stmt;
+    unsigned long thread_id;   /* connection the stmt was prepared on */
+    unsigned long last_used;   /* value of the LRU clock              */
+} imp_stmt_cache_entry_t;
+
+/*
+ *  A statement the server refused to prepare with ER_UNSUPPORTED_PS, see
+ *  mysql_db_unsupported_ps(). The server version is part of the key, as
+ *  a reconnect may reach a server which does support it.
+ */
+#define UNSUPPORTED_PS_CACHE_SIZE 64
+
+typedef struct imp_unsupported_ps_st {
+    char          *statement;  /* statement text, owned by the entry  */
+    STRLEN        length;
+    U32           hash;
+    unsigned long server_version;
+} imp_unsupported_ps_t;
+
+/*
+ *  Where LOAD DATA LOCAL INFILE reads from instead of a file, see
+ *  mysql_local_infile_source. Rows returned by a code reference are
+ *  encoded as tab separated text in buffer.
+ */
+typedef struct imp_local_infile_st {
+    SV*    source;    /* scalar ref, file handle or code ref, or NULL */
+    SV*    buffer;    /* encoded rows not yet read by the client lib  */
+    STRLEN offset;    /* next byte in buffer, or in the scalar        */
+    bool   eof;       /* the code ref returned undef                  */
+    SV*    error;     /* message if reading from the source failed    */
+} imp_local_infile_t;
+#endif
+
+/*
+ *  Rows of mysql_use_result read ahead by a thread of the statement, see
+ *  mysql_prefetch_rows. The thread fills a ring of rows, which dbd_st_fetch
+ *  empties; the positions are atomics and the lock is only taken to sleep
+ *  when the ring is full or empty. The thread does not touch Perl at all.
+ */
+#if !defined(_WIN32) && defined(__GNUC__) && \
+    !defined(DBD_MYSQL_NO_PREFETCH_ROWS)
+#define HAVE_PREFETCH_ROWS
+#include <pthread.h>
+#include <signal.h>
+
+typedef struct imp_prefetch_row_st {
+    MYSQL_ROW      cols;      /* as from mysql_fetch_row, into data     */
+    unsigned long  *lengths;
+    char           *data;     /* the values, each followed by a NUL     */
+    size_t         data_size;
+} imp_prefetch_row_t;
+
+typedef struct imp_prefetch_st {
+    MYSQL_RES          *result;
+    unsigned int       num_fields;
+    imp_prefetch_row_t *rows;
+    unsigned long      size;     /* number of rows in the ring         */
+    unsigned long      head;     /* rows read by the thread            */
+    unsigned long      tail;     /* rows fetched by the statement      */
+    bool               holding;  /* row at tail is the one last fetched */
+    int                eof;      /* the thread read past the last row  */
+    int                failed;   /* the thread ran out of memory       */
+    int                done;     /* the thread ended                   */
+    int                cancel;   /* the thread is asked to stop        */
+    int                waiting;  /* one side sleeps on cond            */
+    bool               running;  /* the thread was not joined yet      */
+    pthread_t          thread;
+    pthread_mutex_t    lock;
+    pthread_cond_t     cond;
+} imp_prefetch_t;
+
+#define PREFETCH_STOP(imp_dbh) \
+  do { \
+    if ((imp_dbh)->prefetch) \
+      mysql_prefetch_stop((imp_dbh)->prefetch, (imp_dbh)); \
+  } while (0)
+/* for the statement's own uses of the connection other than fetching */
+#define PREFETCH_STOP_STH(imp_sth) \
+  PREFETCH_STOP((imp_dbh_t *) DBIc_PARENT_COM(imp_sth))
+
+/*
+ *  Every method of a handle starts by looking up its imp data, and so
+ *  does every function of the driver, which is where the thread is
+ *  stopped before anything else uses the connection: for any handle but
+ *  the statement the rows are read for, whose fetches go on using them.
+ */
+struct imp_dbh_st *mysql_dbh_enter(struct imp_dbh_st *imp_dbh);
+struct imp_sth_st *mysql_sth_enter(struct imp_sth_st *imp_sth);
+
+#undef D_imp_dbh
+#define D_imp_dbh(h) \
+  struct imp_dbh_st *imp_dbh= mysql_dbh_enter((struct imp_dbh_st *) (DBIh_COM(h)))
+#undef D_imp_sth
+#define D_imp_sth(h) \
+  struct imp_sth_st *imp_sth= mysql_sth_enter((struct imp_sth_st *) (DBIh_COM(h)))
+#else
+#define PREFETCH_STOP(imp_dbh)
+#define PREFETCH_STOP_STH(imp_sth)
+#endif
+
+/*
+ *  The rows of a result read with mysql_use_result into one block, see
+ *  mysql_compact_result. A row is a bitmap of its NULL columns, the
+ *  lengths of the other columns as variable length integers, and their
+ *  values, each followed by a NUL. The offset of every COMPACT_ROW_STEP-th
+ *  row is kept for dataseek; cols and lengths hold the row last fetched.
+ *  Past mysql_result_spill_bytes the block is moved to an unlinked file
+ *  in $TMPDIR and mapped, so that the pages can be written out instead of
+ *  taking memory.
+ */
+#define COMPACT_ROW_STEP 32
+
+#if !defined(_WIN32)
+#define HAVE_RESULT_SPILL
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef struct imp_compact_result_st {
+    char           *data;
+    size_t         data_size;      /* bytes used in data         */
+    size_t         data_capacity;
+    size_t         *index;         /* offset of row i * STEP     */
+    size_t         index_capacity;
+    my_ulonglong   num_rows;
+    my_ulonglong   cursor;         /* next row to fetch          */
+    size_t         offset;         /* of the next row in data    */
+    unsigned int   num_fields;
+    MYSQL_ROW      cols;
+    unsigned long  *lengths;
+    int            spill_fd;       /* data is mapped from it, or -1 */
+} imp_compact_result_t;
+
+
 /*
  *  Likewise, this is our part of the database handle, as returned
  *  by DBI->connect. We receive the handle as an "SV*", say "dbh",
@@ -234,16 +400,51 @@ struct imp_dbh_st {
                                */
     bool use_server_side_prepare;
     bool disable_fallback_for_server_prepare;
+    bool bind_native_types;  /* bind numbers as numbers with server side
+                              * prepared statements
+                              */
 #if MYSQL_ASYNC
     void* async_query_in_flight;
 #endif
 #if defined(sv_utf8_decode) && MYSQL_VERSION_ID >=SERVER_PREPARE_VERSION
     bool enable_utf8;
     bool enable_utf8mb4;
+#endif
+#if MYSQL_VERSION_ID >= SERVER_PREPARE_VERSION
+    imp_stmt_cache_entry_t *stmt_cache; /* idle server side prepared
+                                         * statements, see
+                                         * mysql_db_stmt_cache_fetch()
+                                         */
+    unsigned int stmt_cache_size;       /* maximum number of entries,
+                                         * 0 disables the cache
+                                         */
+    unsigned int stmt_cache_count;      /* number of entries in use */
+    unsigned long stmt_cache_clock;
+    imp_unsupported_ps_t *unsupported_ps; /* ring of statements which are
+                                           * not prepared on the server
+                                           */
+    unsigned int unsupported_ps_count;    /* number of entries in use */
+    unsigned int unsupported_ps_next;     /* entry replaced next      */
+#endif
+    char* query_buf;        /* statement with values filled in, do() */
+    STRLEN query_buf_size;
+    unsigned long max_allowed_packet; /* of the server, 0 if not known */
+#if MYSQL_VERSION_ID >= LOCAL_INFILE_HANDLER_VERSION
+    imp_local_infile_t local_infile;
+#endif
+#ifdef HAVE_PREFETCH_ROWS
+    imp_prefetch_t *prefetch; /* statement reading ahead on this
+                               * connection, see PREFETCH_STOP
+                               */
 #endif
     struct {
 	    unsigned int auto_reconnects_ok;
 	    unsigned int auto_reconnects_failed;
+	    unsigned long prepare_cache_hits;
+	    unsigned long prepare_cache_misses;
+	    unsigned long prepare_cache_evictions;
+	    unsigned long unsupported_ps_hits;
+	    unsigned long prefetch_stops;
     } stats;
 };
 
@@ -255,8 +456,64 @@ struct imp_dbh_st {
 typedef struct imp_sth_ph_st {
     SV* value;
     int type;
+    bool long_data;       /* mysql_long_data, value is not copied    */
+    bool by_ref;          /* mysql_bind_by_reference, read at execute */
 } imp_sth_ph_t;
 
+/*
+ *  The placeholders of an emulated prepared statement, found once when
+ *  the statement is prepared, so that execute only has to copy the
+ *  text between them.
+ */
+typedef struct imp_sth_ph_pos_st {
+    STRLEN offset;        /* position of the '?' in the template text */
+    bool   is_limit;      /* follows LIMIT, so the value is never quoted */
+} imp_sth_ph_pos_t;
+
+typedef struct imp_sth_tmpl_st {
+    char*  statement;     /* statement without leading white space    */
+    STRLEN length;
+    int    num_pos;       /* number of '?' found in the statement      */
+    imp_sth_ph_pos_t* pos;
+    bool   bind_comment_placeholders; /* setting used for the scan    */
+} imp_sth_tmpl_t;
+
+/*
+ *  Statements with placeholders are assembled in a buffer kept by the
+ *  handle for the next execute, unless it has grown larger than this.
+ */
+#define QUERY_BUFFER_KEEP_MAX 65536
+
+/*
+ *  Upper limit for the multi-row INSERT statements of execute_for_fetch,
+ *  even if the server's max_allowed_packet is larger
+ */
+#define MULTI_INSERT_MAX_PACKET (16 * 1024 * 1024)
+
+/*
+ *  Without mysql_stmt_store_result the longest value of a column is not
+ *  known, string columns of server side prepared statements start with a
+ *  buffer of their declared length up to this size, and grow as needed.
+ */
+#define STREAMED_COLUMN_BUFFER 8192
+
+/*
+ *  Parameters bound as mysql_long_data, filehandles or code references
+ *  are sent to the server with mysql_stmt_send_long_data in chunks of up
+ *  to this size.
+ */
+#define LONG_DATA_CHUNK 65536
+
+/*
+ *  MariaDB Connector/C can send many sets of parameters for a server side
+ *  prepared statement at once (COM_STMT_BULK_EXECUTE), execute_for_fetch
+ *  sends at most this many tuples with one of them.
+ */
+#if defined(MARIADB_PACKAGE_VERSION_ID) && MARIADB_PACKAGE_VERSION_ID >= 30000
+#define HAVE_BULK_EXECUTE
+#endif
+#define BULK_EXECUTE_MAX_ROWS 1000
+
 /*
  *  The bind_param method internally uses this structure for storing
  *  parameters.
@@ -269,6 +526,8 @@ typedef struct imp_sth_phb_st {
     } numeric_val;
     unsigned long   length;
     char            is_null;
+    char            *data;      /* copy of a string value, grown in place */
+    STRLEN          capacity;
 } imp_sth_phb_t;
 
 /*
@@ -286,11 +545,36 @@ typedef struct imp_sth_fbh_st {
     int            charsetnr;
     double         ddata;
     IV             ldata;
+    bool           deferred;  /* read by blob_read only */
+    unsigned long  width;     /* longest value, see adapt_result_buffers */
 #if MYSQL_VERSION_ID < FIELD_CHARSETNR_VERSION
     unsigned int   flags;
 #endif
 } imp_sth_fbh_t;
 
+/*
+ *  The conversion plan of a column of a client side prepared statement:
+ *  convert sets sv from the text of a value in a MYSQL_ROW.
+ */
+typedef struct imp_sth_conv_st {
+    enum column_conv kind;
+    void (*convert)(pTHX_ SV *sv, const char *col, STRLEN len);
+} imp_sth_conv_t;
+
+/*
+ *  A field of the result dbd_describe and the cached array attributes
+ *  were made for; see result_fields_changed.
+ */
+typedef struct imp_sth_field_st {
+    char          *name;
+    int           type;
+    unsigned long length;
+    unsigned int  flags;
+    unsigned int  decimals;
+#if MYSQL_VERSION_ID >= FIELD_CHARSETNR_VERSION
+    unsigned int  charsetnr;
+#endif
+} imp_sth_field_t;
 
 typedef struct imp_sth_fbind_st {
    unsigned long   * length;
@@ -320,6 +604,18 @@ struct imp_sth_st {
     int              has_been_bound;
     int use_server_side_prepare;  /* server side prepare statements? */
     int disable_fallback_for_server_prepare;
+    int bind_native_types;        /* bind numbers as numbers?         */
+    int server_cursor;            /* fetch through a read only cursor */
+    unsigned long cursor_prefetch_rows; /* rows per fetch of the cursor */
+    unsigned long adaptive_buffer_limit; /* largest string buffer made
+                                          * without max_length, 0 to
+                                          * have max_length computed
+                                          */
+    int result_stored;            /* mysql_stmt_store_result called   */
+    int defer_blobs;              /* leave BLOB/TEXT to blob_read     */
+    imp_stmt_cache_entry_t stmt_cache_entry; /* key for handing stmt
+                                              * back to the cache
+                                              */
 #endif
 
     MYSQL_RES* result;       /* result                                 */
@@ -333,10 +629,31 @@ struct imp_sth_st {
     my_ulonglong insertid; /* ID of auto insert                      */
     int   warning_count;  /* Number of warnings after execute()     */
     imp_sth_ph_t* params; /* Pointer to parameter array             */
+    imp_sth_tmpl_t* params_tmpl; /* Placeholder scan of the statement */
+    char* query_buf;      /* statement with values filled in        */
+    STRLEN query_buf_size;
+    imp_sth_conv_t* conv; /* conversion of each column, dbd_describe */
+    int   num_conv;       /* number of entries allocated in conv    */
+    imp_sth_field_t* result_fields; /* fields of the described result */
+    int   num_result_fields;
+    bool  result_utf8;    /* mysql_enable_utf8 when described       */
     AV* av_attr[AV_ATTRIB_LAST];/*  For caching array attributes        */
     int   use_mysql_use_result;  /*  TRUE if execute should use     */
                           /* mysql_use_result rather than           */
                           /* mysql_store_result */
+    bool  bind_by_reference; /* mysql_bind_by_reference            */
+    bool  borrow_strings; /* mysql_borrow_strings                   */
+    bool  fbav_borrowed;  /* values of DBI's row array may borrow   */
+    SV*   result_owner;   /* frees result once nothing borrows it   */
+    bool  compact_result; /* mysql_compact_result                   */
+    imp_compact_result_t* compact; /* rows of result, or NULL       */
+    UV    result_spill_bytes; /* mysql_result_spill_bytes              */
+    MYSQL_ROW current_row; /* last row fetched, for blob_read      */
+    unsigned long* current_lengths;
+    IV    prefetch_rows;  /* mysql_prefetch_rows                    */
+#ifdef HAVE_PREFETCH_ROWS
+    imp_prefetch_t* prefetch; /* rows read ahead, or NULL           */
+#endif
 
 #if MYSQL_ASYNC
     bool is_async;
@@ -401,10 +718,19 @@ my_ulonglong mysql_st_internal_execute41(SV *,
                                          MYSQL_RES **,
                                          MYSQL_STMT *,
                                          MYSQL_BIND *,
-                                         int *);
+                                         int *,
+                                         int);
 
 
 int mysql_st_clean_cursor(SV*, imp_sth_t*);
+
+bool mysql_db_stmt_cache_fetch(pTHX_ imp_dbh_t *, const char *, STRLEN,
+                               imp_stmt_cache_entry_t *);
+void mysql_db_stmt_cache_store(pTHX_ imp_dbh_t *, imp_stmt_cache_entry_t *);
+void mysql_db_stmt_cache_flush(pTHX_ imp_dbh_t *);
+bool mysql_db_unsupported_ps(pTHX_ imp_dbh_t *, const char *, STRLEN);
+void mysql_db_unsupported_ps_add(pTHX_ imp_dbh_t *, const char *, STRLEN);
+int mysql_db_stmt_prepare(pTHX_ imp_dbh_t *, MYSQL_STMT *, const char *, STRLEN);
 #endif
 
 #if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
@@ -427,6 +753,20 @@ extern MYSQL* mysql_dr_connect(SV*, MYSQL*, char*, char*, char*, char*, char*,
 
 extern int mysql_db_reconnect(SV*);
 int mysql_st_free_result_sets (SV * sth, imp_sth_t * imp_sth);
+bool mysql_st_compact_seek(imp_sth_t *imp_sth, my_ulonglong pos);
+bool long_data_source(SV *value);
+int mysql_st_bind_values(SV *sth, imp_sth_t *imp_sth, SV **values,
+                         int num_values);
+int mysql_st_execute_for_fetch(SV *sth, imp_sth_t *imp_sth,
+                               SV *fetch_tuple_sub, SV *tuple_status,
+                               IV *tuple_count, IV *rows, IV *err_count);
+SV *mysql_st_fetchall_arrayref(SV *sth, imp_sth_t *imp_sth, AV *columns,
+                               AV *names, IV max_rows);
+#ifdef HAVE_PREFETCH_ROWS
+void mysql_prefetch_stop(imp_prefetch_t *p, imp_dbh_t *imp_dbh);
+#endif
+SV *mysql_st_fetch_columns(SV *sth, imp_sth_t *imp_sth, bool as_hash,
+                           IV max_rows);
 #if MYSQL_ASYNC
 int mysql_db_async_result(SV* h, MYSQL_RES** resp);
 int mysql_db_async_ready(SV* h);
@@ -45,6 +45,7 @@ sub driver{
 	DBD::mysql::db->install_method('mysql_async_ready');
 	DBD::mysql::st->install_method('mysql_async_result');
 	DBD::mysql::st->install_method('mysql_async_ready');
+	DBD::mysql::st->install_method('mysql_fetch_columns');
 
 	$methods_are_installed++;
     }
@@ -855,7 +856,7 @@ use strict;
 
 BEGIN {
     my @needs_async_result = qw/fetchrow_hashref fetchall_hashref/;
-    my @needs_async_check = qw/bind_param_array bind_col bind_columns execute_for_fetch/;
+    my @needs_async_check = qw/bind_param_array bind_col bind_columns/;
 
     foreach my $method (@needs_async_result) {
         no strict 'refs';
@@ -882,6 +883,73 @@ BEGIN {
     }
 }
 
+sub execute_for_fetch {
+    my ($sth, $fetch_tuple_sub, $tuple_status) = @_;
+    return unless $sth->func('_async_check');
+
+    # INSERT ... VALUES (?, ...) is sent as multi-row INSERTs, and server
+    # side prepared statements in bulk on MariaDB; anything else is
+    # executed tuple by tuple by DBI
+    my ($tuples, $rows, $errors) =
+        $sth->_execute_for_fetch($fetch_tuple_sub, $tuple_status);
+    return $sth->SUPER::execute_for_fetch($fetch_tuple_sub, $tuple_status)
+        unless defined $tuples;
+
+    return $sth->set_err($DBI::stderr,
+                         "executing $tuples generated $errors errors")
+        if $errors;
+    return wantarray ? ($tuples, $rows) : $tuples;
+}
+
+# These replace the versions from DBI's Driver.xst, which are installed by
+# the bootstrap above: execute binds its values in one call rather than one
+# call per value, and fetchall_arrayref handles slices in C too.
+{
+    no warnings 'redefine';
+
+    *execute = \&_execute;
+
+    *fetchall_arrayref = sub {
+        my ($sth, $slice, $max_rows) = @_;
+
+        return undef if $max_rows and not $sth->FETCH('Active');
+
+        my $mode = ref $slice;
+        my ($columns, $names);
+        if ($mode eq 'ARRAY') {
+            $columns = $slice if @$slice;
+        }
+        elsif ($mode eq 'HASH') {
+            if (keys %$slice) {
+                my $name2idx = $sth->FETCH('NAME_lc_hash');
+                $names = [ keys %$slice ];
+                $columns = [ map { $name2idx->{lc $_} } @$names ];
+                for (0 .. $#$names) {
+                    return $sth->set_err($DBI::stderr,
+                        "Invalid column name '$names->[$_]' for slice")
+                        unless defined $columns->[$_];
+                }
+            }
+            else {
+                $names = $sth->FETCH($sth->FETCH('FetchHashKeyName'));
+                return [] if !$names || !@$names;
+                $columns = [ 0 .. $#$names ];
+            }
+        }
+        elsif ($mode) {
+            # \{ $index => $name } and anything else DBI knows about
+            return $sth->SUPER::fetchall_arrayref($slice, $max_rows);
+        }
+        return $sth->_fetchall_arrayref($columns, $names, $max_rows);
+    };
+
+    # DBI's Perl selectall_arrayref, which fetches with the method above
+    *DBD::mysql::db::selectall_arrayref = sub {
+        my $dbh = shift;
+        return $dbh->DBD::_::db::selectall_arrayref(@_);
+    };
+}
+
 1;
 
 __END__
@@ -1249,6 +1317,50 @@ in the MySQL client library by default. If your DSN contains the option
 this option is *ineffective* if the server has also been configured to
 disallow LOCAL.)
 
+=item mysql_local_infile_source
+
+Makes C<LOAD DATA LOCAL INFILE> read from Perl data instead of the file
+named in the statement, so that nothing has to be written to a temporary
+file first. The file name in the statement is ignored. The value is one of
+
+=over
+
+=item a reference to a scalar
+
+holding the file contents, for example C<\$tsv>;
+
+=item an open file handle
+
+like C<\*STDIN> or an L<IO::Handle> object, which is read until the end
+of file;
+
+=item a code reference
+
+which is called repeatedly for the next row and returns a reference to
+an array of values, or undef after the last row. The rows are encoded in
+the default format of C<LOAD DATA>: values separated by tabs, lines ended
+by newlines, tabs, newlines and backslashes escaped with a backslash and
+undef sent as C<\N>. So the statement must not change the C<FIELDS> and
+C<LINES> options. A plain string returned instead of an array reference
+is passed on as it is.
+
+=back
+
+The source is used by every C<LOAD DATA LOCAL INFILE> on the connection
+until it is set to undef, so it is best set with C<local>:
+
+  {
+    local $dbh->{mysql_local_infile_source} = sub {
+      my $row = $sth->fetchrow_arrayref or return;
+      return [ @$row ];
+    };
+    $dbh->do("LOAD DATA LOCAL INFILE 'rows' INTO TABLE copy");
+  }
+
+If the code reference dies, the statement fails with the message. As
+for any other C<LOAD DATA LOCAL>, L</mysql_local_infile> has to be
+enabled.
+
 =item mysql_multi_statements
 
 Support for multiple statements separated by a semicolon
@@ -1299,6 +1411,34 @@ Useful when you want to be sure that statement is going to be executed as
 server side prepared. Error message and code in case of failure is propagated
 back to DBI.
 
+=item mysql_server_prepare_cache_size
+
+By default every statement handle prepares its statement on the server and
+closes it again when the handle is destroyed. Setting this option to a
+positive number keeps up to that many server side prepared statements per
+connection around after their handles are gone, so that a later prepare()
+or do() of the very same statement text can reuse them without a round
+trip to the server:
+
+  $dbh = DBI->connect(
+    "DBI:mysql:database=test;host=localhost",
+    "",
+    "",
+    { RaiseError => 1, mysql_server_prepare => 1,
+      mysql_server_prepare_cache_size => 32 }
+  );
+
+A statement is only reused with the default database and character set
+it was prepared with, as the server resolves table names and parses the
+text with them; a C<USE> run through DBD::mysql also empties the cache.
+When the cache is full, the least recently used statement is closed. The
+cache is emptied on disconnect and on reconnect. If the server refuses to
+prepare a statement because its max_prepared_stmt_count limit was reached,
+DBD::mysql closes the cached statements, halves the cache size and tries
+once more. The option can also be changed later on using
+C<$dbh-E<gt>{mysql_server_prepare_cache_size}>; setting it to 0 (the
+default) disables the cache.
+
 =item mysql_embedded_options
 
 The option <mysql_embedded_options> can be used to pass 'command-line'
@@ -1492,6 +1632,38 @@ server.
 
 The number of times that DBD::mysql tried to reconnect to mysql but failed.
 
+=item prepare_cache_hits
+
+The number of server side prepared statements that were taken from the
+statement cache, see L</mysql_server_prepare_cache_size>.
+
+=item prepare_cache_misses
+
+The number of statements that had to be prepared on the server while the
+statement cache was enabled.
+
+=item prepare_cache_evictions
+
+The number of statements that were closed to make room in the statement
+cache.
+
+=item unsupported_ps_hits
+
+The number of statements that were emulated right away because the server
+had refused to prepare them before with ER_UNSUPPORTED_PS, rather than
+trying once more.
+
+=item unsupported_ps_count
+
+The number of such statements remembered, up to 64 per connection; the
+oldest one is forgotten first.
+
+=item prefetch_stops
+
+The number of times a thread reading rows ahead for L</mysql_prefetch_rows>
+was stopped before it read the last row, because the statement was
+finished or the connection was used for something else.
+
 =back
 
 =back
@@ -1637,6 +1809,22 @@ not correct prepared statement behavior, but some developers
 have come to depend on this behavior, so I have made it available
 in 4.015
 
+=item mysql_bind_native_types
+
+This attribute causes the driver (server side prepared statements) to
+pass values bound without an SQL type to the server as integers or
+doubles rather than strings, if they are Perl numbers which have never
+been used as a string. This saves converting numbers to text in Perl and
+back again on the server. Strings, even if they look like numbers, are
+still sent as strings, so leading zeroes and the like are preserved.
+
+The attribute is off by default. It applies to execute() and bind_param()
+as well as to do(), and it can be set on the database handle, at connect
+time, or for single statements:
+
+  my $sth = $dbh->prepare($sql, { mysql_server_prepare => 1,
+                                  mysql_bind_native_types => 1 });
+
 =item mysql_no_autocommit_cmd
 
 This attribute causes the driver to not issue 'set autocommit'
@@ -1726,6 +1914,168 @@ this attribute determines whether a I<fetchrow> will chop preceding
 and trailing blanks off the column values. Chopping blanks does not
 have impact on the I<max_length> attribute.
 
+=item mysql_borrow_strings
+
+With this attribute, set by prepare() or later on the statement handle,
+string columns of a stored result are not copied into the fetched row:
+the values point into the result received from the server instead, which
+is kept until the statement and the last of these values are done with
+it. This saves a copy per value when wide VARCHAR or TEXT rows are only
+scanned. The values are read-only; assign them to a variable to keep a
+copy you can change.
+
+  my $sth = $dbh->prepare($sql, { mysql_borrow_strings => 1 });
+
+Numbers, columns of server side prepared statements and of
+C<mysql_use_result> and values chopped by C<ChopBlanks> are copied as
+usual.
+
+Columns bound with bind_col() or bind_columns() are your own variables
+and always get a copy. When the statement is finished, by fetching past
+the last row or by finish(), the values of the last fetched row are given
+their own copy too, so that they no longer hold on to the result.
+
+=item mysql_compact_result
+
+With this attribute, set by prepare() or later on the statement handle,
+execute() reads the rows with C<mysql_use_result> into a single block
+owned by the driver instead of the result kept by C<mysql_store_result>,
+which takes a pointer per value and an allocation per row. A row is
+stored as a bitmap of its NULL columns, the lengths of the other columns
+and their values, so results of many short rows take noticeably less
+memory:
+
+  my $sth = $dbh->prepare($sql, { mysql_compact_result => 1 });
+
+The whole result is still read by execute(), so C<rows>, C<dataseek> and
+C<mysql_max_length> work as for a stored result. The attribute is ignored
+for server side prepared statements and with C<mysql_use_result>.
+
+=item mysql_result_memory
+
+The number of bytes of memory taken by the rows of a statement with
+C<mysql_compact_result> or C<mysql_result_spill_bytes>, or undef for other
+statements and when there is no result. Read only.
+
+=item mysql_result_spill_bytes
+
+A stored result is read into memory as a whole, which may not fit, while
+C<mysql_use_result> keeps the connection busy, and the tables locked, until
+the last row is fetched. With this attribute set to a number of bytes, by
+prepare() or later on the statement handle, execute() reads the rows as
+with C<mysql_compact_result>, and once they take more than that many bytes
+moves them to a file in C<$TMPDIR>, which is mapped into memory and
+removed again right away. The rest of the rows are written to the file,
+from where the operating system pages them in as they are fetched:
+
+  my $sth = $dbh->prepare($sql, { mysql_result_spill_bytes => 64 << 20 });
+
+C<rows> and C<dataseek> work as for a stored result. The attribute is
+ignored for server side prepared statements and with C<mysql_use_result>,
+and on Windows, where the rows stay in memory.
+
+=item mysql_result_spilled
+
+The number of bytes of the file the rows of a statement with
+C<mysql_result_spill_bytes> were moved to, 0 if they stayed in memory, or
+undef if there is no such result. Read only.
+
+=item mysql_prefetch_rows
+
+With C<mysql_use_result>, rows are read from the server only when they
+are fetched. If this attribute is set to a number of rows, by prepare()
+or later on the statement handle, execute() starts a thread which keeps
+reading up to that many rows ahead, so that reading from the network
+overlaps with processing the rows already fetched:
+
+  my $sth = $dbh->prepare($sql, { mysql_use_result => 1,
+                                  mysql_prefetch_rows => 256 });
+
+The thread only reads rows, it never calls into Perl. It stops when the
+statement is finished or executed again, and whenever the database handle
+or any of its other statements is used, in which case the remaining rows
+are read as they are fetched. If it runs out of memory, fetching ends
+with an error. The attribute is ignored for stored results, server side
+prepared statements and asynchronous queries, on Windows, and when
+Makefile.PL found no POSIX threads.
+
+=item mysql_server_cursor
+
+With server side prepared statements, execute() normally reads the whole
+result into client memory before the first row is fetched. With this
+attribute set, by prepare() or later on the statement handle, a read only
+cursor is opened on the server instead and rows are fetched from it in
+batches of C<mysql_cursor_prefetch_rows>, so that memory use stays bounded
+however many rows the statement returns. The database handle can be used
+for other statements while the cursor is open.
+
+  my $sth = $dbh->prepare($sql, { mysql_server_prepare => 1,
+                                  mysql_server_cursor => 1,
+                                  mysql_cursor_prefetch_rows => 1000 });
+
+As with C<mysql_use_result>, C<rows> is not known until all rows have been
+fetched. finish() closes the cursor. The attribute is ignored unless the
+statement is server side prepared, and needs a client library of MySQL 5.0.2
+or later.
+
+C<mysql_use_result> on its own now also applies to server side prepared
+statements: rows are read from the server as they are fetched, and the
+connection is busy until the last one has been read or the statement is
+finished.
+
+=item mysql_cursor_prefetch_rows
+
+The number of rows fetched from a C<mysql_server_cursor> per round trip to
+the server. The default of 0 leaves the client library default of one row.
+
+=item mysql_adaptive_buffer_limit
+
+String columns of server side prepared statements are fetched into
+buffers as large as their longest value, which the client library finds
+by a pass over all stored rows. If this attribute is set to a number of
+bytes, that pass is skipped: each buffer starts at the declared length of
+its column, up to this limit, and grows when a longer value is fetched,
+for the rest of the rows. Each following execute starts a buffer at the
+longest value of its column fetched so far, again up to the limit; values
+which do not fit are fetched in a second step.
+I<mysql_max_length> is 0 in this mode. The default of 0 keeps the pass.
+
+  my $sth = $dbh->prepare("SELECT id, comment FROM orders WHERE day = ?",
+                          { mysql_server_prepare => 1,
+                            mysql_adaptive_buffer_limit => 4096 });
+
+=item mysql_defer_blobs
+
+With server side prepared statements, BLOB and TEXT columns are copied
+into a buffer as large as the longest value and then into the fetched
+row. If this attribute is set, by prepare() or before the first
+execute(), such columns are fetched as undef instead and are only read
+by I<blob_read>, in chunks of the size you choose:
+
+  my $sth = $dbh->prepare("SELECT id, body FROM mail",
+                          { mysql_server_prepare => 1,
+                            mysql_defer_blobs => 1 });
+
+=item mysql_bind_by_reference
+
+Normally bind_param() and execute() copy every value bound to a
+parameter. With this attribute set, by prepare() or later on the
+statement handle, the driver keeps a reference to the bound variable
+instead and reads its value when the statement is executed. This saves a
+copy of each value, and a variable can be bound once for many executes,
+as with bind_param_inout(). Bound by reference, a reference to a plain
+scalar binds that scalar:
+
+  my $sth = $dbh->prepare("INSERT INTO t (id, name) VALUES (?, ?)",
+                          { mysql_bind_by_reference => 1 });
+  $sth->bind_param(1, \my $id);
+  $sth->bind_param(2, \my $name);
+  while (($id, $name) = get_next()) {
+    $sth->execute;
+  }
+
+The attribute applies to parameters bound while it is set.
+
 =item mysql_insertid
 
 If the statement you executed performs an INSERT, and there is an AUTO_INCREMENT
@@ -1737,6 +2087,10 @@ Typically, you'd access the value via $sth->{mysql_insertid}. The value can
 also be accessed via $dbh->{mysql_insertid} but this can easily
 produce incorrect results in case one database handle is shared.
 
+After execute_array() of an C<INSERT ... VALUES> statement, this is the
+value of the first row of the last multi-row INSERT sent, see
+L</execute_array and execute_for_fetch>.
+
 =item mysql_is_blob
 
 Reference to an array of boolean values; TRUE indicates, that the
@@ -1820,6 +2174,111 @@ This attribute is available on both statement handles and database handles.
 
 =back
 
+=head2 execute_array and execute_for_fetch
+
+For client side prepared statements of the form
+C<INSERT ... VALUES (?, ...)> or C<REPLACE ... VALUES (?, ...)>,
+I<execute_array> and I<execute_for_fetch> do not execute the statement
+once per tuple. Instead they send multi-row statements like
+C<INSERT ... VALUES (...),(...),(...)>, each one as large as the server's
+max_allowed_packet permits (but at most 16 MB), which saves a round trip
+to the server per tuple.
+
+As MySQL reports success or failure for a whole statement only, the
+status of each tuple in C<ArrayTupleStatus> is -1 (number of rows
+unknown) if the statement it was sent with succeeded. If that statement
+failed, every tuple sent with it gets the error, even though the error
+may have been caused by just one of them. Depending on the storage
+engine, the rows preceding the failing one may have been inserted.
+
+Afterwards C<mysql_insertid> holds the AUTO_INCREMENT value generated
+for the first row of the last multi-row statement, as LAST_INSERT_ID()
+does, not the one of the last tuple as when the tuples are executed one
+by one. The rows of one statement get consecutive values only with
+C<innodb_autoinc_lock_mode> 0 or 1, so the driver does not work out the
+last one.
+
+When DBD::mysql is built with MariaDB Connector/C 3.0 or later and
+connected to MariaDB 10.2.6 or later, server side prepared statements
+which do not return a result set (see L</mysql_server_prepare>) are
+executed in bulk: up to 1000 tuples at a time are sent to the server in
+one packet, with all values sent as strings. Again, C<ArrayTupleStatus>
+reports the success or failure of the whole batch for each of its tuples.
+
+All other statements are executed tuple by tuple by DBI as usual.
+
+=head2 fetchall_arrayref and selectall_arrayref
+
+I<fetchall_arrayref> fetches all rows in C, directly into a new array per
+row, also for array and hash slices and with C<$max_rows>, instead of a
+method call and a copy of the fetched row per row as DBI does for slices.
+I<selectall_arrayref> uses it for its C<Slice>, C<Columns> and C<MaxRows>
+attributes as well. Columns bound with I<bind_col> are not updated by
+these methods. The renaming slice C<\{ $index =E<gt> $name }> is left to
+DBI.
+
+=head2 mysql_fetch_columns
+
+  my $columns = $sth->mysql_fetch_columns;
+  my $by_name = $sth->mysql_fetch_columns({ Slice => {}, MaxRows => 1000 });
+
+Fetches the remaining rows of a result set as one array per column rather
+than one per row: a reference to an array of columns, or with
+C<Slice =E<gt> {}> a reference to a hash of them keyed by the column names
+(see C<FetchHashKeyName>). Each column is a reference to an array of its
+values, converted just like I<fetch> does. C<MaxRows> limits the number of
+rows fetched, so that the method can be called again for the next batch;
+it returns undef once the statement is no longer active.
+
+Rows of a client side prepared statement are converted a block at a time,
+column by column, straight from the rows received from the server, which
+avoids building an array per row. Server side prepared statements are
+fetched row by row.
+
+=head2 blob_read
+
+  my $offset = 0;
+  while (defined(my $chunk = $sth->blob_read($field, $offset, 65536))) {
+    print $fh $chunk;
+    $offset += length $chunk;
+  }
+
+Reads up to C<$len> bytes of column C<$field> (counting from 0) of the
+current row, starting at byte C<$offset>, so that long BLOB and TEXT
+values can be processed in chunks. The bytes are not decoded, even with
+C<mysql_enable_utf8>. It returns undef for a NULL value and once
+C<$offset> reaches the end of the value, so DBI's I<blob_copy_to_file>
+works too. With server side prepared statements each chunk is copied from
+the row by mysql_stmt_fetch_column; see C<mysql_defer_blobs> for not
+copying the whole value into the fetched row as well.
+
+=head2 Long data parameters
+
+  open my $fh, '<:raw', $file or die $!;
+  my $sth = $dbh->prepare("INSERT INTO files (name, data) VALUES (?, ?)");
+  $sth->bind_param(1, $file);
+  $sth->bind_param(2, $fh);
+  $sth->execute;
+
+  $sth->bind_param(2, sub { $socket->read(my $buf, 65536) ? $buf : undef });
+  $sth->bind_param(2, $big_string, { mysql_long_data => 1 });
+
+A parameter bound to a filehandle or a code reference, or with the
+C<mysql_long_data> attribute, is sent to the server in chunks of 64KB
+with mysql_stmt_send_long_data when the statement is executed, so that
+it is never held in memory as a whole. A filehandle is read to its end,
+a code reference is called until it returns undef or an empty string,
+and a string bound with C<mysql_long_data> is sent without being copied;
+all of them are read again by every execute(). Like the SQL type, the
+attribute sticks to the parameter until it is bound with the attribute
+again.
+
+This needs a server side prepared statement: a client side prepared
+statement is prepared on the server the first time it is executed with
+such a parameter, and fails if the server cannot prepare it. Long data
+is not supported with asynchronous queries, and do() fails when it is
+given a filehandle or a code reference as a value.
+
 =head1 TRANSACTION SUPPORT
 
 The transaction support works as follows:
@@ -270,10 +270,28 @@ do(dbh, statement, attr=Nullsv, ...)
   int             buffer_type= 0;
   int             use_server_side_prepare= 0;
   int             disable_fallback_for_server_prepare= 0;
+  int             bind_native_types= 0;
+  int             buffer_is_unsigned;
   MYSQL_STMT      *stmt= NULL;
   MYSQL_BIND      *bind= NULL;
+  imp_sth_phb_t   *fbind= NULL;
+  imp_stmt_cache_entry_t cache_entry;
+  int             prepare_failed;
 #endif
     ASYNC_CHECK_XS(dbh);
+    {
+      /* Not stringified into the statement, see send_long_data */
+      int i;
+
+      for (i= 3; i < items; i++)
+        if (long_data_source(ST(i)))
+        {
+          do_error(dbh, JW_ERR_NOT_IMPLEMENTED,
+                   "do() does not take filehandles or code references as "
+                   "values, use prepare() and execute()", "HY000");
+          XSRETURN_UNDEF;
+        }
+    }
 #if MYSQL_VERSION_ID >= MULTIPLE_RESULT_SET_VERSION
     while (mysql_next_result(imp_dbh->pmysql)==0)
     {
@@ -293,6 +311,7 @@ do(dbh, statement, attr=Nullsv, ...)
   */
 
   use_server_side_prepare = imp_dbh->use_server_side_prepare;
+  bind_native_types = imp_dbh->bind_native_types;
   if (attr)
   {
     SV** svp;
@@ -306,6 +325,10 @@ do(dbh, statement, attr=Nullsv, ...)
     disable_fallback_for_server_prepare = (svp) ?
       SvTRUE(*svp) : imp_dbh->disable_fallback_for_server_prepare;
 
+    svp = DBD_ATTRIB_GET_SVP(attr, "mysql_bind_native_types", 23);
+    if (svp)
+      bind_native_types = SvTRUE(*svp);
+
     svp   = DBD_ATTRIB_GET_SVP(attr, "async", 5);
     async = (svp) ? *svp : &PL_sv_no;
   }
@@ -336,12 +359,32 @@ do(dbh, statement, attr=Nullsv, ...)
   if (use_server_side_prepare)
   {
     str_ptr= SvPV(statement, slen);
+    /* A statement the server could not prepare before is not tried again */
+    if (!disable_fallback_for_server_prepare &&
+        mysql_db_unsupported_ps(aTHX_ imp_dbh, str_ptr, strlen(str_ptr)))
+      use_server_side_prepare= 0;
+  }
 
-    stmt= mysql_stmt_init(imp_dbh->pmysql);
-
-    if ((mysql_stmt_prepare(stmt, str_ptr, strlen(str_ptr)))  &&
+  if (use_server_side_prepare)
+  {
+    /* Reuse the statement of an earlier do(), if it is cached */
+    if (mysql_db_stmt_cache_fetch(aTHX_ imp_dbh, str_ptr, strlen(str_ptr),
+                                  &cache_entry))
+    {
+      stmt= cache_entry.stmt;
+      cache_entry.stmt= NULL;
+      prepare_failed= 0;
+    }
+    else
+    {
+      stmt= mysql_stmt_init(imp_dbh->pmysql);
+      prepare_failed=
+        (mysql_db_stmt_prepare(aTHX_ imp_dbh, stmt, str_ptr, strlen(str_ptr)))  &&
         (!mysql_db_reconnect(dbh) ||
-         (mysql_stmt_prepare(stmt, str_ptr, strlen(str_ptr)))))
+         (mysql_db_stmt_prepare(aTHX_ imp_dbh, stmt, str_ptr, strlen(str_ptr))));
+    }
+
+    if (prepare_failed)
     {
       /*
         For commands that are not supported by server side prepared
@@ -350,6 +393,7 @@ do(dbh, statement, attr=Nullsv, ...)
       if (!disable_fallback_for_server_prepare && mysql_stmt_errno(stmt) == ER_UNSUPPORTED_PS)
       {
         use_server_side_prepare= 0;
+        mysql_db_unsupported_ps_add(aTHX_ imp_dbh, str_ptr, strlen(str_ptr));
       }
       else
       {
@@ -359,6 +403,22 @@ do(dbh, statement, attr=Nullsv, ...)
       }
       mysql_stmt_close(stmt);
       stmt= NULL;
+      mysql_db_stmt_cache_store(aTHX_ imp_dbh, &cache_entry);
+    }
+    else if (mysql_stmt_param_count(stmt) > (unsigned long) (items > 3 ? items - 3 : 0))
+    {
+      /*
+        A cached statement still has the parameters of its previous
+        owner bound, so never let the client library fall back to them
+      */
+      char errmsg[80];
+      sprintf(errmsg, "called with %d bind variables when %lu are needed",
+              items > 3 ? (int) items - 3 : 0, mysql_stmt_param_count(stmt));
+      do_error(dbh, JW_ERR_ILLEGAL_PARAM_NUM, errmsg, NULL);
+      retval=-2;
+      cache_entry.stmt= stmt;
+      stmt= NULL;
+      mysql_db_stmt_cache_store(aTHX_ imp_dbh, &cache_entry);
     }
     else
     {
@@ -375,6 +435,8 @@ do(dbh, statement, attr=Nullsv, ...)
         int i;
         num_params= items - 3;
         Newz(0, bind, (unsigned int) num_params, MYSQL_BIND);
+        if (bind_native_types)
+          Newz(0, fbind, (unsigned int) num_params, imp_sth_phb_t);
 
         for (i = 0; i < num_params; i++)
         {
@@ -388,7 +450,28 @@ do(dbh, statement, attr=Nullsv, ...)
             if (SvOK(param))
               defined= 1;
           }
-          if (defined)
+          buffer_is_unsigned= 0;
+          if (defined && fbind && !SvPOK(param) && SvIOK(param))
+          {
+            /* numbers which never were strings are bound as such */
+            fbind[i].numeric_val.lval= SvIVX(param);
+            buffer= (char *) &fbind[i].numeric_val.lval;
+            buffer_length= sizeof fbind[i].numeric_val.lval;
+#if IVSIZE >= 8
+            buffer_type= MYSQL_TYPE_LONGLONG;
+#else
+            buffer_type= MYSQL_TYPE_LONG;
+#endif
+            buffer_is_unsigned= SvIsUV(param) ? 1 : 0;
+          }
+          else if (defined && fbind && !SvPOK(param) && SvNOK(param))
+          {
+            fbind[i].numeric_val.dval= SvNVX(param);
+            buffer= (char *) &fbind[i].numeric_val.dval;
+            buffer_length= sizeof fbind[i].numeric_val.dval;
+            buffer_type= MYSQL_TYPE_DOUBLE;
+          }
+          else if (defined)
           {
             buffer= SvPV(param, slen);
             buffer_length= slen;
@@ -404,6 +487,7 @@ do(dbh, statement, attr=Nullsv, ...)
           bind[i].buffer_type = buffer_type;
           bind[i].buffer_length= buffer_length;
           bind[i].buffer= buffer;
+          bind[i].is_unsigned= buffer_is_unsigned;
         }
         has_binded= 0;
       }
@@ -412,12 +496,12 @@ do(dbh, statement, attr=Nullsv, ...)
                                            &result,
                                            stmt,
                                            bind,
-                                           &has_binded);
+                                           &has_binded,
+                                           0);
       if (bind)
         Safefree(bind);
-
-      mysql_stmt_close(stmt);
-      stmt= NULL;
+      if (fbind)
+        Safefree(fbind);
 
       if (retval == -2) /* -2 means error */
       {
@@ -425,8 +509,17 @@ do(dbh, statement, attr=Nullsv, ...)
         if (!disable_fallback_for_server_prepare && SvIV(err) == ER_UNSUPPORTED_PS)
         {
           use_server_side_prepare = 0;
+          /* not worth caching */
+          Safefree(cache_entry.statement);
+          cache_entry.statement= NULL;
+          mysql_db_unsupported_ps_add(aTHX_ imp_dbh, str_ptr, strlen(str_ptr));
         }
       }
+
+      /* Keep the statement for the next do(), or close it */
+      cache_entry.stmt= stmt;
+      stmt= NULL;
+      mysql_db_stmt_cache_store(aTHX_ imp_dbh, &cache_entry);
     }
   }
 
@@ -652,7 +745,9 @@ dataseek(sth, pos)
   else
   {
 #endif
-  if (imp_sth->result) {
+  if (mysql_st_compact_seek(imp_sth, pos)) {
+    RETVAL = 1;
+  } else if (imp_sth->result) {
     mysql_data_seek(imp_sth->result, pos);
     RETVAL = 1;
   } else {
@@ -744,6 +839,106 @@ void mysql_async_ready(sth)
 #endif
     }
 
+void
+_execute(sth, ...)
+    SV* sth
+  CODE:
+    {
+      /*
+        DBI's execute, but with the values bound in one call rather
+        than by a call of dbd_bind_ph for each
+      */
+      D_imp_sth(sth);
+      int retval;
+
+      if (items > 1 &&
+          !mysql_st_bind_values(sth, imp_sth, &ST(1), items - 1))
+        XSRETURN_UNDEF;
+      if (DBIc_ROW_COUNT(imp_sth) > 0) /* reset for re-execute */
+        DBIc_ROW_COUNT(imp_sth)= 0;
+      retval= dbd_st_execute(sth, imp_sth);
+      /* remember that dbd_st_execute must return <= -2 for error */
+      if (retval == 0)		/* ok with no rows affected	*/
+        XST_mPV(0, "0E0");	/* (true but zero)		*/
+      else if (retval < -1)	/* -1 == unknown number of rows	*/
+        XST_mUNDEF(0);		/* <= -2 means error   		*/
+      else
+        XST_mIV(0, retval);	/* typically 1, rowcount or -1	*/
+    }
+
+void
+_execute_for_fetch(sth, fetch_tuple_sub, tuple_status = Nullsv)
+    SV* sth
+    SV* fetch_tuple_sub
+    SV* tuple_status
+  PPCODE:
+    {
+      /*
+        Returns the number of tuples, affected rows and errors, or
+        nothing if the statement is not a plain INSERT ... VALUES
+      */
+      IV tuples, rows, errors;
+      D_imp_sth(sth);
+
+      if (mysql_st_execute_for_fetch(sth, imp_sth, fetch_tuple_sub,
+                                     tuple_status, &tuples, &rows,
+                                     &errors) < 0)
+        XSRETURN_EMPTY;
+      EXTEND(SP, 3);
+      PUSHs(sv_2mortal(newSViv(tuples)));
+      PUSHs(sv_2mortal(newSViv(rows)));
+      PUSHs(sv_2mortal(newSViv(errors)));
+    }
+
+void
+_fetchall_arrayref(sth, columns = Nullsv, names = Nullsv, max_rows = Nullsv)
+    SV* sth
+    SV* columns
+    SV* names
+    SV* max_rows
+  PPCODE:
+    {
+      /*
+        The rows as arrays of the given columns, or as hashes if names
+        are given too
+      */
+      D_imp_sth(sth);
+      AV *columns_av= columns && SvROK(columns) ? (AV *) SvRV(columns) : NULL;
+      AV *names_av= names && SvROK(names) ? (AV *) SvRV(names) : NULL;
+
+      XPUSHs(mysql_st_fetchall_arrayref(sth, imp_sth, columns_av, names_av,
+                                        max_rows && SvOK(max_rows) ?
+                                        SvIV(max_rows) : -1));
+    }
+
+void
+mysql_fetch_columns(sth, attr = Nullsv)
+    SV* sth
+    SV* attr
+  PPCODE:
+    {
+      /*
+        The remaining rows as an array of columns, or as a hash of them
+        with Slice => {}; MaxRows limits the number of rows
+      */
+      D_imp_sth(sth);
+      HV *hv= attr && SvROK(attr) && SvTYPE(SvRV(attr)) == SVt_PVHV ?
+        (HV *) SvRV(attr) : NULL;
+      SV **svp;
+      bool as_hash= FALSE;
+      IV max_rows= -1;
+
+      if (hv)
+      {
+        if ((svp= hv_fetch(hv, "Slice", 5, FALSE)) && SvROK(*svp) &&
+            SvTYPE(SvRV(*svp)) == SVt_PVHV)
+          as_hash= TRUE;
+        if ((svp= hv_fetch(hv, "MaxRows", 7, FALSE)) && SvOK(*svp))
+          max_rows= SvIV(*svp);
+      }
+      XPUSHs(mysql_st_fetch_columns(sth, imp_sth, as_hash, max_rows));
+    }
+
 void _async_check(sth)
     SV* sth
   PPCODE:
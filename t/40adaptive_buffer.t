@@ -0,0 +1,44 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 10;
+
+my $table = 'dbd_mysql_t40adaptive_buffer';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(200), body TEXT)");
+
+# short values, values beyond the limit, and NULLs
+my @rows = map { [ $_, 'n' x ($_ * 7 % 60), $_ % 5 ? 'b' x ($_ * 37) : undef ] }
+  1 .. 50;
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, @$_) for @rows;
+
+my $select = "SELECT id, name, body FROM $table WHERE id >= ? ORDER BY id";
+my $sth = $dbh->prepare($select, { mysql_server_prepare => 1,
+                                   mysql_adaptive_buffer_limit => 64 });
+is $sth->{mysql_adaptive_buffer_limit}, 64, "limit set by prepare";
+
+ok $sth->execute(1), "execute";
+is_deeply $sth->fetchall_arrayref, \@rows, "all values";
+ok $sth->execute(25), "execute again";
+is_deeply $sth->fetchall_arrayref, [ @rows[24 .. 49] ],
+  "values with the buffers of the first execute";
+
+$sth->{mysql_adaptive_buffer_limit} = 1;
+is $sth->{mysql_adaptive_buffer_limit}, 1, "limit set";
+$sth->execute(1);
+is_deeply $sth->fetchall_arrayref, \@rows, "values fetched in a second step";
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,73 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 3 + 2 * 7 + 4;
+
+my $table = 'dbd_mysql_t40blob_read';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, body LONGBLOB, note TEXT)");
+
+my $body = join '', map { chr(($_ * 7) % 256) } 1 .. 300_000;
+ok $dbh->do("INSERT INTO $table VALUES (1, ?, 'short'), (2, NULL, NULL)",
+            undef, $body);
+
+sub read_chunks {
+  my ($sth, $field, $size) = @_;
+  my ($data, $offset, $calls) = ('', 0, 0);
+  while (defined(my $chunk = $sth->blob_read($field, $offset, $size))) {
+    $data .= $chunk;
+    $offset += length $chunk;
+    $calls++;
+  }
+  return ($data, $calls);
+}
+
+for my $server_prepare (0, 1) {
+  my $sth = $dbh->prepare("SELECT id, body, note FROM $table ORDER BY id",
+                          { mysql_server_prepare => $server_prepare });
+  $sth->execute;
+  my $row = $sth->fetchrow_arrayref;
+  my ($data, $calls) = read_chunks($sth, 1, 65536);
+  ok $data eq $body, "blob read in chunks, server_prepare=$server_prepare";
+  is $calls, 5, "chunks of 64k";
+  is $sth->blob_read(2, 1, 3), 'hor', "part of a short column";
+
+  my $dest = 'xx';
+  $sth->blob_read(2, 0, 5, \$dest, 2);
+  is $dest, 'xxshort', "destination offset";
+
+  $row = $sth->fetchrow_arrayref;
+  ok !defined $sth->blob_read(1, 0, 100), "NULL reads as undef";
+  ok !$sth->err, "without an error";
+  $sth->finish;
+
+  local $sth->{RaiseError} = 0;
+  ok !defined $sth->blob_read(1, 0, 100) && $sth->err,
+    "blob_read after finish";
+}
+
+my $sth = $dbh->prepare("SELECT id, body, note FROM $table ORDER BY id",
+                        { mysql_server_prepare => 1,
+                          mysql_defer_blobs => 1 });
+ok $sth->{mysql_defer_blobs}, "mysql_defer_blobs set by prepare";
+$sth->execute;
+my $row = $sth->fetchrow_arrayref;
+ok !defined $row->[1] && $row->[0] == 1, "deferred column is not fetched";
+my ($data) = read_chunks($sth, 1, 100_000);
+ok $data eq $body, "deferred column read by blob_read";
+$sth->finish;
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
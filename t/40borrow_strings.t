@@ -0,0 +1,88 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 17;
+
+my $table = 'dbd_mysql_t40borrow_strings';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), note TEXT)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_  ",
+         $_ % 2 ? "note $_" : undef)
+  for 1 .. 10;
+
+my $sth = $dbh->prepare("SELECT id, name, note FROM $table ORDER BY id",
+                        { mysql_borrow_strings => 1 });
+ok $sth->{mysql_borrow_strings}, "attribute set by prepare";
+$sth->execute;
+
+my ($row, @names, $copy);
+while ($row = $sth->fetchrow_arrayref) {
+  push @names, $row->[1];
+  $copy = $row->[1] if $row->[0] == 3;
+  last if $row->[0] == 4;
+}
+is_deeply \@names, [ map { "name $_  " } 1 .. 4 ], "values of rows";
+is $row->[2], undef, "NULL";
+ok !eval { $row->[1] =~ s/name/other/; 1 }, "borrowed values are read-only";
+$row = $sth->fetchrow_arrayref;
+is_deeply [ @$row ], [ 5, "name 5  ", "note 5" ], "next row";
+ok !Internals::SvREADONLY($row->[0]), "numbers are not borrowed";
+$sth->finish;
+is $copy, "name 3  ", "copies are kept";
+
+# Rows of fetchall_arrayref keep the result alive after finish
+$sth->execute;
+my $rows = $sth->fetchall_arrayref;
+$sth->execute;
+$sth->finish;
+is_deeply [ map { $_->[1] } @$rows ], [ map { "name $_  " } 1 .. 10 ],
+  "rows kept after the next execute";
+
+# Bound columns are the caller's own scalars, which get copies
+my ($id, $name, $note, @bound);
+$sth->execute;
+$sth->bind_columns(\($id, $name, $note));
+push @bound, $name while $sth->fetch;
+is_deeply \@bound, [ map { "name $_  " } 1 .. 10 ], "bound columns";
+ok eval { chomp $name; $name = 'x'; 1 }, "bound columns are writable";
+
+# finish gives the values of the last row their own strings
+$sth = $dbh->prepare("SELECT id, name, note FROM $table ORDER BY id",
+                     { mysql_borrow_strings => 1 });
+$sth->execute;
+$row = $sth->fetchrow_arrayref;
+$sth->finish;
+ok !Internals::SvREADONLY($row->[1]) && $row->[1] eq "name 1  ",
+  "finish releases the row";
+
+# ChopBlanks values are copied as before
+$sth->{ChopBlanks} = 1;
+$sth->execute;
+$row = $sth->fetchrow_arrayref;
+is $row->[1], "name 1", "ChopBlanks";
+$row->[1] .= "x";
+$sth->finish;
+
+# and switching it off gives plain values again
+$sth->{ChopBlanks} = 0;
+$sth->{mysql_borrow_strings} = 0;
+ok !$sth->{mysql_borrow_strings}, "attribute unset";
+$sth->execute;
+$row = $sth->fetchrow_arrayref;
+ok eval { $row->[1] .= "x"; 1 }, "values are writable again";
+$sth->finish;
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
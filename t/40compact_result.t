@@ -0,0 +1,61 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 17;
+
+my $table = 'dbd_mysql_t40compact_result';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), note TEXT)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_",
+         $_ % 5 ? 'x' x ($_ % 300) : undef)
+  for 1 .. 1000;
+
+my $select = "SELECT id, name, note FROM $table ORDER BY id";
+my $expected = $dbh->selectall_arrayref($select);
+my $max_length = $dbh->prepare($select);
+$max_length->execute;
+
+my $sth = $dbh->prepare($select, { mysql_compact_result => 1 });
+ok $sth->{mysql_compact_result}, "attribute set by prepare";
+ok !defined $sth->{mysql_result_memory}, "no memory before execute";
+
+is $sth->execute, 1000, "rows returned by execute";
+is $sth->rows, 1000, "rows";
+ok $sth->{mysql_result_memory} > 0, "memory of the result";
+is_deeply $sth->{mysql_max_length}, $max_length->{mysql_max_length},
+  "max_length as for a stored result";
+$max_length->finish;
+is_deeply $sth->fetchall_arrayref, $expected, "rows of the result";
+
+# seeks into and within the rows between two indexed ones
+for my $pos (0, 31, 32, 517, 999) {
+  $sth->execute;
+  $sth->func($pos, 'dataseek');
+  is $sth->fetchrow_arrayref->[0], $pos + 1, "dataseek to row $pos";
+  $sth->finish;
+}
+
+$sth->execute;
+$sth->fetchrow_arrayref for 1 .. 10;
+$sth->func(1000, 'dataseek');
+ok !$sth->fetchrow_arrayref, "dataseek past the last row";
+
+$sth = $dbh->prepare("SELECT * FROM $table WHERE id < 0",
+                     { mysql_compact_result => 1 });
+$sth->execute;
+ok !$sth->fetchrow_arrayref, "empty result";
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
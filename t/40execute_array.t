@@ -0,0 +1,88 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1,
+                        mysql_server_prepare => 0 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 26;
+
+my $table = 'dbd_mysql_t40execute_array';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT PRIMARY KEY, name VARCHAR(64))");
+
+my $sth = $dbh->prepare(
+  "INSERT INTO $table (id, name) VALUES (?, CONCAT('name ', ?))");
+
+# enough rows to need a few multi-row statements
+my @ids = (1 .. 5000);
+my @names = map { "it's \"$_\"" } @ids;
+$names[9] = undef;
+my @status;
+my ($tuples, $rows) = $sth->execute_array(
+  { ArrayTupleStatus => \@status }, \@ids, \@names);
+is $tuples, 5000, 'all tuples executed';
+is $rows, 5000, 'affected rows';
+is scalar(@status), 5000, 'a status for each tuple';
+ok !(grep { !defined $_ || ref $_ } @status), 'no tuple failed';
+
+my ($count) = $dbh->selectrow_array("SELECT COUNT(*) FROM $table");
+is $count, 5000, 'rows inserted';
+my ($name) = $dbh->selectrow_array("SELECT name FROM $table WHERE id = 42");
+is $name, q{name it's "42"}, 'values escaped';
+($name) = $dbh->selectrow_array("SELECT name FROM $table WHERE id = 10");
+is $name, undef, 'NULL value';
+
+# a duplicate key fails the tuples sent along with it, and only those
+$dbh->{RaiseError} = 0;
+@status = ();
+$tuples = $sth->execute_array(
+  { ArrayTupleStatus => \@status }, [5001, 5002, 1], ['a', 'b', 'c']);
+ok !defined $tuples, 'execute_array fails';
+like $sth->errstr, qr/executing 3 generated 3 errors/, 'error count';
+is ref $status[2], 'ARRAY', 'failed tuple status';
+like $status[2][1], qr/Duplicate/, 'status has the error message';
+
+# statements which are not plain INSERT ... VALUES use DBI's fallback
+my $update = $dbh->prepare("UPDATE $table SET name = ? WHERE id = ?");
+$tuples = $update->execute_array({}, ['x', 'y'], [1, 2]);
+is $tuples, 2, 'UPDATE tuples executed';
+($count) = $dbh->selectrow_array("SELECT COUNT(*) FROM $table WHERE name IN ('x', 'y')");
+is $count, 2, 'UPDATE applied';
+
+# server side prepared statements are sent in bulk on MariaDB, and
+# executed tuple by tuple otherwise
+$dbh->{RaiseError} = 1;
+ok $dbh->do("DELETE FROM $table");
+$sth = $dbh->prepare("INSERT INTO $table (id, name) VALUES (?, ?)",
+                     { mysql_server_prepare => 1 });
+@status = ();
+($tuples, $rows) = $sth->execute_array(
+  { ArrayTupleStatus => \@status }, [1 .. 2500], [undef, map { "n$_" } 2 .. 2500]);
+is $tuples, 2500, 'server side prepared tuples executed';
+is scalar(@status), 2500, 'a status for each server side prepared tuple';
+($count) = $dbh->selectrow_array("SELECT COUNT(*) FROM $table WHERE name IS NULL OR name = CONCAT('n', id)");
+is $count, 2500, 'server side prepared rows inserted';
+ok $sth->execute(2501, 'single'), 'execute after execute_array';
+
+# mysql_insertid is the id of the first row of the multi-row INSERT
+my $auto = "${table}_auto";
+ok $dbh->do("DROP TABLE IF EXISTS $auto");
+ok $dbh->do("CREATE TABLE $auto (id INT AUTO_INCREMENT PRIMARY KEY, name VARCHAR(64))");
+$sth = $dbh->prepare("INSERT INTO $auto (name) VALUES (?)");
+is $sth->execute_array({}, ['a', 'b', 'c']), 3, 'AUTO_INCREMENT tuples executed';
+my ($first) = $dbh->selectrow_array("SELECT MIN(id) FROM $auto");
+is $sth->{mysql_insertid}, $first, 'mysql_insertid of the first row';
+ok $dbh->do("DROP TABLE $auto");
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,52 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 3 * 6;
+
+my $table = 'dbd_mysql_t40fetch_columns';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT UNSIGNED, Name CHAR(10), value DOUBLE)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_,
+         $_ % 100 ? "name $_" : undef, $_ / 4)
+  for 1 .. 1000;
+
+for my $attr ({ mysql_server_prepare => 0 }, { mysql_server_prepare => 1 },
+              { mysql_use_result => 1 }) {
+  my ($what) = %$attr;
+  my $sth = $dbh->prepare(
+    "SELECT id, Name, value FROM $table ORDER BY id", $attr);
+
+  $sth->execute;
+  my $columns = $sth->mysql_fetch_columns;
+  is scalar(@$columns), 3, "array of columns ($what)";
+  is_deeply [ map { scalar @$_ } @$columns ], [1000, 1000, 1000],
+    "all rows ($what)";
+  is_deeply [ map { $_->[99] } @$columns ], [100, undef, 25],
+    "values and NULL ($what)";
+  ok !$sth->{Active}, "statement finished ($what)";
+
+  $sth->execute;
+  local $sth->{FetchHashKeyName} = 'NAME_lc';
+  my @ids;
+  while (my $batch = $sth->mysql_fetch_columns({ Slice => {}, MaxRows => 300 })) {
+    push @ids, scalar @{ $batch->{id} };
+    is $batch->{name}[0], 'name 301', "hash of columns ($what)"
+      if $batch->{id}[0] == 301;
+  }
+  is_deeply \@ids, [300, 300, 300, 100], "batches of MaxRows ($what)";
+}
+
+$dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,93 @@
+use strict;
+use warnings;
+
+use DBI;
+use File::Temp qw(tempfile);
+use Test::More;
+use Time::HiRes qw(time);
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1,
+                        mysql_enable_utf8 => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 2 * 2 * 2 * 3 + 2;
+
+# A result of 20 columns: an id, strings with trailing blanks, integers
+# and floats, fetched with every combination of server side prepare,
+# ChopBlanks and mysql_enable_utf8 the fetch kernels are compiled for.
+# The time per row of each is only noted, for comparing builds by hand:
+# the generic loop is gone, so there is no baseline to measure against.
+my $table = 'dbd_mysql_t40fetch_kernels';
+my @strings = map { "s$_" } 1 .. 7;
+my @ints = map { "i$_" } 1 .. 6;
+my @doubles = map { "d$_" } 1 .. 6;
+my @columns = ('id', @strings, @ints, @doubles);
+my $rows = 2000;
+
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT UNSIGNED, " .
+            join(', ', (map { "$_ VARCHAR(20) CHARACTER SET utf8" } @strings),
+                       (map { "$_ BIGINT" } @ints),
+                       (map { "$_ DOUBLE" } @doubles)) . ")");
+my $insert = $dbh->prepare("INSERT INTO $table VALUES (" .
+                           join(', ', ('?') x @columns) . ")");
+$dbh->begin_work;
+$insert->execute($_, ("v\x{e4}l $_  ") x @strings, (-$_) x @ints,
+                 ($_ / 8) x @doubles)
+  for 1 .. $rows;
+$dbh->commit;
+
+my $select = "SELECT " . join(', ', @columns) . " FROM $table ORDER BY id";
+my %usec;
+
+for my $server_prepare (0, 1) {
+  for my $utf8 (0, 1) {
+    my $dbh = DBI->connect($test_dsn, $test_user, $test_password,
+                           { RaiseError => 1, PrintError => 0,
+                             mysql_server_prepare => $server_prepare,
+                             mysql_enable_utf8 => $utf8 });
+    $dbh->do("SET NAMES utf8");
+    for my $chop (0, 1) {
+      my $what = "server_prepare=$server_prepare utf8=$utf8 ChopBlanks=$chop";
+      my $sth = $dbh->prepare($select);
+      $sth->{ChopBlanks} = $chop;
+      $sth->execute;
+
+      my $start = time;
+      my ($count, $last) = (0);
+      while (my $row = $sth->fetchrow_arrayref) {
+        $count++;
+        $last = [ @$row ] if $count == 10;
+      }
+      $usec{$what} = (time - $start) * 1e6 / $rows;
+      note sprintf "%s: %.2f usec per row of 20 columns", $what, $usec{$what};
+
+      is $count, $rows, "all rows ($what)";
+      my $string = $utf8 ? "v\x{e4}l 10" : "v\xc3\xa4l 10";
+      $string .= '  ' unless $chop;
+      is_deeply $last, [ 10, ($string) x @strings, (-10) x @ints,
+                         (1.25) x @doubles ], "values ($what)";
+      is utf8::is_utf8($last->[1]) ? 1 : 0, $utf8, "utf8 flag ($what)";
+    }
+    $dbh->disconnect;
+  }
+}
+
+# With tracing on, the traced kernels are used and give the same values
+my ($fh, $trace_file) = tempfile(UNLINK => 1);
+my $sth = $dbh->prepare($select . " LIMIT 1", { mysql_server_prepare => 1 });
+$sth->execute;
+$sth->trace(2, $trace_file);
+my $row = $sth->fetchrow_arrayref;
+$sth->trace(0);
+is_deeply [ @$row[0, 7, 13] ], [ 1, -1, 0.125 ], "values while tracing";
+$sth->finish;
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,82 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 2 * 14;
+
+my $table = 'dbd_mysql_t40fetchall_arrayref';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), value DOUBLE)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_", $_ / 2)
+  for 1 .. 10;
+
+for my $server_prepare (0, 1) {
+  local $dbh->{mysql_server_prepare} = $server_prepare;
+  my $select = "SELECT id, name, value FROM $table ORDER BY id";
+
+  my $sth = $dbh->prepare($select);
+  $sth->execute;
+  my $rows = $sth->fetchall_arrayref;
+  is_deeply $rows->[2], [3, 'name 3', 1.5], "all columns ($server_prepare)";
+  is scalar(@$rows), 10, "all rows ($server_prepare)";
+  isnt $rows->[0], $rows->[1], "each row is an array of its own ($server_prepare)";
+  {
+    # as in DBI: no rows left, and the fetch reports the finished statement
+    local $sth->{RaiseError} = 0;
+    is_deeply $sth->fetchall_arrayref, [],
+      "fetchall_arrayref after the last row ($server_prepare)";
+    ok $sth->err, "fetch from a finished statement reported ($server_prepare)";
+  }
+
+  $sth->execute;
+  $rows = $sth->fetchall_arrayref([2, 0, -2, 5]);
+  is_deeply $rows->[0], [0.5, 1, 'name 1', undef], "array slice ($server_prepare)";
+
+  $sth->execute;
+  $rows = $sth->fetchall_arrayref({});
+  is_deeply $rows->[9], { id => 10, name => 'name 10', value => 5 },
+    "hash rows ($server_prepare)";
+
+  $sth->execute;
+  $rows = $sth->fetchall_arrayref({ NAME => 1, id => 1 });
+  is_deeply $rows->[1], { NAME => 'name 2', id => 2 },
+    "hash slice ($server_prepare)";
+
+  $sth->execute;
+  $rows = $sth->fetchall_arrayref(\{ 1 => 'n' });
+  is_deeply $rows->[0], { n => 'name 1' }, "renaming slice ($server_prepare)";
+
+  $sth->execute;
+  my @batches;
+  while (my $batch = $sth->fetchall_arrayref([0], 4)) {
+    push @batches, [ map { $_->[0] } @$batch ];
+  }
+  is_deeply \@batches, [[1 .. 4], [5 .. 8], [9, 10]],
+    "batches of max_rows ($server_prepare)";
+
+  $sth->execute;
+  my $ok = eval { $sth->fetchall_arrayref({ nope => 1 }); 1 };
+  like $@, qr/Invalid column name 'nope'/, "unknown column ($server_prepare)";
+  $sth->finish;
+
+  $rows = $dbh->selectall_arrayref($select, { Slice => {} });
+  is $rows->[4]{name}, 'name 5', "selectall_arrayref Slice ($server_prepare)";
+  $rows = $dbh->selectall_arrayref($select, { Columns => [2] });
+  is_deeply $rows->[0], ['name 1'], "selectall_arrayref Columns ($server_prepare)";
+  $rows = $dbh->selectall_arrayref($select, { MaxRows => 3 });
+  is scalar(@$rows), 3, "selectall_arrayref MaxRows ($server_prepare)";
+}
+
+$dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,77 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+$test_dsn.= ";mysql_local_infile=1";
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+my ($local_infile) = $dbh->selectrow_array('SELECT @@local_infile');
+if (!$local_infile) {
+    plan skip_all => "server does not allow LOAD DATA LOCAL";
+}
+plan tests => 13;
+
+my $table = 'dbd_mysql_t40local_infile';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT PRIMARY KEY, name VARCHAR(64))");
+
+my $load = "LOAD DATA LOCAL INFILE 'ignored' INTO TABLE $table";
+
+# a scalar buffer
+my $data = "1\tone\n2\ttwo\n";
+{
+  local $dbh->{mysql_local_infile_source} = \$data;
+  is ref $dbh->{mysql_local_infile_source}, 'SCALAR', 'source is stored';
+  is $dbh->do($load), 2, 'rows loaded from a scalar';
+}
+ok !defined $dbh->{mysql_local_infile_source}, 'source is reset';
+
+# a file handle
+open my $fh, '<', \"3\tthree\n" or die $!;
+{
+  local $dbh->{mysql_local_infile_source} = $fh;
+  is $dbh->do($load), 1, 'rows loaded from a file handle';
+}
+
+# rows from a code ref, enough to need more than one read
+my @names = ("tab\there", "new\nline", "back\\slash", undef);
+my $id = 3;
+{
+  local $dbh->{mysql_local_infile_source} = sub {
+    return if $id >= 5003;
+    $id++;
+    return [ $id, $names[$id % 4] ];
+  };
+  is $dbh->do($load), 5000, 'rows loaded from a code ref';
+}
+my $rows = $dbh->selectall_hashref(
+  "SELECT id, name FROM $table WHERE id BETWEEN 4 AND 7", 'id');
+is_deeply [ map { $rows->{$_}{name} } 4 .. 7 ], [ @names ],
+  'values escaped and NULL loaded';
+
+# errors of the code ref fail the statement
+{
+  local $dbh->{mysql_local_infile_source} = sub { die "no more rows\n" };
+  local $dbh->{RaiseError} = 0;
+  ok !$dbh->do($load), 'LOAD DATA fails';
+  like $dbh->errstr, qr/no more rows/, 'with the error of the code ref';
+}
+
+eval { $dbh->{mysql_local_infile_source} = [] };
+like $@, qr/mysql_local_infile_source must be/, 'array refs are refused';
+
+my ($count) = $dbh->selectrow_array("SELECT COUNT(*) FROM $table");
+is $count, 5003, 'all rows loaded';
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,114 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 25;
+
+my $table = 'dbd_mysql_t40prefetch_rows';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), note TEXT)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_",
+         $_ % 7 ? 'x' x ($_ % 300) : undef)
+  for 1 .. 3000;
+
+my $select = "SELECT id, name, note FROM $table ORDER BY id";
+my $expected = $dbh->selectall_arrayref($select);
+
+my $sth = $dbh->prepare($select, { mysql_use_result => 1,
+                                   mysql_prefetch_rows => 16 });
+is $sth->{mysql_prefetch_rows}, 16, "attribute set by prepare";
+
+$sth->execute;
+my @rows;
+while (my $row = $sth->fetchrow_arrayref) {
+  push @rows, [ @$row ];
+}
+is_deeply \@rows, $expected, "rows fetched while read ahead";
+ok !$sth->{Active}, "statement finished";
+
+$sth->execute;
+is_deeply $sth->fetchall_arrayref, $expected, "fetchall_arrayref";
+
+$sth->execute;
+my $columns = $sth->mysql_fetch_columns;
+is_deeply $columns->[0], [ map { $_->[0] } @$expected ], "mysql_fetch_columns";
+
+# finish cancels reading ahead, the connection can be used again
+$sth->execute;
+$sth->fetchrow_arrayref for 1 .. 10;
+ok $sth->finish, "finish while reading ahead";
+is_deeply $dbh->selectrow_arrayref("SELECT 1"), [1], "connection usable";
+
+# a ring of one row
+$sth->{mysql_prefetch_rows} = 1;
+$sth->execute;
+is scalar(@{ $sth->fetchall_arrayref }), 3000, "one row read ahead";
+
+# ignored without mysql_use_result
+$sth = $dbh->prepare($select, { mysql_prefetch_rows => 16 });
+$sth->execute;
+is scalar(@{ $sth->fetchall_arrayref }), 3000, "stored result";
+
+# Other handles stop the thread before they use the connection, which is
+# then busy until the rest of the result is read. Attributes are set
+# before, as storing one stops the thread too.
+my $busy = qr/out of sync/i;
+my $reader = $dbh->prepare($select, { mysql_use_result => 1,
+                                      mysql_prefetch_rows => 16 });
+my $insert = $dbh->prepare("INSERT INTO $table VALUES (?, ?, NULL)");
+my ($tuples, @status);
+$dbh->{RaiseError} = 0;
+$insert->{RaiseError} = 0;
+my $stops = $dbh->{mysql_dbd_stats}->{prefetch_stops};
+$reader->execute;
+@rows = map { [ @{ $reader->fetchrow_arrayref } ] } 1 .. 10;
+
+$dbh->{AutoCommit} = 0;
+like $dbh->errstr, qr/Turning off AutoCommit failed/,
+  "AutoCommit fails while the result is read";
+is $dbh->{mysql_dbd_stats}->{prefetch_stops}, $stops + 1,
+  "thread stopped and joined";
+ok $dbh->{AutoCommit}, "AutoCommit unchanged";
+
+$tuples = $insert->execute_array({ ArrayTupleStatus => \@status },
+                                 [ 3001, 3002 ], [ 'a', 'b' ]);
+ok !defined $tuples, "execute_array fails while the result is read";
+is scalar(grep { ref $_ && $_->[1] =~ $busy } @status), 2,
+  "each tuple failed as out of sync";
+
+is $dbh->{mysql_stat}, undef, "mysql_stat fails while the result is read";
+
+while (my $row = $reader->fetchrow_arrayref) {
+  push @rows, [ @$row ];
+}
+ok !$reader->err, "no error left for the reader";
+is_deeply \@rows, $expected, "rows intact after using the connection";
+is $dbh->{mysql_dbd_stats}->{prefetch_stops}, $stops + 1,
+  "thread stopped only once";
+
+$dbh->{RaiseError} = 1;
+$insert->{RaiseError} = 1;
+$dbh->{AutoCommit} = 0;
+ok !$dbh->{AutoCommit}, "AutoCommit after the result";
+$dbh->{AutoCommit} = 1;
+$tuples = $insert->execute_array({ ArrayTupleStatus => \@status },
+                                 [ 3003, 3004 ], [ 'c', 'd' ]);
+is $tuples, 2, "execute_array after the result";
+like $dbh->{mysql_stat}, qr/Uptime/, "mysql_stat after the result";
+is_deeply $dbh->selectcol_arrayref(
+  "SELECT id FROM $table WHERE id > 3000 ORDER BY id"), [ 3003, 3004 ],
+  "only the rows inserted after the result";
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
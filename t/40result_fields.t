@@ -0,0 +1,63 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 * 12 + 1;
+
+my $table = 'dbd_mysql_t40result_fields';
+my $utf8_dbh = DBI->connect($test_dsn, $test_user, $test_password,
+                            { RaiseError => 1, PrintError => 0,
+                              mysql_enable_utf8 => 1 });
+
+for my $server_prepare (0, 1) {
+  $dbh->do("DROP TABLE IF EXISTS $table");
+  ok $dbh->do("CREATE TABLE $table (id INT, val VARCHAR(20))");
+  $dbh->do("INSERT INTO $table VALUES (1, '1.5'), (2, '2.25')");
+
+  my $sth = $dbh->prepare("SELECT id, val FROM $table WHERE id = ?",
+                          { mysql_server_prepare => $server_prepare });
+  ok $sth->execute(1), "execute, server_prepare=$server_prepare";
+  is_deeply $sth->fetchrow_arrayref, [1, '1.5'], "first row";
+  my $types = $sth->{mysql_type};
+
+  # the same fields: the description of the first result is used
+  ok $sth->execute(2), "execute again";
+  is_deeply $sth->fetchrow_arrayref, [2, '2.25'], "second row";
+  is_deeply $sth->{mysql_type}, $types, "same types";
+  is $sth->{mysql_max_length}->[1], 4, "max_length of the second result";
+
+  # other fields: described again
+  ok $dbh->do("ALTER TABLE $table MODIFY val DOUBLE");
+  ok $sth->execute(2), "execute after the table changed";
+  my $row = $sth->fetchrow_arrayref;
+  ok $row->[1] == 2.25 && $sth->{mysql_type}->[1] != $types->[1],
+    "column of the new type";
+  $sth->finish;
+
+  # decoding follows mysql_enable_utf8 of the next execute
+  $sth = $utf8_dbh->prepare("SELECT CONVERT(X'C3A9' USING utf8)",
+                            { mysql_server_prepare => $server_prepare });
+  $sth->execute;
+  ok utf8::is_utf8($sth->fetchrow_arrayref->[0]), "decoded";
+  $utf8_dbh->{mysql_enable_utf8} = 0;
+  $sth->execute;
+  ok !utf8::is_utf8($sth->fetchrow_arrayref->[0]),
+    "not decoded after mysql_enable_utf8 was switched off";
+  $utf8_dbh->{mysql_enable_utf8} = 1;
+  $sth->finish;
+}
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
+$utf8_dbh->disconnect;
@@ -0,0 +1,60 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 15;
+
+my $table = 'dbd_mysql_t40result_spill';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), note TEXT)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_",
+         $_ % 5 ? 'x' x ($_ % 1000) : undef)
+  for 1 .. 2000;
+
+my $select = "SELECT id, name, note FROM $table ORDER BY id";
+my $expected = $dbh->selectall_arrayref($select);
+
+my $sth = $dbh->prepare($select, { mysql_result_spill_bytes => 100_000 });
+is $sth->{mysql_result_spill_bytes}, 100_000, "attribute set by prepare";
+is $sth->execute, 2000, "rows returned by execute";
+is $sth->rows, 2000, "rows";
+
+SKIP: {
+  skip "results are not spilled on Windows", 2 if $^O eq 'MSWin32';
+  ok $sth->{mysql_result_spilled} > 100_000, "result moved to a file";
+  ok $sth->{mysql_result_memory} < 100_000, "and out of memory";
+}
+is_deeply $sth->fetchall_arrayref, $expected, "rows of the spilled result";
+
+for my $pos (0, 1000, 1999) {
+  $sth->execute;
+  $sth->func($pos, 'dataseek');
+  is $sth->fetchrow_arrayref->[0], $pos + 1, "dataseek to row $pos";
+  $sth->finish;
+}
+
+# the connection is free as soon as execute returns
+$sth->execute;
+is_deeply $dbh->selectrow_arrayref("SELECT 1"), [1],
+  "connection usable before the rows are fetched";
+$sth->finish;
+
+# below the limit the rows stay in memory
+$sth->{mysql_result_spill_bytes} = 1 << 30;
+$sth->execute;
+is $sth->{mysql_result_spilled}, 0, "small result not spilled";
+is_deeply $sth->fetchall_arrayref, $expected, "rows of the result in memory";
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
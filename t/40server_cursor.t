@@ -0,0 +1,73 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 16;
+
+my $table = 'dbd_mysql_t40server_cursor';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64), note TEXT)");
+$dbh->do("INSERT INTO $table VALUES (?, ?, ?)", undef, $_, "name $_",
+         $_ % 7 ? 'x' x ($_ % 300) : undef)
+  for 1 .. 2000;
+
+my $select = "SELECT id, name, note FROM $table WHERE id > ? ORDER BY id";
+my $expected = $dbh->selectall_arrayref($select, undef, 0);
+
+my $sth = $dbh->prepare($select, { mysql_server_prepare => 1,
+                                   mysql_server_cursor => 1,
+                                   mysql_cursor_prefetch_rows => 100 });
+ok $sth->{mysql_server_cursor}, "cursor set by prepare";
+is $sth->{mysql_cursor_prefetch_rows}, 100, "prefetch rows set by prepare";
+
+$sth->execute(0);
+my @rows;
+while (my $row = $sth->fetchrow_arrayref) {
+  push @rows, [ @$row ];
+}
+is_deeply \@rows, $expected, "rows fetched through the cursor";
+ok !$sth->{Active}, "statement finished";
+
+# the rows stay on the server, the connection is free between fetches
+$sth->execute(1000);
+is $sth->fetchrow_arrayref->[0], 1001, "first row of the cursor";
+is_deeply $dbh->selectrow_arrayref("SELECT 1"), [1],
+  "connection usable while the cursor is open";
+is $sth->fetchrow_arrayref->[0], 1002, "next row of the cursor";
+ok $sth->finish, "finish closes the cursor";
+
+# the library default of one row per fetch
+$sth->{mysql_cursor_prefetch_rows} = 0;
+$sth->execute(0);
+is scalar(@{ $sth->fetchall_arrayref }), 2000, "one row per fetch";
+
+# a cached statement handed to a statement without a cursor
+$sth = $dbh->prepare($select, { mysql_server_prepare => 1 });
+$sth->execute(0);
+is_deeply $sth->fetchall_arrayref, $expected, "stored result";
+
+# unbuffered server side prepared statement
+$sth = $dbh->prepare($select, { mysql_server_prepare => 1,
+                                mysql_use_result => 1 });
+$sth->execute(0);
+is_deeply $sth->fetchall_arrayref, $expected,
+  "mysql_use_result with server side prepare";
+
+$sth->execute(0);
+$sth->fetchrow_arrayref for 1 .. 10;
+ok $sth->finish, "finish while streaming";
+is_deeply $dbh->selectrow_arrayref("SELECT 1"), [1], "connection usable";
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
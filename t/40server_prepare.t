@@ -18,7 +18,7 @@ eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
 if ($@) {
     plan skip_all => "no database connection";
 }
-plan tests => 31;
+plan tests => 35;
 
 ok(defined $dbh, "connecting");
 
@@ -93,6 +93,15 @@ ok($sth4 = $dbh->prepare("USE $dbname"), 'USE is supported with mysql_server_pre
 ok($sth4->execute());
 ok($sth4->finish());
 
+# the server is not asked to prepare it again
+my $hits = $dbh->{mysql_dbd_stats}->{unsupported_ps_hits};
+ok($dbh->prepare("USE $dbname")->execute(), 'USE prepared again');
+ok($dbh->do("USE $dbname"), 'USE by do()');
+is($dbh->{mysql_dbd_stats}->{unsupported_ps_hits}, $hits + 2,
+   'USE emulated without trying to prepare it');
+is($dbh->{mysql_dbd_stats}->{unsupported_ps_count}, 1,
+   'one statement not supported');
+
 ok ($dbh->do(qq{DROP TABLE t3}), "cleaning up");
 
 $dbh->disconnect();
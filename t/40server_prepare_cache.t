@@ -0,0 +1,98 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib '.', 't';
+require 'lib.pl';
+
+use vars qw($test_dsn $test_user $test_password);
+
+my $use_dsn = "$test_dsn;mysql_server_prepare=1";
+$test_dsn.= ";mysql_server_prepare=1;mysql_server_prepare_disable_fallback=1";
+my $dbh;
+eval {$dbh = DBI->connect($test_dsn, $test_user, $test_password,
+  { RaiseError => 1, AutoCommit => 1, mysql_server_prepare_cache_size => 2 })};
+
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 22;
+
+is $dbh->{mysql_server_prepare_cache_size}, 2, 'cache size from connect';
+
+ok $dbh->do("DROP TABLE IF EXISTS dbd_mysql_t40server_prepare_cache");
+ok $dbh->do("CREATE TABLE dbd_mysql_t40server_prepare_cache (id INT, name VARCHAR(32))");
+
+my $insert = "INSERT INTO dbd_mysql_t40server_prepare_cache VALUES (?, ?)";
+for my $id (1 .. 3) {
+    my $sth = $dbh->prepare($insert);
+    ok $sth->execute($id, "row $id");
+}
+
+my $stats = $dbh->{mysql_dbd_stats};
+is $stats->{prepare_cache_hits}, 2, 'statement reused by prepare()';
+
+ok $dbh->do($insert, undef, 4, 'row 4');
+is $dbh->{mysql_dbd_stats}->{prepare_cache_hits}, 3, 'statement reused by do()';
+
+# a cached statement must not pick up the values of its previous owner
+$dbh->{RaiseError} = 0;
+$dbh->{PrintError} = 0;
+ok !defined $dbh->do($insert), 'do() without bind values fails';
+$dbh->{RaiseError} = 1;
+$dbh->{PrintError} = 1;
+
+# two handles at once cannot share one server side statement
+my $select = "SELECT name FROM dbd_mysql_t40server_prepare_cache WHERE id = ?";
+my $sth1 = $dbh->prepare($select);
+my $sth2 = $dbh->prepare($select);
+ok $sth1->execute(1);
+ok $sth2->execute(2);
+is_deeply $sth1->fetchall_arrayref, [['row 1']];
+is_deeply $sth2->fetchall_arrayref, [['row 2']];
+undef $sth1;
+undef $sth2;
+
+# a third statement evicts the least recently used one
+$dbh->prepare("SELECT 1")->execute;
+$dbh->prepare("SELECT 2")->execute;
+cmp_ok $dbh->{mysql_dbd_stats}->{prepare_cache_evictions}, '>=', 1,
+  'least recently used statement evicted';
+
+# the same text in another default database is another statement
+SKIP: {
+    my $use_dbh = DBI->connect($use_dsn, $test_user, $test_password,
+      { RaiseError => 1, PrintError => 0, AutoCommit => 1,
+        mysql_server_prepare_cache_size => 2 });
+    my $dbname = $use_dbh->selectrow_arrayref("SELECT DATABASE()")->[0];
+    my $other = "dbd_mysql_t40server_prepare_cache_db";
+    skip "cannot create a second database", 3
+      unless eval { $use_dbh->do("DROP DATABASE IF EXISTS $other");
+                    $use_dbh->do("CREATE DATABASE $other"); 1 };
+    $use_dbh->do("CREATE TABLE $other.dbd_mysql_t40server_prepare_cache (id INT, name VARCHAR(32))");
+    $use_dbh->do("INSERT INTO $other.dbd_mysql_t40server_prepare_cache VALUES (1, 'other row 1')");
+
+    my $by_id = "SELECT name FROM dbd_mysql_t40server_prepare_cache WHERE id = 1";
+    is_deeply $use_dbh->selectall_arrayref($by_id), [['row 1']],
+      'statement of the default database';
+    $use_dbh->do("USE $other");
+    is_deeply $use_dbh->selectall_arrayref($by_id), [['other row 1']],
+      'same text after USE reads the other database';
+    $use_dbh->do("USE $dbname");
+    is_deeply $use_dbh->selectall_arrayref($by_id), [['row 1']],
+      'and the first one again after USE back';
+
+    $use_dbh->do("DROP DATABASE $other");
+    $use_dbh->disconnect;
+}
+
+$dbh->{mysql_server_prepare_cache_size} = 0;
+is $dbh->{mysql_server_prepare_cache_size}, 0, 'cache disabled';
+
+my $row = $dbh->selectrow_arrayref(
+  "SELECT COUNT(*) FROM dbd_mysql_t40server_prepare_cache");
+is $row->[0], 4, 'all rows inserted';
+
+ok $dbh->do("DROP TABLE dbd_mysql_t40server_prepare_cache");
+ok $dbh->disconnect();
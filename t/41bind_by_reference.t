@@ -0,0 +1,63 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 2 * 6 + 1;
+
+my $table = 'dbd_mysql_t41bind_by_reference';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, name VARCHAR(64))");
+
+for my $server_prepare (0, 1) {
+  $dbh->do("DELETE FROM $table");
+  my $sql = "INSERT INTO $table VALUES (?, ?)";
+
+  my $sth = $dbh->prepare($sql, { mysql_server_prepare => $server_prepare,
+                                  mysql_bind_by_reference => 1 });
+  ok $sth->{mysql_bind_by_reference}, "set by prepare";
+
+  # bound once, read by every execute
+  my ($id, $name);
+  $sth->bind_param(1, \$id);
+  $sth->bind_param(2, \$name);
+  for (1 .. 3) {
+    ($id, $name) = ($_, "name $_" x $_);
+    $sth->execute;
+  }
+  $name = undef;
+  $id = 4;
+  $sth->execute;
+  is_deeply $dbh->selectall_arrayref("SELECT id, name FROM $table ORDER BY id"),
+    [ [1, 'name 1'], [2, 'name 2name 2'], [3, 'name 3name 3name 3'],
+      [4, undef] ],
+    "values read at execute, server_prepare=$server_prepare";
+
+  # the arguments of execute are not copied either
+  ok $sth->execute(5, 'five'), "execute with values";
+  is $dbh->selectrow_array("SELECT name FROM $table WHERE id = 5"), 'five',
+    "value of execute";
+
+  # copied as usual without the attribute
+  $sth = $dbh->prepare($sql, { mysql_server_prepare => $server_prepare });
+  my $copied = 'before';
+  $sth->bind_param(1, 6);
+  $sth->bind_param(2, $copied);
+  $copied = 'after';
+  ok $sth->execute, "execute without the attribute";
+  is $dbh->selectrow_array("SELECT name FROM $table WHERE id = 6"), 'before',
+    "value copied by bind_param";
+}
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
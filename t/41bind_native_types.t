@@ -0,0 +1,47 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 1, AutoCommit => 1,
+                        mysql_server_prepare => 1,
+                        mysql_bind_native_types => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 12;
+
+is $dbh->{mysql_bind_native_types}, 1, 'attribute set at connect';
+
+ok $dbh->do("DROP TABLE IF EXISTS dbd_mysql_t41bind_native_types");
+ok $dbh->do(<<'EOT');
+CREATE TABLE dbd_mysql_t41bind_native_types (
+  id BIGINT UNSIGNED, val DOUBLE, name VARCHAR(20))
+EOT
+
+my $sth = $dbh->prepare(
+  "INSERT INTO dbd_mysql_t41bind_native_types VALUES (?, ?, ?)");
+ok $sth->{mysql_bind_native_types}, 'inherited by the statement';
+
+my $big = ~0;   # an unsigned integer above the signed range
+ok $sth->execute(1, 2.5, '007'), 'integer, double and numeric string';
+ok $sth->execute($big, -0.125, 42), 'unsigned integer';
+ok $sth->execute('3', '1e3', undef), 'strings stay strings';
+ok $dbh->do("INSERT INTO dbd_mysql_t41bind_native_types VALUES (?, ?, ?)",
+            undef, 4, 0.5, 8), 'do()';
+
+my $rows = $dbh->selectall_arrayref(
+  "SELECT id, val, name FROM dbd_mysql_t41bind_native_types ORDER BY id");
+is_deeply $rows->[0], [1, 2.5, '007'], 'leading zeroes of strings preserved';
+is_deeply $rows->[1], [3, 1000, undef], 'numeric strings converted by server';
+is_deeply $rows->[2], [4, 0.5, 8], 'do() binds numbers';
+is $rows->[3][0], $big, 'unsigned value kept';
+
+$dbh->do("DROP TABLE dbd_mysql_t41bind_native_types");
+$dbh->disconnect;
@@ -0,0 +1,54 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 2 * 8 + 1;
+
+my $columns = 40;
+my $table = 'dbd_mysql_t41execute_values';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, " .
+            join(', ', map { "c$_ VARCHAR(64)" } 1 .. $columns - 1) . ")");
+
+my $insert = "INSERT INTO $table VALUES (" .
+  join(', ', ('?') x $columns) . ")";
+
+for my $server_prepare (0, 1) {
+  $dbh->do("DELETE FROM $table");
+  my $sth = $dbh->prepare($insert, { mysql_server_prepare => $server_prepare });
+
+  # numbers, strings and NULLs, changing from one execute to the next
+  my @rows = (
+    [ 1, map { $_ } 1 .. $columns - 1 ],
+    [ 2, map { "value $_" } 1 .. $columns - 1 ],
+    [ 3, map { $_ % 2 ? undef : 0.5 * $_ } 1 .. $columns - 1 ],
+    [ 4, map { $_ % 3 ? "x" x $_ : undef } 1 .. $columns - 1 ],
+  );
+  ok $sth->execute(@$_), "execute, server_prepare=$server_prepare" for @rows;
+  is_deeply $dbh->selectall_arrayref("SELECT * FROM $table ORDER BY id"),
+    \@rows, "values of each execute";
+
+  # the values of execute replace those bound before
+  $sth->bind_param($_, "bound") for 1 .. $columns;
+  ok $sth->execute(5, ("executed") x ($columns - 1)), "execute after bind_param";
+  is $dbh->selectrow_array("SELECT c1 FROM $table WHERE id = 5"), 'executed',
+    "value of execute";
+
+  local $sth->{RaiseError} = 0;
+  ok !defined $sth->execute(6) && $sth->errstr =~ /1 bind variables/,
+    "wrong number of values";
+}
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
@@ -0,0 +1,70 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 0, AutoCommit => 1 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+plan tests => 2 + 2 * 9 + 2;
+
+my $table = 'dbd_mysql_t41long_data';
+ok $dbh->do("DROP TABLE IF EXISTS $table");
+ok $dbh->do("CREATE TABLE $table (id INT, data LONGBLOB)");
+
+# larger than a chunk, and not a multiple of it
+my $data = join '', map { chr(($_ * 13) % 256) } 1 .. 200_000;
+
+sub stored {
+  my ($id) = @_;
+  return $dbh->selectrow_array("SELECT data FROM $table WHERE id = ?",
+                               undef, $id);
+}
+
+for my $server_prepare (0, 1) {
+  $dbh->do("DELETE FROM $table");
+  my $sth = $dbh->prepare("INSERT INTO $table VALUES (?, ?)",
+                          { mysql_server_prepare => $server_prepare });
+
+  $sth->bind_param(1, 1);
+  $sth->bind_param(2, $data, { mysql_long_data => 1 });
+  ok $sth->execute, "string as long data, server_prepare=$server_prepare";
+  ok stored(1) eq $data, "string stored";
+
+  open my $fh, '<', \$data or die $!;
+  $sth->bind_param(1, 2);
+  $sth->bind_param(2, $fh, { mysql_long_data => 0 });
+  ok $sth->execute, "filehandle";
+  ok stored(2) eq $data, "filehandle read to its end";
+
+  my @chunks = unpack '(a30000)*', $data;
+  my $calls = 0;
+  $sth->bind_param(1, 3);
+  $sth->bind_param(2, sub { $calls++; shift @chunks });
+  ok $sth->execute, "code reference";
+  ok stored(3) eq $data, "code reference called until undef";
+  is $calls, 8, "once per chunk and once more";
+
+  $sth->execute(4, '');
+  is stored(4), '', "empty string";
+
+  $sth->execute(5, undef);
+  ok !defined stored(5), "NULL";
+}
+
+{
+  local $dbh->{RaiseError} = 0;
+  ok !defined $dbh->do("INSERT INTO $table VALUES (?, ?)", undef, 6,
+                       sub { undef }) && $dbh->err,
+    "do() rejects a code reference";
+}
+
+ok $dbh->do("DROP TABLE $table");
+$dbh->disconnect;
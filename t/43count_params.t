@@ -18,7 +18,7 @@ if (!MinimumVersion($dbh, '4.1') ) {
         "SKIP TEST: You must have MySQL version 4.1 and greater for this test to run";
 }
 
-plan tests => 17;
+plan tests => 17 + 34 * 3 + 4;
 
 ok ($dbh->do("DROP TABLE IF EXISTS dbd_mysql_t43count_params"));
 
@@ -59,6 +59,45 @@ ok ($sth = $dbh->prepare("INSERT INTO dbd_mysql_t43count_params (id, name) VALUE
 
 ok ($sth->execute(3, "Charles de Batz de Castelmore, comte d\\'Artagnan"));
 
+# The scanners test 16 bytes at a time: quotes, comments, placeholders
+# and LIMIT at every offset around those blocks
+for my $pad (0 .. 33) {
+  my $sp = ' ' x ($pad + 1);
+  for my $comments (0, 1) {
+    $dbh->{mysql_bind_comment_placeholders} = $comments;
+    my @statements = (
+      [ "SELECT${sp}'a?b', ?", 1, [ 'a?b', 'v' ] ],
+      [ "SELECT${sp}\"x\\\"?\", ?", 1, [ 'x"?', 'v' ] ],
+      [ "SELECT${sp}? AS `c?`", 1, [ 'v' ] ],
+      [ "SELECT${sp}/* ? */ ?", 1 + $comments, [ 'v' ] ],
+      [ "SELECT${sp}? -- ?\n", 1 + $comments, [ 'v' ] ],
+    );
+    my (@got, @expected);
+    for (@statements) {
+      my ($sql, $count, $row) = @$_;
+      my $sth = $dbh->prepare($sql);
+      push @got, [ $sth->{NUM_OF_PARAMS},
+                   $dbh->selectrow_arrayref($sql, undef, ('v') x $count) ];
+      push @expected, [ $count, $row ];
+    }
+    is_deeply \@got, \@expected,
+      "placeholders at offset $pad, comment placeholders $comments";
+  }
+  is scalar @{ $dbh->selectall_arrayref(
+    "SELECT id FROM dbd_mysql_t43count_params${sp} LIMIT ?", undef, 1) }, 1,
+    "LIMIT at offset $pad";
+}
+
+# a statement may end in the first character of a comment
+for my $comments (0, 1) {
+  $dbh->{mysql_bind_comment_placeholders} = $comments;
+  is $dbh->prepare("SELECT ? -")->{NUM_OF_PARAMS}, 1,
+    "trailing '-', comment placeholders $comments";
+  is $dbh->prepare("SELECT ? /")->{NUM_OF_PARAMS}, 1,
+    "trailing '/', comment placeholders $comments";
+}
+$dbh->{mysql_bind_comment_placeholders} = 0;
+
 ok ($dbh->do("DROP TABLE dbd_mysql_t43count_params"));
 
 ok $sth->finish;
@@ -0,0 +1,65 @@
+use strict;
+use warnings;
+
+use DBI;
+use Test::More;
+use lib 't', '.';
+require 'lib.pl';
+use vars qw($test_dsn $test_user $test_password);
+
+my $dbh;
+eval {$dbh= DBI->connect($test_dsn, $test_user, $test_password,
+                      { RaiseError => 1, PrintError => 1, AutoCommit => 1,
+                        mysql_server_prepare => 0 });};
+if ($@) {
+    plan skip_all => "no database connection";
+}
+
+plan tests => 18;
+
+ok $dbh->do("DROP TABLE IF EXISTS dbd_mysql_t44reexecute_params");
+ok $dbh->do("CREATE TABLE dbd_mysql_t44reexecute_params (id INT, name VARCHAR(64))");
+
+# placeholders in strings and comments must be left alone on every execute
+my $insert = $dbh->prepare(<<'EOT');
+  INSERT INTO dbd_mysql_t44reexecute_params (id, name) /* id, name ? */
+  VALUES (?, CONCAT('what? ', ?)) -- trailing ?
+EOT
+is $insert->{NUM_OF_PARAMS}, 2, 'two placeholders';
+
+for my $id (1 .. 5) {
+    ok $insert->execute($id, "it's $id"), "execute $id";
+}
+ok $insert->execute(6, undef), 'execute with NULL';
+
+my $select = $dbh->prepare(
+  "SELECT id, name FROM dbd_mysql_t44reexecute_params WHERE name LIKE ? ORDER BY id LIMIT ?");
+ok $select->execute('what?%', 2);
+is_deeply $select->fetchall_arrayref, [[1, "what? it's 1"], [2, "what? it's 2"]],
+  'values escaped, LIMIT value not quoted';
+ok $select->execute('%5', 10);
+is_deeply $select->fetchall_arrayref, [[5, "what? it's 5"]], 'second execute';
+
+# server side prepared: parameter buffers are reused and grown, values of
+# other types and NULLs in between must not leave stale values behind
+$dbh->do("DELETE FROM dbd_mysql_t44reexecute_params");
+$dbh->do("ALTER TABLE dbd_mysql_t44reexecute_params MODIFY name TEXT");
+$insert = $dbh->prepare(
+  "INSERT INTO dbd_mysql_t44reexecute_params (id, name) VALUES (?, ?)",
+  { mysql_server_prepare => 1 });
+my @names = ('a', 'bb' x 40, undef, 'c', 'd' x 64, 7, undef, 'e' x 300, 'f');
+my $ok = 1;
+$ok &&= $insert->execute($_ + 1, $names[$_]) for 0 .. $#names;
+ok $ok, 'server side prepared executes';
+is_deeply $dbh->selectcol_arrayref(
+  "SELECT name FROM dbd_mysql_t44reexecute_params ORDER BY id"), \@names,
+  'values of every execute';
+
+$select = $dbh->prepare(
+  "SELECT id FROM dbd_mysql_t44reexecute_params WHERE name = ?",
+  { mysql_server_prepare => 1 });
+is_deeply [ map { $select->execute($_); $select->fetchrow_array } 'e' x 300, 'a' ],
+  [8, 1], 'shorter value after a longer one';
+ok $select->execute(undef) && !$select->fetchrow_arrayref, 'NULL matches nothing';
+
+ok $dbh->do("DROP TABLE dbd_mysql_t44reexecute_params");